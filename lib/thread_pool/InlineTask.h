@@ -0,0 +1,137 @@
+#pragma once
+
+#include "SlotPool.h"
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Перемещаемая обёртка над void() с небольшим встроенным буфером.
+// Маленькие замыкания хранятся внутри объекта, крупные — в блоке из SlotPool.
+class InlineTask
+{
+public:
+	static constexpr std::size_t InlineSize = 56;
+
+	InlineTask() noexcept = default;
+
+	template <class F>
+		requires(!std::is_same_v<std::decay_t<F>, InlineTask> && std::is_invocable_v<std::decay_t<F>&>)
+	InlineTask(F&& f)
+	{
+		using Fn = std::decay_t<F>;
+		if constexpr (IsStoredInline<Fn>())
+		{
+			::new (static_cast<void*>(m_storage)) Fn(std::forward<F>(f));
+			m_ops = &InlineOps<Fn>;
+		}
+		else
+		{
+			void* block = SlotPool::Allocate(sizeof(Fn));
+			try
+			{
+				::new (block) Fn(std::forward<F>(f));
+			}
+			catch (...)
+			{
+				SlotPool::Deallocate(block, sizeof(Fn));
+				throw;
+			}
+			*reinterpret_cast<void**>(m_storage) = block;
+			m_ops = &PooledOps<Fn>;
+		}
+	}
+
+	InlineTask(InlineTask&& other) noexcept
+	{
+		MoveFrom(other);
+	}
+
+	InlineTask& operator=(InlineTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			MoveFrom(other);
+		}
+		return *this;
+	}
+
+	InlineTask(const InlineTask&) = delete;
+	InlineTask& operator=(const InlineTask&) = delete;
+
+	~InlineTask()
+	{
+		Reset();
+	}
+
+	void operator()()
+	{
+		m_ops->invoke(m_storage);
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return m_ops != nullptr;
+	}
+
+private:
+	struct Ops
+	{
+		void (*invoke)(void* storage);
+		void (*move)(void* dst, void* src) noexcept;
+		void (*destroy)(void* storage) noexcept;
+	};
+
+	template <class Fn>
+	static constexpr bool IsStoredInline()
+	{
+		return sizeof(Fn) <= InlineSize
+			&& alignof(Fn) <= alignof(std::max_align_t)
+			&& std::is_nothrow_move_constructible_v<Fn>;
+	}
+
+	template <class Fn>
+	static constexpr Ops InlineOps = {
+		[](void* storage) { (*static_cast<Fn*>(storage))(); },
+		[](void* dst, void* src) noexcept {
+			::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+			static_cast<Fn*>(src)->~Fn();
+		},
+		[](void* storage) noexcept { static_cast<Fn*>(storage)->~Fn(); },
+	};
+
+	template <class Fn>
+	static constexpr Ops PooledOps = {
+		[](void* storage) { (**static_cast<Fn**>(storage))(); },
+		[](void* dst, void* src) noexcept {
+			*static_cast<void**>(dst) = *static_cast<void**>(src);
+		},
+		[](void* storage) noexcept {
+			Fn* fn = *static_cast<Fn**>(storage);
+			fn->~Fn();
+			SlotPool::Deallocate(fn, sizeof(Fn));
+		},
+	};
+
+	void MoveFrom(InlineTask& other) noexcept
+	{
+		if (other.m_ops)
+		{
+			other.m_ops->move(m_storage, other.m_storage);
+			m_ops = std::exchange(other.m_ops, nullptr);
+		}
+	}
+
+	void Reset() noexcept
+	{
+		if (m_ops)
+		{
+			std::exchange(m_ops, nullptr)->destroy(m_storage);
+		}
+	}
+
+	alignas(std::max_align_t) std::byte m_storage[InlineSize];
+	const Ops* m_ops = nullptr;
+};
\ No newline at end of file
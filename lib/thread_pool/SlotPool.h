@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+// Пул блоков фиксированных размеров с потоковыми кэшами свободных слотов.
+// Блок может быть освобождён в другом потоке: он вернётся в кэш потока, который его выделил,
+// так что производитель, отдающий блоки потребителям, не выделяет их заново у системы.
+namespace SlotPool
+{
+void* Allocate(std::size_t size);
+void Deallocate(void* ptr, std::size_t size) noexcept;
+} // namespace SlotPool
+
+template <typename T>
+class PoolAllocator
+{
+public:
+	using value_type = T;
+
+	PoolAllocator() noexcept = default;
+	template <typename U>
+	PoolAllocator(const PoolAllocator<U>&) noexcept
+	{
+	}
+
+	T* allocate(std::size_t n)
+	{
+		if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		{
+			return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{ alignof(T) }));
+		}
+		else
+		{
+			return static_cast<T*>(SlotPool::Allocate(n * sizeof(T)));
+		}
+	}
+
+	void deallocate(T* ptr, std::size_t n) noexcept
+	{
+		if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+		{
+			::operator delete(ptr, n * sizeof(T), std::align_val_t{ alignof(T) });
+		}
+		else
+		{
+			SlotPool::Deallocate(ptr, n * sizeof(T));
+		}
+	}
+
+	template <typename U>
+	bool operator==(const PoolAllocator<U>&) const noexcept
+	{
+		return true;
+	}
+};
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+// Группа задач в общем пуле. Wait ждёт только задачи этой группы и, пока они есть в очереди,
+// выполняет их сам вместо сна. Чужие задачи ожидающий поток не берёт, поэтому группы можно
+// вкладывать: задача одной группы может создать свою группу и дождаться её внутри воркера.
+class TaskGroup
+{
+public:
+	explicit TaskGroup(ThreadPool& pool);
+	~TaskGroup();
+
+	TaskGroup(const TaskGroup&) = delete;
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+	template <class F>
+	void Run(F&& fn)
+	{
+		m_state->pending.fetch_add(1, std::memory_order_relaxed);
+		{
+			std::lock_guard lock(m_state->mutex);
+			m_state->tasks.emplace_back(std::forward<F>(fn));
+		}
+		// Задача пула лишь забирает очередную задачу группы, если её ещё не выполнил ожидающий поток
+		m_pool.Submit([state = m_state] {
+			RunNext(*state);
+		});
+	}
+
+	// Дожидается задач группы и пробрасывает первое исключение, выброшенное ими
+	void Wait();
+
+private:
+	// Переживает группу, пока в пуле остаются ссылающиеся на неё задачи
+	struct State
+	{
+		std::mutex mutex;
+		std::deque<ThreadPool::Task> tasks;
+		std::atomic<size_t> pending{ 0 };
+		std::exception_ptr error;
+	};
+
+	static bool RunNext(State& state);
+	void WaitPending();
+
+	ThreadPool& m_pool;
+	std::shared_ptr<State> m_state;
+};
\ No newline at end of file
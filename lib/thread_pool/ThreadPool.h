@@ -1,33 +1,35 @@
 #pragma once
 
+#include "InlineTask.h"
+#include "SlotPool.h"
+
 #include <atomic>
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 
 class ThreadPool
 {
+	friend class TaskGroup;
+
 public:
-	using Task = std::function<void()>;
+	using Task = InlineTask;
 
-	explicit ThreadPool(size_t numThreads)
+	enum class SchedulingMode
 	{
-		m_workers.reserve(numThreads);
-		for (size_t i = 0; i < numThreads; ++i)
-		{
-			m_workers.emplace_back(&ThreadPool::WorkerLoop, this);
-		}
-	}
+		// Все задачи проходят через одну общую очередь
+		SharedQueue,
+		// У каждого потока своя очередь, простаивающие потоки воруют задачи у соседей
+		WorkStealing,
+	};
 
-	~ThreadPool()
-	{
-		m_stopFlag = true;
-		m_stateChanged.notify_all();
-	}
+	explicit ThreadPool(size_t numThreads, SchedulingMode mode = SchedulingMode::WorkStealing);
+	~ThreadPool();
 
 	template <class F, class... Args>
 	auto Enqueue(F&& f, Args&&... args)
@@ -35,77 +37,164 @@ public:
 	{
 		using returnType = std::invoke_result_t<F, Args...>;
 
-		auto task = std::make_shared<std::packaged_task<returnType()>>(
-			std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-
-		std::future<returnType> res = task->get_future();
-		{
-			std::unique_lock lock(m_queueMutex);
-			if (m_stopFlag)
+		// Общее состояние promise/future берётся из пула, замыкание хранится внутри Task
+		std::promise<returnType> promise(std::allocator_arg, PoolAllocator<returnType>{});
+		std::future<returnType> res = promise.get_future();
+		Submit([promise = std::move(promise), f = std::forward<F>(f), ... args = std::forward<Args>(args)]() mutable {
+			try
 			{
-				throw std::runtime_error("enqueue on stopped ThreadPool");
+				if constexpr (std::is_void_v<returnType>)
+				{
+					std::invoke(std::move(f), std::move(args)...);
+					promise.set_value();
+				}
+				else
+				{
+					promise.set_value(std::invoke(std::move(f), std::move(args)...));
+				}
 			}
-
-			m_tasks.emplace([task = std::move(task)] {
-				(*task)();
-			});
-			++m_activeTasks;
-		}
-		m_stateChanged.notify_one();
+			catch (...)
+			{
+				promise.set_exception(std::current_exception());
+			}
+		});
 		return res;
 	}
 
-	void Wait()
+	// Вызывает fn(i) для каждого i из [begin, end). Диапазон делится на куски не меньше grainSize
+	// (0 — подобрать автоматически), куски разбирают воркеры и вызывающий поток.
+	// Возвращает управление, когда обработан весь диапазон, не дожидаясь остальных задач пула.
+	template <class F>
+	void ParallelFor(size_t begin, size_t end, size_t grainSize, F&& fn)
 	{
-		std::unique_lock lock(m_queueMutex);
-		m_tasksEmpty.wait(lock, [this] {
-			// TODO: написать комментарий, почему тут memory_order_relaxed
-			return m_tasks.empty() && m_activeTasks.load(std::memory_order_relaxed) == 0;
+		ForEachChunk(begin, end, grainSize, [&fn](size_t chunkBegin, size_t chunkEnd) {
+			for (size_t i = chunkBegin; i < chunkEnd; ++i)
+			{
+				fn(i);
+			}
 		});
 	}
 
-private:
-	void WorkerLoop()
+	// Возвращает вектор значений fn(i) для i из [begin, end)
+	template <class F>
+	auto ParallelMap(size_t begin, size_t end, size_t grainSize, F&& fn)
+		-> std::vector<std::invoke_result_t<F&, size_t>>
 	{
-		while (true)
-		{
-			Task task;
-			{
-				std::unique_lock lock(m_queueMutex);
-				m_stateChanged.wait(lock, [this] {
-					return m_stopFlag.load(std::memory_order_relaxed) || !m_tasks.empty();
-				});
-
-				if (m_stopFlag.load(std::memory_order_relaxed) && m_tasks.empty())
-				{
-					return;
-				}
-
-				task = std::move(m_tasks.front());
-				m_tasks.pop();
-			}
+		using valueType = std::invoke_result_t<F&, size_t>;
+		static_assert(!std::is_same_v<valueType, bool>, "std::vector<bool> cannot be filled concurrently");
 
-			try
-			{
-				task();
-			}
-			catch (...)
+		std::vector<valueType> results(end > begin ? end - begin : 0);
+		ForEachChunk(begin, end, grainSize, [&fn, &results, begin](size_t chunkBegin, size_t chunkEnd) {
+			for (size_t i = chunkBegin; i < chunkEnd; ++i)
 			{
+				results[i - begin] = fn(i);
 			}
+		});
+		return results;
+	}
 
-			m_activeTasks.fetch_sub(1, std::memory_order_release);
-			if (m_activeTasks.load(std::memory_order_acquire) == 0 && m_tasks.empty())
+	// Сворачивает map(i) для i из [begin, end) операцией reduce, которая должна быть
+	// ассоциативной и коммутативной: частичные результаты кусков объединяются в произвольном порядке
+	template <class T, class MapFn, class ReduceFn>
+	T ParallelReduce(size_t begin, size_t end, size_t grainSize, T identity, MapFn&& map, ReduceFn&& reduce)
+	{
+		std::mutex partialsMutex;
+		std::vector<T> partials;
+		ForEachChunk(begin, end, grainSize, [&](size_t chunkBegin, size_t chunkEnd) {
+			T partial = identity;
+			for (size_t i = chunkBegin; i < chunkEnd; ++i)
 			{
-				m_tasksEmpty.notify_all();
+				partial = reduce(std::move(partial), map(i));
 			}
+			std::lock_guard lock(partialsMutex);
+			partials.push_back(std::move(partial));
+		});
+
+		T result = std::move(identity);
+		for (auto& partial : partials)
+		{
+			result = reduce(std::move(result), std::move(partial));
 		}
+		return result;
+	}
+
+	// Ждёт опустошения всего пула. Чтобы дождаться только своих задач, используйте TaskGroup
+	void Wait();
+
+	[[nodiscard]] size_t GetThreadCount() const { return m_workers.size(); }
+	[[nodiscard]] SchedulingMode GetSchedulingMode() const { return m_mode; }
+
+private:
+	struct ChunkBody
+	{
+		void* context;
+		void (*invoke)(void* context, size_t chunkBegin, size_t chunkEnd);
+	};
+
+	struct Batch;
+
+	template <class F>
+	void ForEachChunk(size_t begin, size_t end, size_t grainSize, F&& chunkFn)
+	{
+		using Fn = std::remove_reference_t<F>;
+		RunBatch(begin, end, grainSize,
+			ChunkBody{
+				const_cast<void*>(static_cast<const void*>(std::addressof(chunkFn))),
+				[](void* context, size_t chunkBegin, size_t chunkEnd) {
+					(*static_cast<Fn*>(context))(chunkBegin, chunkEnd);
+				},
+			});
 	}
 
+	void RunBatch(size_t begin, size_t end, size_t grainSize, ChunkBody body);
+	static void RunBatchChunks(Batch& batch);
+
+	// Кольцевой буфер задач: после прогрева не выделяет память на каждую задачу
+	class TaskRing
+	{
+	public:
+		[[nodiscard]] bool Empty() const { return m_count == 0; }
+		void PushBack(Task&& task);
+		Task PopBack();
+		Task PopFront();
+
+	private:
+		void Grow();
+
+		std::vector<Task> m_buffer;
+		size_t m_head = 0;
+		size_t m_count = 0;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		TaskRing tasks;
+	};
+
+	void Submit(Task task);
+	bool TryPopTask(size_t workerIndex, Task& task);
+	bool TryPopLocal(size_t workerIndex, Task& task);
+	bool TrySteal(size_t workerIndex, Task& task);
+	void RunTask(Task& task);
+	void WorkerLoop(size_t workerIndex);
+
+	// Пул и индекс потока-воркера, в котором выполняется текущий код
+	static thread_local ThreadPool* t_currentPool;
+	static thread_local size_t t_workerIndex;
+
+	const SchedulingMode m_mode;
+	std::vector<std::unique_ptr<WorkQueue>> m_queues;
 	std::vector<std::jthread> m_workers;
-	std::queue<Task> m_tasks;
-	std::mutex m_queueMutex;
+	std::atomic<size_t> m_nextQueue{ 0 };
+
+	std::mutex m_sleepMutex;
 	std::condition_variable m_stateChanged;
 	std::condition_variable m_tasksEmpty;
 	std::atomic<bool> m_stopFlag{ false };
+	// Задачи, лежащие в очередях и ещё не взятые на выполнение
+	std::atomic<size_t> m_queuedTasks{ 0 };
+	// Задачи, поставленные в пул и ещё не завершённые
 	std::atomic<size_t> m_activeTasks{ 0 };
+	std::atomic<size_t> m_sleepingWorkers{ 0 };
 };
\ No newline at end of file
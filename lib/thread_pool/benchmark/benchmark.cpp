@@ -0,0 +1,186 @@
+#include "ThreadPool.h"
+
+#include <benchmark/benchmark.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+static constexpr size_t TasksPerBatch = 20'000;
+// Задач в полёте меньше, чем слотов в кэше потока: в установившемся режиме блоки берутся из кэша
+static constexpr size_t SubmittedTasksPerBatch = 1'000;
+static constexpr size_t FanOutRoots = 64;
+static constexpr size_t FanOutChildren = 256;
+static constexpr int WorkIterations = 200;
+
+static void DoWork(std::atomic<std::uint64_t>& sink)
+{
+	std::uint64_t acc = 0;
+	for (int i = 0; i < WorkIterations; ++i)
+	{
+		acc += static_cast<std::uint64_t>(i) * 2654435761u;
+		benchmark::DoNotOptimize(acc);
+	}
+	sink.fetch_add(acc & 1, std::memory_order_relaxed);
+}
+
+static void RunFlatBatch(benchmark::State& state, ThreadPool::SchedulingMode mode)
+{
+	ThreadPool pool(static_cast<size_t>(state.range(0)), mode);
+	std::atomic<std::uint64_t> sink{ 0 };
+
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < TasksPerBatch; ++i)
+		{
+			pool.Enqueue([&sink] { DoWork(sink); });
+		}
+		pool.Wait();
+	}
+	benchmark::DoNotOptimize(sink.load());
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * TasksPerBatch));
+}
+
+static void RunRecursiveFanOut(benchmark::State& state, ThreadPool::SchedulingMode mode)
+{
+	ThreadPool pool(static_cast<size_t>(state.range(0)), mode);
+	std::atomic<std::uint64_t> sink{ 0 };
+
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < FanOutRoots; ++i)
+		{
+			pool.Enqueue([&pool, &sink] {
+				for (size_t j = 0; j < FanOutChildren; ++j)
+				{
+					pool.Enqueue([&sink] { DoWork(sink); });
+				}
+			});
+		}
+		pool.Wait();
+	}
+	benchmark::DoNotOptimize(sink.load());
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * FanOutRoots * FanOutChildren));
+}
+
+// Представление задачи до перехода на InlineTask: packaged_task в shared_ptr, bind и std::function
+void BM_LegacyTaskSubmission(benchmark::State& state)
+{
+	int value = 0;
+	for (auto _ : state)
+	{
+		auto task = std::make_shared<std::packaged_task<int()>>(
+			std::bind([](int x) { return x + 1; }, value));
+		auto future = task->get_future();
+		std::function<void()> wrapper([task = std::move(task)] { (*task)(); });
+		wrapper();
+		value = future.get();
+	}
+	benchmark::DoNotOptimize(value);
+}
+
+// Задачи ставит один поток, а выполняют и освобождают воркеры: замыкание и общее состояние
+// promise/future выделяются в кэше производителя и освобождаются в чужих потоках
+void BM_InlineTaskSubmission(benchmark::State& state)
+{
+	ThreadPool pool(static_cast<size_t>(state.range(0)));
+	std::vector<std::future<int>> futures;
+	futures.reserve(SubmittedTasksPerBatch);
+	// Замыкание не помещается в InlineSize и хранится в блоке SlotPool
+	const std::array<int, 16> payload{};
+
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < SubmittedTasksPerBatch; ++i)
+		{
+			futures.push_back(pool.Enqueue([payload, i] { return payload[i % payload.size()] + static_cast<int>(i); }));
+		}
+		for (auto& future : futures)
+		{
+			benchmark::DoNotOptimize(future.get());
+		}
+		futures.clear();
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * SubmittedTasksPerBatch));
+}
+
+void BM_EnqueueRoundTrip(benchmark::State& state)
+{
+	ThreadPool pool(1);
+	std::vector<std::future<int>> futures;
+	futures.reserve(TasksPerBatch);
+
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < TasksPerBatch; ++i)
+		{
+			futures.push_back(pool.Enqueue([i] { return static_cast<int>(i); }));
+		}
+		for (auto& future : futures)
+		{
+			benchmark::DoNotOptimize(future.get());
+		}
+		futures.clear();
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * TasksPerBatch));
+}
+
+void BM_SharedQueueFlatBatch(benchmark::State& state)
+{
+	RunFlatBatch(state, ThreadPool::SchedulingMode::SharedQueue);
+}
+
+void BM_WorkStealingFlatBatch(benchmark::State& state)
+{
+	RunFlatBatch(state, ThreadPool::SchedulingMode::WorkStealing);
+}
+
+void BM_SharedQueueRecursiveFanOut(benchmark::State& state)
+{
+	RunRecursiveFanOut(state, ThreadPool::SchedulingMode::SharedQueue);
+}
+
+void BM_WorkStealingRecursiveFanOut(benchmark::State& state)
+{
+	RunRecursiveFanOut(state, ThreadPool::SchedulingMode::WorkStealing);
+}
+
+BENCHMARK(BM_LegacyTaskSubmission);
+BENCHMARK(BM_InlineTaskSubmission)
+	->Arg(1)
+	->Arg(4)
+	->UseRealTime();
+BENCHMARK(BM_EnqueueRoundTrip)->UseRealTime();
+
+BENCHMARK(BM_SharedQueueFlatBatch)
+	->Arg(2)
+	->Arg(4)
+	->Arg(8)
+	->Arg(16)
+	->UseRealTime();
+
+BENCHMARK(BM_WorkStealingFlatBatch)
+	->Arg(2)
+	->Arg(4)
+	->Arg(8)
+	->Arg(16)
+	->UseRealTime();
+
+BENCHMARK(BM_SharedQueueRecursiveFanOut)
+	->Arg(2)
+	->Arg(4)
+	->Arg(8)
+	->Arg(16)
+	->UseRealTime();
+
+BENCHMARK(BM_WorkStealingRecursiveFanOut)
+	->Arg(2)
+	->Arg(4)
+	->Arg(8)
+	->Arg(16)
+	->UseRealTime();
+
+BENCHMARK_MAIN();
\ No newline at end of file
@@ -0,0 +1,253 @@
+#include "SlotPool.h"
+
+#include <array>
+#include <atomic>
+#include <utility>
+
+namespace
+{
+constexpr std::array<std::size_t, 4> SlotSizes = { 64, 128, 256, 512 };
+constexpr std::size_t MaxCachedSlots = 4096;
+// Чужие слоты возвращаются владельцу пачками: одна атомарная операция на пачку
+constexpr std::size_t ReturnBatchSize = 32;
+// Перед слотом лежит заголовок с его владельцем; размер заголовка сохраняет выравнивание слота
+constexpr std::size_t HeaderSize = alignof(std::max_align_t);
+
+struct FreeSlot
+{
+	FreeSlot* next;
+};
+
+// Поток, выделивший слоты у системы. Слот, освобождённый в другом потоке, возвращается
+// в стек возврата владельца, и тот снова выдаёт его из своего кэша. Стек забирается
+// владельцем только целиком, так что проблемы ABA нет
+struct SlotOwner
+{
+	std::array<std::atomic<FreeSlot*>, SlotSizes.size()> returned{};
+	// Ограничение стеков возврата; счётчик может ненадолго превышать их длину
+	std::array<std::atomic<std::size_t>, SlotSizes.size()> returnedCounts{};
+	// Сам поток и все выделенные им у системы блоки
+	std::atomic<std::size_t> refs{ 1 };
+};
+
+// Стек возврата завершившегося потока: в него больше не кладут, слоты отдаются системе
+FreeSlot g_closedStack{ nullptr };
+
+// Чужие слоты одного владельца, ещё не возвращённые ему
+struct ReturnBatch
+{
+	SlotOwner* owner = nullptr;
+	FreeSlot* head = nullptr;
+	FreeSlot* tail = nullptr;
+	std::size_t count = 0;
+};
+
+struct SlotCache
+{
+	std::array<FreeSlot*, SlotSizes.size()> heads{};
+	std::array<std::size_t, SlotSizes.size()> counts{};
+	std::array<ReturnBatch, SlotSizes.size()> batches{};
+	SlotOwner* owner = new SlotOwner;
+
+	~SlotCache();
+};
+
+// Кэш потока уже разрушен: блоки, выделяемые после этого, не принадлежат ни одному потоку
+thread_local bool t_cacheDestroyed = false;
+thread_local SlotCache t_cache;
+
+void ReleaseOwner(SlotOwner* owner)
+{
+	if (owner->refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		delete owner;
+	}
+}
+
+SlotOwner*& GetOwner(void* slot)
+{
+	return *reinterpret_cast<SlotOwner**>(static_cast<std::byte*>(slot) - HeaderSize);
+}
+
+void* AllocateSlot(int sizeClass, SlotOwner* owner)
+{
+	auto* block = static_cast<std::byte*>(::operator new(HeaderSize + SlotSizes[sizeClass]));
+	if (owner)
+	{
+		owner->refs.fetch_add(1, std::memory_order_relaxed);
+	}
+	*reinterpret_cast<SlotOwner**>(block) = owner;
+	return block + HeaderSize;
+}
+
+void FreeSlotMemory(void* slot)
+{
+	SlotOwner* owner = GetOwner(slot);
+	::operator delete(static_cast<std::byte*>(slot) - HeaderSize);
+	if (owner)
+	{
+		ReleaseOwner(owner);
+	}
+}
+
+void FreeSlots(FreeSlot* head)
+{
+	while (head)
+	{
+		FreeSlotMemory(std::exchange(head, head->next));
+	}
+}
+
+// Кладёт цепочку слотов в стек возврата владельца. Если стек полон или владелец уже
+// завершился, слоты отдаются системе
+void ReturnToOwner(int sizeClass, ReturnBatch& batch)
+{
+	SlotOwner& owner = *batch.owner;
+	auto& count = owner.returnedCounts[sizeClass];
+	FreeSlot* head = nullptr;
+	if (count.fetch_add(batch.count, std::memory_order_relaxed) < MaxCachedSlots)
+	{
+		auto& stack = owner.returned[sizeClass];
+		head = stack.load(std::memory_order_relaxed);
+		do
+		{
+			if (head == &g_closedStack)
+			{
+				break;
+			}
+			batch.tail->next = head;
+		} while (!stack.compare_exchange_weak(head, batch.head, std::memory_order_release, std::memory_order_relaxed));
+	}
+	else
+	{
+		head = &g_closedStack;
+	}
+	if (head == &g_closedStack)
+	{
+		count.fetch_sub(batch.count, std::memory_order_relaxed);
+		batch.tail->next = nullptr;
+		FreeSlots(batch.head);
+	}
+	batch = {};
+}
+
+SlotCache::~SlotCache()
+{
+	t_cacheDestroyed = true;
+	for (std::size_t i = 0; i < SlotSizes.size(); ++i)
+	{
+		if (batches[i].owner)
+		{
+			ReturnToOwner(static_cast<int>(i), batches[i]);
+		}
+		FreeSlots(heads[i]);
+		FreeSlots(owner->returned[i].exchange(&g_closedStack, std::memory_order_acquire));
+	}
+	ReleaseOwner(owner);
+}
+
+int GetSizeClass(std::size_t size)
+{
+	for (std::size_t i = 0; i < SlotSizes.size(); ++i)
+	{
+		if (size <= SlotSizes[i])
+		{
+			return static_cast<int>(i);
+		}
+	}
+	return -1;
+}
+
+} // namespace
+
+void* SlotPool::Allocate(std::size_t size)
+{
+	const int sizeClass = GetSizeClass(size);
+	if (sizeClass < 0)
+	{
+		return ::operator new(size);
+	}
+	if (t_cacheDestroyed)
+	{
+		return AllocateSlot(sizeClass, nullptr);
+	}
+
+	auto& head = t_cache.heads[sizeClass];
+	if (!head)
+	{
+		// Стек возврата трогается, только когда кэш пуст, и забирается целиком
+		auto& owner = *t_cache.owner;
+		head = owner.returned[sizeClass].exchange(nullptr, std::memory_order_acquire);
+		std::size_t count = 0;
+		for (const FreeSlot* slot = head; slot; slot = slot->next)
+		{
+			++count;
+		}
+		owner.returnedCounts[sizeClass].fetch_sub(count, std::memory_order_relaxed);
+		t_cache.counts[sizeClass] = count;
+	}
+	if (head)
+	{
+		--t_cache.counts[sizeClass];
+		return std::exchange(head, head->next);
+	}
+	return AllocateSlot(sizeClass, t_cache.owner);
+}
+
+void SlotPool::Deallocate(void* ptr, std::size_t size) noexcept
+{
+	if (!ptr)
+	{
+		return;
+	}
+
+	const int sizeClass = GetSizeClass(size);
+	if (sizeClass < 0)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	SlotOwner* owner = GetOwner(ptr);
+	auto* slot = static_cast<FreeSlot*>(ptr);
+	if (!owner)
+	{
+		FreeSlotMemory(ptr);
+		return;
+	}
+	if (t_cacheDestroyed)
+	{
+		ReturnBatch batch{ owner, slot, slot, 1 };
+		ReturnToOwner(sizeClass, batch);
+		return;
+	}
+
+	if (owner == t_cache.owner)
+	{
+		if (t_cache.counts[sizeClass] >= MaxCachedSlots)
+		{
+			FreeSlotMemory(ptr);
+			return;
+		}
+		slot->next = t_cache.heads[sizeClass];
+		t_cache.heads[sizeClass] = slot;
+		++t_cache.counts[sizeClass];
+		return;
+	}
+
+	auto& batch = t_cache.batches[sizeClass];
+	if (batch.owner != owner)
+	{
+		if (batch.owner)
+		{
+			ReturnToOwner(sizeClass, batch);
+		}
+		batch = { owner, nullptr, slot, 0 };
+	}
+	slot->next = batch.head;
+	batch.head = slot;
+	if (++batch.count == ReturnBatchSize)
+	{
+		ReturnToOwner(sizeClass, batch);
+	}
+}
\ No newline at end of file
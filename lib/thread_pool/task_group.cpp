@@ -0,0 +1,76 @@
+#include "TaskGroup.h"
+
+#include <utility>
+
+TaskGroup::TaskGroup(ThreadPool& pool)
+	: m_pool(pool)
+	, m_state(std::make_shared<State>())
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	WaitPending();
+}
+
+void TaskGroup::Wait()
+{
+	WaitPending();
+
+	std::exception_ptr error;
+	{
+		std::lock_guard lock(m_state->mutex);
+		error = std::exchange(m_state->error, nullptr);
+	}
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+void TaskGroup::WaitPending()
+{
+	while (RunNext(*m_state))
+	{
+	}
+
+	// В очереди группы пусто, оставшиеся задачи уже выполняются другими потоками
+	for (size_t pending = m_state->pending.load(std::memory_order_acquire); pending != 0;
+		pending = m_state->pending.load(std::memory_order_acquire))
+	{
+		m_state->pending.wait(pending, std::memory_order_acquire);
+	}
+}
+
+bool TaskGroup::RunNext(State& state)
+{
+	ThreadPool::Task task;
+	{
+		std::lock_guard lock(state.mutex);
+		if (state.tasks.empty())
+		{
+			return false;
+		}
+		task = std::move(state.tasks.front());
+		state.tasks.pop_front();
+	}
+
+	try
+	{
+		task();
+	}
+	catch (...)
+	{
+		std::lock_guard lock(state.mutex);
+		if (!state.error)
+		{
+			state.error = std::current_exception();
+		}
+	}
+
+	if (state.pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		state.pending.notify_all();
+	}
+	return true;
+}
\ No newline at end of file
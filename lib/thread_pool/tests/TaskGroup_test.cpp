@@ -0,0 +1,155 @@
+#include "TaskGroup.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr auto WaitTimeout = std::chrono::seconds(5);
+} // namespace
+
+TEST(TaskGroupTest, WaitRunsAllTasks)
+{
+	ThreadPool pool(4);
+	TaskGroup group(pool);
+	std::atomic<int> counter{ 0 };
+	for (int i = 0; i < 500; ++i)
+	{
+		group.Run([&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+	}
+	group.Wait();
+	EXPECT_EQ(500, counter.load());
+}
+
+TEST(TaskGroupTest, WaitWithoutTasksReturnsImmediately)
+{
+	ThreadPool pool(2);
+	TaskGroup group(pool);
+	EXPECT_NO_THROW(group.Wait());
+}
+
+TEST(TaskGroupTest, WaitingThreadRunsQueuedTasks)
+{
+	// Без воркеров задачи группы может выполнить только ожидающий поток
+	ThreadPool pool(0);
+	TaskGroup group(pool);
+	std::vector<std::thread::id> threads;
+	for (int i = 0; i < 3; ++i)
+	{
+		group.Run([&threads] { threads.push_back(std::this_thread::get_id()); });
+	}
+	group.Wait();
+	EXPECT_EQ((std::vector<std::thread::id>(3, std::this_thread::get_id())), threads);
+}
+
+TEST(TaskGroupTest, WaitDoesNotRunOtherTasks)
+{
+	ThreadPool pool(0);
+	TaskGroup group(pool);
+	bool isForeignRun = false;
+	pool.Enqueue([&isForeignRun] { isForeignRun = true; });
+	group.Run([] {});
+	group.Wait();
+	EXPECT_FALSE(isForeignRun);
+}
+
+TEST(TaskGroupTest, NestedWaitInsideSingleWorkerDoesNotDeadlock)
+{
+	// Единственный воркер занят внешней задачей, так что вложенную группу выполняет её Wait
+	ThreadPool pool(1);
+	auto outer = pool.Enqueue([&pool] {
+		TaskGroup inner(pool);
+		std::atomic<int> counter{ 0 };
+		for (int i = 0; i < 10; ++i)
+		{
+			inner.Run([&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+		}
+		inner.Wait();
+		return counter.load();
+	});
+	ASSERT_EQ(std::future_status::ready, outer.wait_for(WaitTimeout));
+	EXPECT_EQ(10, outer.get());
+}
+
+TEST(TaskGroupTest, NestedGroupsInsideGroupTasks)
+{
+	ThreadPool pool(2);
+	TaskGroup outer(pool);
+	std::atomic<int> counter{ 0 };
+	for (int i = 0; i < 8; ++i)
+	{
+		outer.Run([&pool, &counter] {
+			TaskGroup inner(pool);
+			for (int j = 0; j < 8; ++j)
+			{
+				inner.Run([&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+			}
+			inner.Wait();
+		});
+	}
+	outer.Wait();
+	EXPECT_EQ(64, counter.load());
+}
+
+TEST(TaskGroupTest, WaitRethrowsTaskException)
+{
+	ThreadPool pool(2);
+	TaskGroup group(pool);
+	std::atomic<int> completed{ 0 };
+	group.Run([] { throw std::runtime_error("task failed"); });
+	for (int i = 0; i < 10; ++i)
+	{
+		group.Run([&completed] { completed.fetch_add(1, std::memory_order_relaxed); });
+	}
+	EXPECT_THROW(group.Wait(), std::runtime_error);
+	// Ошибка одной задачи не отменяет остальные
+	EXPECT_EQ(10, completed.load());
+}
+
+TEST(TaskGroupTest, WaitRethrowsOnlyFirstException)
+{
+	ThreadPool pool(0);
+	TaskGroup group(pool);
+	group.Run([] { throw std::invalid_argument("first"); });
+	group.Run([] { throw std::runtime_error("second"); });
+	EXPECT_THROW(group.Wait(), std::invalid_argument);
+	// Исключение выдаётся один раз, после него группу можно использовать снова
+	EXPECT_NO_THROW(group.Wait());
+	bool isRun = false;
+	group.Run([&isRun] { isRun = true; });
+	group.Wait();
+	EXPECT_TRUE(isRun);
+}
+
+TEST(TaskGroupTest, NestedExceptionReachesOuterWait)
+{
+	ThreadPool pool(1);
+	TaskGroup outer(pool);
+	outer.Run([&pool] {
+		TaskGroup inner(pool);
+		inner.Run([] { throw std::logic_error("inner failed"); });
+		inner.Wait();
+	});
+	EXPECT_THROW(outer.Wait(), std::logic_error);
+}
+
+TEST(TaskGroupTest, DestructorWaitsForTasks)
+{
+	ThreadPool pool(2);
+	std::atomic<int> counter{ 0 };
+	{
+		TaskGroup group(pool);
+		for (int i = 0; i < 100; ++i)
+		{
+			group.Run([&counter] {
+				std::this_thread::yield();
+				counter.fetch_add(1, std::memory_order_relaxed);
+			});
+		}
+	}
+	EXPECT_EQ(100, counter.load());
+}
\ No newline at end of file
@@ -0,0 +1,282 @@
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr auto WaitTimeout = std::chrono::seconds(5);
+
+// Поток, обработавший каждый индекс диапазона
+std::vector<std::thread::id> RecordThreads(ThreadPool& pool, size_t count, size_t grainSize)
+{
+	std::vector<std::thread::id> threads(count);
+	pool.ParallelFor(0, count, grainSize, [&threads](size_t i) {
+		threads[i] = std::this_thread::get_id();
+	});
+	return threads;
+}
+} // namespace
+
+class SchedulingModeTest : public ::testing::TestWithParam<ThreadPool::SchedulingMode>
+{
+};
+
+INSTANTIATE_TEST_SUITE_P(ThreadPoolTest, SchedulingModeTest,
+	::testing::Values(ThreadPool::SchedulingMode::SharedQueue, ThreadPool::SchedulingMode::WorkStealing));
+
+TEST_P(SchedulingModeTest, EnqueueReturnsResult)
+{
+	ThreadPool pool(2, GetParam());
+	auto sum = pool.Enqueue([](int a, int b) { return a + b; }, 2, 3);
+	auto text = pool.Enqueue([] { return std::string("done"); });
+	EXPECT_EQ(5, sum.get());
+	EXPECT_EQ("done", text.get());
+}
+
+TEST_P(SchedulingModeTest, EnqueuePropagatesException)
+{
+	ThreadPool pool(2, GetParam());
+	auto future = pool.Enqueue([]() -> int { throw std::runtime_error("task failed"); });
+	EXPECT_THROW(future.get(), std::runtime_error);
+	EXPECT_EQ(7, pool.Enqueue([] { return 7; }).get());
+}
+
+TEST_P(SchedulingModeTest, WaitRunsAllTasks)
+{
+	ThreadPool pool(4, GetParam());
+	std::atomic<int> counter{ 0 };
+	for (int i = 0; i < 1000; ++i)
+	{
+		pool.Enqueue([&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+	}
+	pool.Wait();
+	EXPECT_EQ(1000, counter.load());
+}
+
+TEST_P(SchedulingModeTest, TasksSpawnedByTasksAreRun)
+{
+	ThreadPool pool(3, GetParam());
+	std::atomic<int> counter{ 0 };
+	for (int i = 0; i < 16; ++i)
+	{
+		pool.Enqueue([&pool, &counter] {
+			for (int j = 0; j < 16; ++j)
+			{
+				pool.Enqueue([&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+			}
+		});
+	}
+	pool.Wait();
+	EXPECT_EQ(256, counter.load());
+}
+
+TEST(ThreadPoolTest, IdleWorkerStealsTaskFromBlockedWorker)
+{
+	ThreadPool pool(2, ThreadPool::SchedulingMode::WorkStealing);
+	std::promise<std::thread::id> childThread;
+	auto childRan = childThread.get_future();
+
+	// Дочерняя задача попадает в очередь родителя, а родитель не вернётся, пока её не выполнят:
+	// выполнить её может только второй воркер, украв из чужой очереди
+	std::thread::id parentThread;
+	auto parent = pool.Enqueue([&] {
+		parentThread = std::this_thread::get_id();
+		pool.Enqueue([&childThread] { childThread.set_value(std::this_thread::get_id()); });
+		return childRan.wait_for(WaitTimeout) == std::future_status::ready;
+	});
+	ASSERT_TRUE(parent.get());
+	EXPECT_NE(parentThread, childRan.get());
+	pool.Wait();
+}
+
+TEST(ThreadPoolTest, WorkerTakesOwnNewestTaskFirst)
+{
+	ThreadPool pool(1, ThreadPool::SchedulingMode::WorkStealing);
+	std::mutex orderMutex;
+	std::vector<int> order;
+	pool.Enqueue([&] {
+		for (int i = 0; i < 3; ++i)
+		{
+			pool.Enqueue([&, i] {
+				std::lock_guard lock(orderMutex);
+				order.push_back(i);
+			});
+		}
+	});
+	pool.Wait();
+	EXPECT_EQ((std::vector<int>{ 2, 1, 0 }), order);
+}
+
+TEST(ThreadPoolTest, SharedQueueRunsTasksInSubmissionOrder)
+{
+	ThreadPool pool(1, ThreadPool::SchedulingMode::SharedQueue);
+	std::mutex orderMutex;
+	std::vector<int> order;
+	for (int i = 0; i < 5; ++i)
+	{
+		pool.Enqueue([&, i] {
+			std::lock_guard lock(orderMutex);
+			order.push_back(i);
+		});
+	}
+	pool.Wait();
+	EXPECT_EQ((std::vector<int>{ 0, 1, 2, 3, 4 }), order);
+}
+
+TEST_P(SchedulingModeTest, ParallelForVisitsEachIndexOnce)
+{
+	ThreadPool pool(4, GetParam());
+	for (const size_t grainSize : { size_t{ 0 }, size_t{ 1 }, size_t{ 7 }, size_t{ 10'000 } })
+	{
+		std::vector<std::atomic<int>> visits(1000);
+		pool.ParallelFor(100, 1000, grainSize, [&visits](size_t i) {
+			visits[i].fetch_add(1, std::memory_order_relaxed);
+		});
+		for (size_t i = 0; i < visits.size(); ++i)
+		{
+			EXPECT_EQ(i < 100 ? 0 : 1, visits[i].load()) << "index " << i << ", grain " << grainSize;
+		}
+	}
+}
+
+TEST(ThreadPoolTest, ParallelForOnEmptyRangeDoesNothing)
+{
+	ThreadPool pool(2);
+	int calls = 0;
+	pool.ParallelFor(5, 5, 0, [&calls](size_t) { ++calls; });
+	pool.ParallelFor(6, 5, 0, [&calls](size_t) { ++calls; });
+	EXPECT_EQ(0, calls);
+}
+
+TEST(ThreadPoolTest, ParallelForChunksAreNotSmallerThanGrain)
+{
+	ThreadPool pool(4);
+	constexpr size_t Count = 10'000;
+	constexpr size_t Grain = 64;
+	const auto threads = RecordThreads(pool, Count, Grain);
+
+	// Кусок целиком обрабатывается одним потоком, так что подряд идущие индексы одного потока
+	// образуют отрезки не короче куска; короче может быть только хвост диапазона
+	size_t runBegin = 0;
+	for (size_t i = 1; i <= Count; ++i)
+	{
+		if (i == Count || threads[i] != threads[runBegin])
+		{
+			if (i != Count)
+			{
+				EXPECT_GE(i - runBegin, Grain) << "run at " << runBegin;
+			}
+			runBegin = i;
+		}
+	}
+}
+
+TEST(ThreadPoolTest, ParallelForWithoutWorkersRunsInCaller)
+{
+	ThreadPool pool(0);
+	const auto threads = RecordThreads(pool, 100, 0);
+	EXPECT_TRUE(std::ranges::all_of(threads, [](std::thread::id id) { return id == std::this_thread::get_id(); }));
+}
+
+TEST(ThreadPoolTest, ParallelForPropagatesException)
+{
+	ThreadPool pool(4);
+	std::atomic<size_t> visited{ 0 };
+	EXPECT_THROW(pool.ParallelFor(0, 10'000, 1, [&visited](size_t i) {
+		visited.fetch_add(1, std::memory_order_relaxed);
+		if (i == 10)
+		{
+			throw std::runtime_error("chunk failed");
+		}
+	}),
+		std::runtime_error);
+	// После ошибки оставшиеся куски пропускаются
+	EXPECT_LT(visited.load(), 10'000u);
+
+	std::atomic<size_t> count{ 0 };
+	pool.ParallelFor(0, 100, 0, [&count](size_t) { count.fetch_add(1, std::memory_order_relaxed); });
+	EXPECT_EQ(100u, count.load());
+}
+
+TEST(ThreadPoolTest, ParallelForInsideTaskDoesNotDeadlock)
+{
+	ThreadPool pool(2);
+	auto future = pool.Enqueue([&pool] {
+		std::atomic<size_t> sum{ 0 };
+		pool.ParallelFor(0, 1000, 10, [&sum](size_t i) { sum.fetch_add(i, std::memory_order_relaxed); });
+		return sum.load();
+	});
+	ASSERT_EQ(std::future_status::ready, future.wait_for(WaitTimeout));
+	EXPECT_EQ(999u * 1000 / 2, future.get());
+}
+
+TEST(ThreadPoolTest, ParallelMapKeepsIndexOrder)
+{
+	ThreadPool pool(4);
+	const auto squares = pool.ParallelMap(10, 1010, 0, [](size_t i) { return i * i; });
+	ASSERT_EQ(1000u, squares.size());
+	for (size_t i = 0; i < squares.size(); ++i)
+	{
+		EXPECT_EQ((i + 10) * (i + 10), squares[i]);
+	}
+	EXPECT_TRUE(pool.ParallelMap(3, 3, 0, [](size_t i) { return i; }).empty());
+}
+
+TEST(ThreadPoolTest, ParallelMapPropagatesException)
+{
+	ThreadPool pool(2);
+	EXPECT_THROW(pool.ParallelMap(0, 100, 1, [](size_t i) -> int {
+		if (i == 50)
+		{
+			throw std::out_of_range("bad index");
+		}
+		return 0;
+	}),
+		std::out_of_range);
+}
+
+TEST(ThreadPoolTest, ParallelReduceSumsRange)
+{
+	ThreadPool pool(4);
+	for (const size_t grainSize : { size_t{ 0 }, size_t{ 1 }, size_t{ 333 } })
+	{
+		const auto sum = pool.ParallelReduce(
+			1, 10'001, grainSize, std::uint64_t{ 0 },
+			[](size_t i) { return std::uint64_t{ i }; },
+			[](std::uint64_t a, std::uint64_t b) { return a + b; });
+		EXPECT_EQ(10'000u * 10'001 / 2, sum) << "grain " << grainSize;
+	}
+}
+
+TEST(ThreadPoolTest, ParallelReduceOnEmptyRangeReturnsIdentity)
+{
+	ThreadPool pool(2);
+	const auto product = pool.ParallelReduce(
+		4, 4, 0, 1, [](size_t) { return 0; }, [](int a, int b) { return a * b; });
+	EXPECT_EQ(1, product);
+}
+
+TEST(ThreadPoolTest, ParallelReducePropagatesException)
+{
+	ThreadPool pool(2);
+	EXPECT_THROW(pool.ParallelReduce(
+					 0, 100, 1, 0,
+					 [](size_t i) {
+						 if (i == 99)
+						 {
+							 throw std::runtime_error("map failed");
+						 }
+						 return 1;
+					 },
+					 [](int a, int b) { return a + b; }),
+		std::runtime_error);
+}
\ No newline at end of file
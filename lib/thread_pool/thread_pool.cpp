@@ -1 +1,336 @@
-#include "ThreadPool.h"
\ No newline at end of file
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+
+thread_local ThreadPool* ThreadPool::t_currentPool = nullptr;
+thread_local size_t ThreadPool::t_workerIndex = 0;
+
+// Состояние одного вызова ParallelFor. Живёт, пока на него ссылаются задачи-помощники,
+// даже если вызывающий поток уже вернулся: опоздавшие помощники просто не найдут работы.
+struct ThreadPool::Batch
+{
+	ChunkBody body;
+	size_t end;
+	size_t grainSize;
+	size_t participants;
+	size_t total;
+	std::atomic<size_t> next;
+	std::atomic<size_t> completed{ 0 };
+	std::atomic<bool> failed{ false };
+	std::mutex errorMutex;
+	std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(size_t numThreads, SchedulingMode mode)
+	: m_mode(mode)
+{
+	const size_t queueCount = (m_mode == SchedulingMode::WorkStealing && numThreads > 0) ? numThreads : 1;
+	m_queues.reserve(queueCount);
+	for (size_t i = 0; i < queueCount; ++i)
+	{
+		m_queues.push_back(std::make_unique<WorkQueue>());
+	}
+
+	m_workers.reserve(numThreads);
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		m_workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(m_sleepMutex);
+		m_stopFlag = true;
+	}
+	m_stateChanged.notify_all();
+	m_workers.clear();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock lock(m_sleepMutex);
+	m_tasksEmpty.wait(lock, [this] {
+		return m_activeTasks.load(std::memory_order_acquire) == 0;
+	});
+}
+
+void ThreadPool::Submit(Task task)
+{
+	if (m_stopFlag.load(std::memory_order_relaxed))
+	{
+		throw std::runtime_error("enqueue on stopped ThreadPool");
+	}
+
+	size_t queueIndex = 0;
+	if (m_mode == SchedulingMode::WorkStealing)
+	{
+		// Задача, порождённая воркером, остаётся в его очереди, внешние раскидываются по кругу
+		queueIndex = (t_currentPool == this)
+			? t_workerIndex
+			: m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+	}
+
+	m_activeTasks.fetch_add(1, std::memory_order_relaxed);
+	// Счётчик увеличивается до публикации задачи, чтобы не уйти в отрицательные значения
+	m_queuedTasks.fetch_add(1, std::memory_order_seq_cst);
+	{
+		auto& queue = *m_queues[queueIndex];
+		std::lock_guard lock(queue.mutex);
+		queue.tasks.PushBack(std::move(task));
+	}
+
+	// Воркер увеличивает m_sleepingWorkers под m_sleepMutex до проверки m_queuedTasks,
+	// поэтому либо он увидит новую задачу, либо мы увидим его и разбудим
+	if (m_sleepingWorkers.load(std::memory_order_seq_cst) > 0)
+	{
+		{
+			std::lock_guard lock(m_sleepMutex);
+		}
+		m_stateChanged.notify_one();
+	}
+}
+
+void ThreadPool::RunBatch(size_t begin, size_t end, size_t grainSize, ChunkBody body)
+{
+	if (begin >= end)
+	{
+		return;
+	}
+
+	const size_t total = end - begin;
+	const size_t participants = m_workers.size() + 1;
+	if (grainSize == 0)
+	{
+		grainSize = std::max<size_t>(1, total / (participants * 8));
+	}
+
+	auto batch = std::make_shared<Batch>();
+	batch->body = body;
+	batch->end = end;
+	batch->grainSize = grainSize;
+	batch->participants = participants;
+	batch->total = total;
+	batch->next = begin;
+
+	// Помощников не больше, чем может найтись кусков; каждый ставится в очередь один раз
+	const size_t maxChunks = (total + grainSize - 1) / grainSize;
+	const size_t helpers = std::min(m_workers.size(), maxChunks - 1);
+	for (size_t i = 0; i < helpers; ++i)
+	{
+		Submit([batch] {
+			RunBatchChunks(*batch);
+		});
+	}
+
+	RunBatchChunks(*batch);
+
+	for (size_t done = batch->completed.load(std::memory_order_acquire); done != total;
+		done = batch->completed.load(std::memory_order_acquire))
+	{
+		batch->completed.wait(done, std::memory_order_acquire);
+	}
+
+	if (batch->error)
+	{
+		std::rethrow_exception(batch->error);
+	}
+}
+
+void ThreadPool::RunBatchChunks(Batch& batch)
+{
+	while (true)
+	{
+		// Кусок пропорционален оставшейся работе: крупный в начале, мелкий к концу
+		size_t chunkBegin = batch.next.load(std::memory_order_relaxed);
+		size_t chunkSize = 0;
+		do
+		{
+			const size_t remaining = batch.end - chunkBegin;
+			if (remaining == 0)
+			{
+				return;
+			}
+			chunkSize = std::min(remaining, std::max(batch.grainSize, remaining / (batch.participants * 2)));
+		} while (!batch.next.compare_exchange_weak(chunkBegin, chunkBegin + chunkSize, std::memory_order_relaxed));
+
+		if (!batch.failed.load(std::memory_order_relaxed))
+		{
+			try
+			{
+				batch.body.invoke(batch.body.context, chunkBegin, chunkBegin + chunkSize);
+			}
+			catch (...)
+			{
+				std::lock_guard lock(batch.errorMutex);
+				if (!batch.error)
+				{
+					batch.error = std::current_exception();
+				}
+				batch.failed.store(true, std::memory_order_relaxed);
+			}
+		}
+
+		if (batch.completed.fetch_add(chunkSize, std::memory_order_acq_rel) + chunkSize == batch.total)
+		{
+			batch.completed.notify_all();
+		}
+	}
+}
+
+bool ThreadPool::TryPopTask(size_t workerIndex, Task& task)
+{
+	if (TryPopLocal(workerIndex, task) || TrySteal(workerIndex, task))
+	{
+		m_queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+bool ThreadPool::TryPopLocal(size_t workerIndex, Task& task)
+{
+	auto& queue = *m_queues[workerIndex % m_queues.size()];
+	std::lock_guard lock(queue.mutex);
+	if (queue.tasks.Empty())
+	{
+		return false;
+	}
+
+	if (m_mode == SchedulingMode::WorkStealing)
+	{
+		// Свежие задачи своей очереди берутся с конца: их данные ещё в кэше
+		task = queue.tasks.PopBack();
+	}
+	else
+	{
+		task = queue.tasks.PopFront();
+	}
+	return true;
+}
+
+bool ThreadPool::TrySteal(size_t workerIndex, Task& task)
+{
+	const size_t queueCount = m_queues.size();
+	// Первый проход не ждёт занятые очереди, второй нужен, чтобы не пропустить задачу из-за конкуренции
+	for (const bool blocking : { false, true })
+	{
+		for (size_t offset = 1; offset < queueCount; ++offset)
+		{
+			auto& victim = *m_queues[(workerIndex + offset) % queueCount];
+			std::unique_lock lock(victim.mutex, std::defer_lock);
+			if (blocking)
+			{
+				lock.lock();
+			}
+			else if (!lock.try_lock())
+			{
+				continue;
+			}
+
+			if (victim.tasks.Empty())
+			{
+				continue;
+			}
+			task = victim.tasks.PopFront();
+			return true;
+		}
+
+		if (m_queuedTasks.load(std::memory_order_relaxed) == 0)
+		{
+			break;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::RunTask(Task& task)
+{
+	try
+	{
+		task();
+	}
+	catch (...)
+	{
+	}
+
+	if (m_activeTasks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		{
+			std::lock_guard lock(m_sleepMutex);
+		}
+		m_tasksEmpty.notify_all();
+	}
+}
+
+void ThreadPool::TaskRing::PushBack(Task&& task)
+{
+	if (m_count == m_buffer.size())
+	{
+		Grow();
+	}
+	m_buffer[(m_head + m_count) % m_buffer.size()] = std::move(task);
+	++m_count;
+}
+
+ThreadPool::Task ThreadPool::TaskRing::PopBack()
+{
+	--m_count;
+	return std::move(m_buffer[(m_head + m_count) % m_buffer.size()]);
+}
+
+ThreadPool::Task ThreadPool::TaskRing::PopFront()
+{
+	Task task = std::move(m_buffer[m_head]);
+	m_head = (m_head + 1) % m_buffer.size();
+	--m_count;
+	return task;
+}
+
+void ThreadPool::TaskRing::Grow()
+{
+	std::vector<Task> buffer(m_buffer.empty() ? 64 : m_buffer.size() * 2);
+	for (size_t i = 0; i < m_count; ++i)
+	{
+		buffer[i] = std::move(m_buffer[(m_head + i) % m_buffer.size()]);
+	}
+	m_buffer = std::move(buffer);
+	m_head = 0;
+}
+
+void ThreadPool::WorkerLoop(size_t workerIndex)
+{
+	t_currentPool = this;
+	t_workerIndex = workerIndex;
+
+	while (true)
+	{
+		if (Task task; TryPopTask(workerIndex, task))
+		{
+			RunTask(task);
+			continue;
+		}
+
+		if (m_queuedTasks.load(std::memory_order_relaxed) > 0)
+		{
+			// Задача учтена, но ещё не положена в очередь или её перехватил другой поток
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock lock(m_sleepMutex);
+		m_sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+		m_stateChanged.wait(lock, [this] {
+			return m_stopFlag.load(std::memory_order_relaxed)
+				|| m_queuedTasks.load(std::memory_order_seq_cst) > 0;
+		});
+		m_sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+
+		if (m_stopFlag.load(std::memory_order_relaxed) && m_queuedTasks.load(std::memory_order_relaxed) == 0)
+		{
+			return;
+		}
+	}
+}
\ No newline at end of file
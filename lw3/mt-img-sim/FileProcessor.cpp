@@ -1,5 +1,7 @@
 #include "FileProcessor.h"
 
+#include <algorithm>
+
 bool FileProcessor::IsImageFile(const std::filesystem::path& path)
 {
 	auto extension = path.extension().string();
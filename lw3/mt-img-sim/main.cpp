@@ -6,7 +6,6 @@
 #include <algorithm>
 #include <cctype>
 #include <filesystem>
-#include <future>
 #include <iostream>
 #include <limits>
 #include <optional>
@@ -31,39 +30,30 @@ std::vector<Result> ProcessCandidateImages(
 	const std::vector<unsigned char>& querySRGB,
 	int numThreads)
 {
-	std::vector<std::future<Result>> tasks;
 	ThreadPool pool(numThreads);
 
-	for (const auto& path : files)
-	{
-		auto task = pool.Enqueue([querySRGB, path]() -> Result {
-			try
-			{
-				const auto img = ImageProcessor::LoadImageAsRGB(path.string());
-				const auto resized = ImageProcessor::ResizeBilinear(img, 256, 256);
-				const auto linear = ImageProcessor::ApplyGammaToLinear(resized);
-				const auto candidateSRGB = ImageProcessor::ConvertLinearToSRGB(linear);
-				const double mse = ImageProcessor::ComputeMSE(querySRGB, candidateSRGB);
-				return { mse, path };
-			}
-			catch (...)
-			{
-				return { std::numeric_limits<double>::max(), path };
-			}
-		});
-		tasks.push_back(std::move(task));
-	}
-
-	std::vector<Result> validResults;
-	for (auto& task : tasks)
-	{
-		if (auto result = task.get(); result.mse != std::numeric_limits<double>::max())
+	auto results = pool.ParallelMap(0, files.size(), 1, [&files, &querySRGB](size_t i) -> Result {
+		const auto& path = files[i];
+		try
 		{
-			validResults.push_back(result);
+			const auto img = ImageProcessor::LoadImageAsRGB(path.string());
+			const auto resized = ImageProcessor::ResizeBilinear(img, 256, 256);
+			const auto linear = ImageProcessor::ApplyGammaToLinear(resized);
+			const auto candidateSRGB = ImageProcessor::ConvertLinearToSRGB(linear);
+			const double mse = ImageProcessor::ComputeMSE(querySRGB, candidateSRGB);
+			return { mse, path };
 		}
-	}
+		catch (...)
+		{
+			return { std::numeric_limits<double>::max(), path };
+		}
+	});
+
+	std::erase_if(results, [](const Result& result) {
+		return result.mse == std::numeric_limits<double>::max();
+	});
 
-	return validResults;
+	return results;
 }
 
 std::vector<Result> FilterResults(const std::vector<Result>& results, const ArgsParser::Args& args)
@@ -1,11 +1,11 @@
 #include "ArgsParser.h"
 #include "FileProcessor.h"
 #include "StatsCounter.h"
+#include "TaskGroup.h"
 #include "ThreadPool.h"
 #include "ThumbnailGenerator.h"
 
 #include <filesystem>
-#include <future>
 #include <iostream>
 #include <vector>
 
@@ -22,29 +22,24 @@ void GenerateThumbnails(const std::optional<ArgsParser::Args>& args)
 	StatsCounter stats;
 
 	ThreadPool pool(args->numberOfThreads);
-	std::vector<std::future<void>> tasks;
-	tasks.reserve(files.size());
+	TaskGroup group(pool);
 
 	for (const auto& file : files)
 	{
-		tasks.push_back(pool.Enqueue(
-			[&generator, &stats, &file, &args]() {
-				if (generator.GenerateThumbnail(file, args->inputDirPath, args->outputDirPath))
-				{
-					stats.IncrementProcessed();
-				}
-				else
-				{
-					stats.IncrementFailed();
-					std::cerr << "Failed to process " << file << std::endl;
-				}
-			}));
+		group.Run([&generator, &stats, &file, &args]() {
+			if (generator.GenerateThumbnail(file, args->inputDirPath, args->outputDirPath))
+			{
+				stats.IncrementProcessed();
+			}
+			else
+			{
+				stats.IncrementFailed();
+				std::cerr << "Failed to process " << file << std::endl;
+			}
+		});
 	}
 
-	for (auto& task : tasks)
-	{
-		task.wait();
-	}
+	group.Wait();
 
 	std::cout << "processed=" << stats.GetProcessedFilesCount() << " failed=" << stats.GetFailedFilesCount() << std::endl;
 }
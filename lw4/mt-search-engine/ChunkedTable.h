@@ -0,0 +1,171 @@
+#pragma once
+
+#include "EpochReclaimer.h"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Таблица объектов по плотному индексу. Объект находится без блокировок: куски таблицы
+// не перемещаются, а каталог кусков при росте заменяется копией большего размера. Кусок, где не
+// осталось объектов, освобождается, так что память следует за живыми элементами, а не за наибольшим
+// индексом. Заменённые каталоги и куски освобождаются через EpochReclaimer, поэтому читатель должен
+// держать закрепление эпохи. Писатели упорядочиваются снаружи
+template <typename T, std::size_t ChunkSize = 1024>
+class ChunkedTable
+{
+public:
+	explicit ChunkedTable(EpochReclaimer& reclaimer)
+		: m_reclaimer(&reclaimer)
+	{
+	}
+
+	~ChunkedTable()
+	{
+		const ChunkDirectory* directory = m_directory.load(std::memory_order_relaxed);
+		if (!directory)
+		{
+			return;
+		}
+		for (std::size_t i = 0; i < directory->size; ++i)
+		{
+			if (const Chunk* chunk = directory->chunks[i].load(std::memory_order_relaxed))
+			{
+				for (const auto& slot : chunk->slots)
+				{
+					delete slot.load(std::memory_order_relaxed);
+				}
+				delete chunk;
+			}
+		}
+		delete directory;
+	}
+
+	ChunkedTable(const ChunkedTable&) = delete;
+	ChunkedTable& operator=(const ChunkedTable&) = delete;
+
+	// nullptr, если элемента нет
+	const T* Load(std::size_t index) const
+	{
+		return Find(index);
+	}
+	// Для писателя, который меняет объект на месте
+	T* Load(std::size_t index)
+	{
+		return Find(index);
+	}
+
+	// Публикует value вместо прежнего объекта, nullptr удаляет элемент. Прежний объект ещё могут
+	// читать, поэтому он возвращается писателю для освобождения через EpochReclaimer
+	T* Exchange(std::size_t index, T* value)
+	{
+		const std::size_t chunkIndex = index / ChunkSize;
+		ChunkDirectory* directory = m_directory.load(std::memory_order_relaxed);
+		Chunk* chunk = directory && chunkIndex < directory->size
+			? directory->chunks[chunkIndex].load(std::memory_order_relaxed)
+			: nullptr;
+		if (!chunk)
+		{
+			if (!value)
+			{
+				return nullptr;
+			}
+			directory = Reserve(chunkIndex);
+			chunk = new Chunk();
+			directory->chunks[chunkIndex].store(chunk, std::memory_order_release);
+		}
+
+		T* previous = chunk->slots[index % ChunkSize].exchange(value, std::memory_order_acq_rel);
+		if (value && !previous)
+		{
+			++chunk->count;
+		}
+		else if (!value && previous && --chunk->count == 0)
+		{
+			directory->chunks[chunkIndex].store(nullptr, std::memory_order_release);
+			m_reclaimer->Retire(static_cast<const Chunk*>(chunk));
+		}
+		return previous;
+	}
+
+	// Обходит элементы по возрастанию индекса, fn получает индекс и объект
+	template <typename F>
+	void ForEach(F&& fn) const
+	{
+		const ChunkDirectory* directory = m_directory.load(std::memory_order_acquire);
+		for (std::size_t i = 0; directory && i < directory->size; ++i)
+		{
+			const Chunk* chunk = directory->chunks[i].load(std::memory_order_acquire);
+			for (std::size_t j = 0; chunk && j < ChunkSize; ++j)
+			{
+				if (const T* item = chunk->slots[j].load(std::memory_order_acquire))
+				{
+					fn(i * ChunkSize + j, *item);
+				}
+			}
+		}
+	}
+
+private:
+	struct Chunk
+	{
+		std::array<std::atomic<T*>, ChunkSize> slots{};
+		// Число занятых ячеек, меняется только писателем
+		std::size_t count = 0;
+	};
+
+	struct ChunkDirectory
+	{
+		explicit ChunkDirectory(std::size_t chunkCount)
+			: size(chunkCount)
+			, chunks(std::make_unique<std::atomic<Chunk*>[]>(chunkCount))
+		{
+		}
+
+		std::size_t size;
+		std::unique_ptr<std::atomic<Chunk*>[]> chunks;
+	};
+
+	T* Find(std::size_t index) const
+	{
+		const ChunkDirectory* directory = m_directory.load(std::memory_order_acquire);
+		const std::size_t chunkIndex = index / ChunkSize;
+		if (!directory || chunkIndex >= directory->size)
+		{
+			return nullptr;
+		}
+		const Chunk* chunk = directory->chunks[chunkIndex].load(std::memory_order_acquire);
+		return chunk ? chunk->slots[index % ChunkSize].load(std::memory_order_acquire) : nullptr;
+	}
+
+	// Каталог, вмещающий кусок chunkIndex. Куски переходят в новый каталог, старый освобождается
+	// через EpochReclaimer и остаётся верным для читателей, которые успели его взять
+	ChunkDirectory* Reserve(std::size_t chunkIndex)
+	{
+		ChunkDirectory* directory = m_directory.load(std::memory_order_relaxed);
+		if (directory && chunkIndex < directory->size)
+		{
+			return directory;
+		}
+		std::size_t size = directory ? directory->size : 1;
+		while (size <= chunkIndex)
+		{
+			size *= 2;
+		}
+		auto grown = std::make_unique<ChunkDirectory>(size);
+		for (std::size_t i = 0; directory && i < directory->size; ++i)
+		{
+			grown->chunks[i].store(directory->chunks[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+		m_directory.store(grown.get(), std::memory_order_release);
+		if (directory)
+		{
+			m_reclaimer->Retire(static_cast<const ChunkDirectory*>(directory));
+		}
+		return grown.release();
+	}
+
+	EpochReclaimer* m_reclaimer;
+	std::atomic<ChunkDirectory*> m_directory = nullptr;
+};
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include "ConcurrentPostingList.h"
+
+#include <algorithm>
+
+namespace
+{
+// Разность docId и два поля полезной нагрузки в varint
+constexpr std::size_t MaxEntrySize = 10 + 2 * 5;
+constexpr std::size_t InitialByteCapacity = 32;
+
+std::size_t WriteVarint(std::uint8_t* out, std::uint64_t value)
+{
+	std::size_t size = 0;
+	while (value >= 0x80)
+	{
+		out[size++] = static_cast<std::uint8_t>(value | 0x80);
+		value >>= 7;
+	}
+	out[size++] = static_cast<std::uint8_t>(value);
+	return size;
+}
+} // namespace
+
+ConcurrentPostingList::ConcurrentPostingList(bool withPayload)
+	: m_withPayload(withPayload)
+{
+}
+
+PostingListView ConcurrentPostingList::GetView() const
+{
+	State state;
+	for (;;)
+	{
+		const std::uint64_t sequence = m_sequence.load(std::memory_order_acquire);
+		const PublishedState& published = m_published[sequence & 1];
+		state.storage = published.storage.load(std::memory_order_relaxed);
+		state.closedCount = published.closedCount.load(std::memory_order_relaxed);
+		state.byteCount = published.byteCount.load(std::memory_order_relaxed);
+		state.size = published.size.load(std::memory_order_relaxed);
+		state.lastSkip = {
+			published.firstDocId.load(std::memory_order_relaxed),
+			published.lastDocId.load(std::memory_order_relaxed),
+			published.offset.load(std::memory_order_relaxed),
+			published.count.load(std::memory_order_relaxed),
+		};
+		// Копия цела, если писатель за это время не взялся за неё снова
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (m_sequence.load(std::memory_order_relaxed) == sequence)
+		{
+			break;
+		}
+	}
+
+	if (state.size == 0)
+	{
+		return PostingListView();
+	}
+	return PostingListView({ state.storage->skips.get(), state.closedCount }, state.lastSkip,
+		{ state.storage->bytes.get(), state.byteCount }, state.size, m_withPayload);
+}
+
+void ConcurrentPostingList::Add(std::uint64_t docId, Payload payload, std::vector<std::unique_ptr<const Storage>>& retired)
+{
+	if (m_state.size > 0 && docId <= m_state.lastSkip.lastDocId)
+	{
+		// Вставка в середину переписывает блок, который могут читать
+		PostingList list(GetView());
+		list.Add(docId, payload);
+		Replace(list, retired);
+		return;
+	}
+
+	// Идентификаторы выдаются по возрастанию, поэтому обычно хватает дописать хвост
+	const bool startsBlock = m_state.size == 0 || m_state.lastSkip.count == PostingListView::BlockSize;
+	const std::size_t closedCount = m_state.closedCount + (startsBlock && m_state.size > 0 ? 1 : 0);
+	const std::size_t byteCount = m_state.byteCount + MaxEntrySize;
+	if (!m_storage || closedCount > m_storage->skipCapacity || byteCount > m_storage->byteCapacity)
+	{
+		Reserve(closedCount, byteCount, retired);
+	}
+
+	State state = m_state;
+	state.storage = m_storage.get();
+	std::uint8_t* const bytes = m_storage->bytes.get();
+	std::size_t written = state.byteCount;
+	if (startsBlock)
+	{
+		if (state.size > 0)
+		{
+			m_storage->skips[state.closedCount++] = state.lastSkip;
+		}
+		state.lastSkip = { docId, docId, static_cast<std::uint32_t>(written), 1 };
+	}
+	else
+	{
+		written += WriteVarint(bytes + written, docId - state.lastSkip.lastDocId);
+		state.lastSkip.lastDocId = docId;
+		++state.lastSkip.count;
+	}
+	if (m_withPayload)
+	{
+		written += WriteVarint(bytes + written, payload.frequency);
+		written += WriteVarint(bytes + written, payload.documentLength);
+	}
+	state.byteCount = written;
+	++state.size;
+
+	m_state = state;
+	Publish();
+}
+
+bool ConcurrentPostingList::Remove(std::uint64_t docId, std::vector<std::unique_ptr<const Storage>>& retired)
+{
+	const PostingListView view = GetView();
+	if (!view.Contains(docId))
+	{
+		return false;
+	}
+	PostingList list(view);
+	list.Remove(docId);
+	Replace(list, retired);
+	return true;
+}
+
+void ConcurrentPostingList::Store(PublishedState& target, const State& state)
+{
+	target.storage.store(state.storage, std::memory_order_relaxed);
+	target.closedCount.store(state.closedCount, std::memory_order_relaxed);
+	target.byteCount.store(state.byteCount, std::memory_order_relaxed);
+	target.size.store(state.size, std::memory_order_relaxed);
+	target.firstDocId.store(state.lastSkip.firstDocId, std::memory_order_relaxed);
+	target.lastDocId.store(state.lastSkip.lastDocId, std::memory_order_relaxed);
+	target.offset.store(state.lastSkip.offset, std::memory_order_relaxed);
+	target.count.store(state.lastSkip.count, std::memory_order_relaxed);
+}
+
+void ConcurrentPostingList::Publish()
+{
+	// Читатель, заставший копию посреди записи, увидит новый счётчик и перечитает её
+	const std::uint64_t sequence = m_sequence.load(std::memory_order_relaxed);
+	m_sequence.store(sequence + 1, std::memory_order_release);
+	std::atomic_thread_fence(std::memory_order_release);
+	Store(m_published[0], m_state);
+	m_sequence.store(sequence + 2, std::memory_order_release);
+	std::atomic_thread_fence(std::memory_order_release);
+	Store(m_published[1], m_state);
+}
+
+void ConcurrentPostingList::Reserve(std::size_t skipCount, std::size_t byteCount,
+	std::vector<std::unique_ptr<const Storage>>& retired)
+{
+	const std::size_t skipCapacity = m_storage ? m_storage->skipCapacity : 0;
+	const std::size_t byteCapacity = m_storage ? m_storage->byteCapacity : 0;
+
+	// Ёмкость удваивается, так что переезды в сумме линейны по длине списка
+	auto grown = std::make_unique<Storage>();
+	grown->skipCapacity = skipCount > skipCapacity ? std::max(skipCount, skipCapacity * 2) : skipCapacity;
+	grown->byteCapacity = std::max({ byteCount, byteCapacity * 2, InitialByteCapacity });
+	grown->skips = std::make_unique_for_overwrite<SkipEntry[]>(grown->skipCapacity);
+	grown->bytes = std::make_unique_for_overwrite<std::uint8_t[]>(grown->byteCapacity);
+	if (m_storage)
+	{
+		std::copy_n(m_storage->skips.get(), m_state.closedCount, grown->skips.get());
+		std::copy_n(m_storage->bytes.get(), m_state.byteCount, grown->bytes.get());
+		retired.push_back(std::move(m_storage));
+	}
+	m_storage = std::move(grown);
+}
+
+void ConcurrentPostingList::Replace(const PostingList& list, std::vector<std::unique_ptr<const Storage>>& retired)
+{
+	const PostingListView view = list.GetView();
+	auto storage = std::make_unique<Storage>();
+	State state;
+	state.storage = storage.get();
+	if (!view.IsEmpty())
+	{
+		storage->skipCapacity = view.m_skips.size();
+		storage->byteCapacity = view.m_bytes.size() + MaxEntrySize;
+		storage->skips = std::make_unique_for_overwrite<SkipEntry[]>(storage->skipCapacity);
+		storage->bytes = std::make_unique_for_overwrite<std::uint8_t[]>(storage->byteCapacity);
+		std::copy(view.m_skips.begin(), view.m_skips.end(), storage->skips.get());
+		std::copy(view.m_bytes.begin(), view.m_bytes.end(), storage->bytes.get());
+		state.closedCount = view.m_skips.size();
+		state.byteCount = view.m_bytes.size();
+		state.size = view.m_size;
+		state.lastSkip = view.m_lastSkip;
+	}
+	if (m_storage)
+	{
+		retired.push_back(std::move(m_storage));
+	}
+	m_storage = std::move(storage);
+	m_state = state;
+	Publish();
+}
+
+TermPostingsView ConcurrentTermPostings::GetView() const
+{
+	// Экстремумы читаются после списка и потому не старее его
+	const PostingListView view = docs.GetView();
+	return {
+		view,
+		maxNormalizedTf.load(std::memory_order_relaxed),
+		maxFrequency.load(std::memory_order_relaxed),
+		minDocumentLength.load(std::memory_order_relaxed),
+	};
+}
+
+void ConcurrentTermPostings::Add(std::uint64_t docId, PostingListView::Payload payload,
+	std::vector<std::unique_ptr<const ConcurrentPostingList::Storage>>& retired)
+{
+	// Писатель один, так что хватает чтения и записи без сравнения с обменом
+	const double normalizedTf = static_cast<double>(payload.frequency) / static_cast<double>(payload.documentLength);
+	maxNormalizedTf.store(std::max(maxNormalizedTf.load(std::memory_order_relaxed), normalizedTf), std::memory_order_relaxed);
+	maxFrequency.store(std::max(maxFrequency.load(std::memory_order_relaxed), payload.frequency), std::memory_order_relaxed);
+	minDocumentLength.store(std::min(minDocumentLength.load(std::memory_order_relaxed), payload.documentLength),
+		std::memory_order_relaxed);
+	docs.Add(docId, payload, retired);
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "PostingList.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+// Список постингов изменяемого сегмента: один писатель меняет его, а читатели без блокировок
+// берут вид на опубликованное состояние. Возрастающие docId дописываются в хранилище на месте,
+// за границей, которую видят читатели. Когда хранилище переполняется, а также при вставке
+// в середину и удалении, список переезжает в новое хранилище, а старое отдаётся писателю:
+// его ещё могут читать, поэтому освобождать его нужно через EpochReclaimer.
+// Состояние публикуется в двух копиях с общим счётчиком: пока писатель правит одну, читатели
+// берут другую, так что они не ждут писателя, даже если тот прервался посреди записи
+class ConcurrentPostingList
+{
+public:
+	using Payload = PostingListView::Payload;
+
+	// Записи закрытых блоков и байты всех блоков. Ёмкость постоянна, пишется только хвост
+	struct Storage
+	{
+		std::unique_ptr<PostingListView::SkipEntry[]> skips;
+		std::size_t skipCapacity = 0;
+		std::unique_ptr<std::uint8_t[]> bytes;
+		std::size_t byteCapacity = 0;
+	};
+
+	explicit ConcurrentPostingList(bool withPayload = false);
+
+	ConcurrentPostingList(const ConcurrentPostingList&) = delete;
+	ConcurrentPostingList& operator=(const ConcurrentPostingList&) = delete;
+
+	// Вид действителен, пока не освобождено хранилище, на которое он смотрит
+	PostingListView GetView() const;
+
+	// Вызываются писателем. Хранилища, из которых список переехал, добавляются в retired
+	void Add(std::uint64_t docId, Payload payload, std::vector<std::unique_ptr<const Storage>>& retired);
+	bool Remove(std::uint64_t docId, std::vector<std::unique_ptr<const Storage>>& retired);
+
+private:
+	using SkipEntry = PostingListView::SkipEntry;
+
+	// Всё, что нужно для вида: закрытые блоки лежат в хранилище, последний — здесь
+	struct State
+	{
+		const Storage* storage = nullptr;
+		std::size_t closedCount = 0;
+		std::size_t byteCount = 0;
+		std::size_t size = 0;
+		SkipEntry lastSkip{};
+	};
+
+	struct PublishedState
+	{
+		std::atomic<const Storage*> storage = nullptr;
+		std::atomic<std::size_t> closedCount = 0;
+		std::atomic<std::size_t> byteCount = 0;
+		std::atomic<std::size_t> size = 0;
+		std::atomic<std::uint64_t> firstDocId = 0;
+		std::atomic<std::uint64_t> lastDocId = 0;
+		std::atomic<std::uint32_t> offset = 0;
+		std::atomic<std::uint32_t> count = 0;
+	};
+
+	static void Store(PublishedState& target, const State& state);
+	// Публикует m_state: сначала копия, которую читатели сейчас не берут, затем вторая
+	void Publish();
+	// Переносит список в хранилище с местом под skipCount закрытых блоков и byteCount байтов
+	void Reserve(std::size_t skipCount, std::size_t byteCount, std::vector<std::unique_ptr<const Storage>>& retired);
+	// Переносит список в новое хранилище с содержимым list
+	void Replace(const PostingList& list, std::vector<std::unique_ptr<const Storage>>& retired);
+
+	const bool m_withPayload;
+	// Состояние и хранилище писателя
+	State m_state;
+	std::unique_ptr<Storage> m_storage;
+	// Нечётный счётчик — читатели берут копию 1, чётный — копию 0
+	std::atomic<std::uint64_t> m_sequence = 0;
+	PublishedState m_published[2];
+};
+
+// Постинги терма изменяемого сегмента. Экстремумы обновляются до публикации документа,
+// поэтому читатель получает их не старее списка, а границы остаются верными
+struct ConcurrentTermPostings
+{
+	ConcurrentPostingList docs = ConcurrentPostingList(true);
+	std::atomic<double> maxNormalizedTf = 0.0;
+	std::atomic<std::uint32_t> maxFrequency = 0;
+	std::atomic<std::uint32_t> minDocumentLength = std::numeric_limits<std::uint32_t>::max();
+
+	TermPostingsView GetView() const;
+	void Add(std::uint64_t docId, PostingListView::Payload payload,
+		std::vector<std::unique_ptr<const ConcurrentPostingList::Storage>>& retired);
+};
\ No newline at end of file
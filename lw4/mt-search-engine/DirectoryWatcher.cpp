@@ -0,0 +1,248 @@
+#include "DirectoryWatcher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace
+{
+// IN_ATTRIB сообщает об изменении времени модификации без записи (touch, восстановление из архива).
+// IN_MODIFY не отслеживается: он приходит на каждую запись, и файл индексировался бы недописанным.
+// Поэтому файл, который держат открытым на запись или меняют через mmap, переиндексируется
+// только после закрытия
+constexpr std::uint32_t WatchMask = IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+constexpr std::size_t EventBufferSize = 64 * 1024;
+
+bool IsSameOrNested(const std::string& path, const std::string& dir)
+{
+	return path.size() >= dir.size() && path.compare(0, dir.size(), dir) == 0
+		&& (path.size() == dir.size() || path[dir.size()] == '/');
+}
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher(ChangedFn onChanged, RemovedFn onRemoved, ListIndexedFn listIndexed)
+	: m_onChanged(std::move(onChanged))
+	, m_onRemoved(std::move(onRemoved))
+	, m_listIndexed(std::move(listIndexed))
+	, m_inotifyFd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+	, m_wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+	if (m_inotifyFd < 0 || m_wakeFd < 0)
+	{
+		if (m_inotifyFd >= 0)
+		{
+			close(m_inotifyFd);
+		}
+		if (m_wakeFd >= 0)
+		{
+			close(m_wakeFd);
+		}
+		throw std::runtime_error("Cannot initialize inotify");
+	}
+	m_thread = std::jthread([this](std::stop_token stopToken) { Loop(stopToken); });
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	m_thread.request_stop();
+	const std::uint64_t one = 1;
+	[[maybe_unused]] const auto written = write(m_wakeFd, &one, sizeof(one));
+	m_thread.join();
+	close(m_inotifyFd);
+	close(m_wakeFd);
+}
+
+void DirectoryWatcher::Watch(const std::filesystem::path& root)
+{
+	if (!AddWatchRecursive(root, false))
+	{
+		throw std::runtime_error("Cannot watch directory: " + root.string());
+	}
+	std::lock_guard lock(m_mutex);
+	if (std::find(m_roots.begin(), m_roots.end(), root) == m_roots.end())
+	{
+		m_roots.push_back(root);
+	}
+}
+
+std::vector<std::filesystem::path> DirectoryWatcher::GetRoots() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_roots;
+}
+
+bool DirectoryWatcher::AddWatchRecursive(const std::filesystem::path& dir, bool reportFiles)
+{
+	const int wd = inotify_add_watch(m_inotifyFd, dir.c_str(), WatchMask);
+	if (wd < 0)
+	{
+		return false;
+	}
+	{
+		std::lock_guard lock(m_mutex);
+		m_watches[wd] = dir;
+	}
+
+	// Подкаталоги обходятся после установки наблюдения, так что файл, появившийся в промежутке,
+	// будет сообщён хотя бы один раз. Ссылки на каталоги не обходятся
+	std::error_code error;
+	for (auto it = std::filesystem::directory_iterator(dir, error); !error && it != std::filesystem::directory_iterator(); it.increment(error))
+	{
+		std::error_code statusError;
+		if (it->is_symlink(statusError))
+		{
+			if (reportFiles && it->is_regular_file(statusError))
+			{
+				m_onChanged(it->path());
+			}
+		}
+		else if (it->is_directory(statusError))
+		{
+			AddWatchRecursive(it->path(), reportFiles);
+		}
+		else if (reportFiles && it->is_regular_file(statusError))
+		{
+			m_onChanged(it->path());
+		}
+	}
+	return true;
+}
+
+void DirectoryWatcher::RemoveWatchesUnder(const std::filesystem::path& dir)
+{
+	std::lock_guard lock(m_mutex);
+	std::erase_if(m_watches, [&](const auto& watch) {
+		if (!IsSameOrNested(watch.second.string(), dir.string()))
+		{
+			return false;
+		}
+		inotify_rm_watch(m_inotifyFd, watch.first);
+		return true;
+	});
+}
+
+void DirectoryWatcher::Loop(std::stop_token stopToken)
+{
+	pollfd fds[] = {
+		{ m_inotifyFd, POLLIN, 0 },
+		{ m_wakeFd, POLLIN, 0 },
+	};
+	alignas(inotify_event) char buffer[EventBufferSize];
+	while (!stopToken.stop_requested())
+	{
+		if (poll(fds, std::size(fds), -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return;
+		}
+		if (fds[1].revents != 0)
+		{
+			return;
+		}
+
+		const ssize_t size = read(m_inotifyFd, buffer, sizeof(buffer));
+		if (size <= 0)
+		{
+			continue;
+		}
+		try
+		{
+			HandleEvents(buffer, static_cast<std::size_t>(size));
+		}
+		catch (...)
+		{
+			// Ошибка обработки одного файла не должна останавливать наблюдение
+		}
+	}
+}
+
+void DirectoryWatcher::HandleEvents(const char* buffer, std::size_t size)
+{
+	// События обрабатываются по порядку: файл, удалённый и созданный заново, останется в индексе
+	for (std::size_t offset = 0; offset < size;)
+	{
+		const auto& event = *reinterpret_cast<const inotify_event*>(buffer + offset);
+		offset += sizeof(inotify_event) + event.len;
+		if (event.mask & IN_Q_OVERFLOW)
+		{
+			Rescan();
+			continue;
+		}
+
+		std::filesystem::path dir;
+		{
+			std::lock_guard lock(m_mutex);
+			const auto it = m_watches.find(event.wd);
+			if (it == m_watches.end())
+			{
+				continue;
+			}
+			if (event.mask & IN_IGNORED)
+			{
+				m_watches.erase(it);
+				continue;
+			}
+			dir = it->second;
+		}
+		// События самого наблюдаемого каталога имени не содержат
+		if (event.len == 0)
+		{
+			continue;
+		}
+
+		const auto path = dir / event.name;
+		if (event.mask & IN_ISDIR)
+		{
+			if (event.mask & (IN_CREATE | IN_MOVED_TO))
+			{
+				AddWatchRecursive(path, true);
+			}
+			else if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+			{
+				RemoveWatchesUnder(path);
+				m_onRemoved(path, true);
+			}
+		}
+		else if (event.mask & (IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_TO))
+		{
+			m_onChanged(path);
+		}
+		else if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+		{
+			m_onRemoved(path, false);
+		}
+	}
+}
+
+void DirectoryWatcher::Rescan()
+{
+	for (const auto& root : GetRoots())
+	{
+		std::error_code error;
+		for (auto it = std::filesystem::recursive_directory_iterator(root, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+		{
+			std::error_code statusError;
+			if (it->is_regular_file(statusError))
+			{
+				m_onChanged(it->path());
+			}
+		}
+
+		// События удаления потеряны вместе с очередью, поэтому сверяется весь индекс дерева
+		for (const auto& path : m_listIndexed(root))
+		{
+			std::error_code statusError;
+			if (!std::filesystem::is_regular_file(path, statusError))
+			{
+				m_onRemoved(path, false);
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Следит за деревьями каталогов через inotify и в фоновом потоке сообщает только об изменившихся
+// путях. Новые подкаталоги берутся под наблюдение сразу, а их файлы сообщаются как изменённые.
+// При переполнении очереди событий ядра все файлы наблюдаемых деревьев сообщаются заново,
+// а неизменённые отсеет проверка версии при индексации. Проиндексированные файлы дерева,
+// которых больше нет на диске, сообщаются как удалённые
+class DirectoryWatcher
+{
+public:
+	using ChangedFn = std::function<void(const std::filesystem::path& path)>;
+	// isDirectory — удалён или перемещён целый каталог
+	using RemovedFn = std::function<void(const std::filesystem::path& path, bool isDirectory)>;
+	// Проиндексированные файлы дерева каталога root
+	using ListIndexedFn = std::function<std::vector<std::string>(const std::filesystem::path& root)>;
+
+	DirectoryWatcher(ChangedFn onChanged, RemovedFn onRemoved, ListIndexedFn listIndexed);
+	~DirectoryWatcher();
+
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+	void Watch(const std::filesystem::path& root);
+	std::vector<std::filesystem::path> GetRoots() const;
+
+private:
+	bool AddWatchRecursive(const std::filesystem::path& dir, bool reportFiles);
+	void RemoveWatchesUnder(const std::filesystem::path& dir);
+	void Loop(std::stop_token stopToken);
+	void HandleEvents(const char* buffer, std::size_t size);
+	void Rescan();
+
+	ChangedFn m_onChanged;
+	RemovedFn m_onRemoved;
+	ListIndexedFn m_listIndexed;
+	int m_inotifyFd;
+	// Будит поток наблюдения при остановке
+	int m_wakeFd;
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<int, std::filesystem::path> m_watches;
+	std::vector<std::filesystem::path> m_roots;
+
+	std::jthread m_thread;
+};
\ No newline at end of file
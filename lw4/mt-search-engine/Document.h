@@ -1,13 +1,45 @@
 #pragma once
 
+#include "TermDictionary.h"
+
 #include <cstdint>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Версия файла на момент индексации: по ней повторное добавление пропускает неизменённые файлы
+struct FileVersion
+{
+	// Наносекунды от эпохи
+	std::int64_t modificationTime = 0;
+	std::uint64_t size = 0;
+	std::uint64_t contentHash = 0;
+};
 
 struct Document
 {
+	// Смещение запоминается для каждого WordOffsetInterval-го слова
+	static constexpr std::size_t WordOffsetInterval = 64;
+
 	std::uint64_t id;
 	std::string path;
 	std::size_t wordCount = 0;
-	std::unordered_map<std::string, std::size_t> termFrequencies;
+	FileVersion version;
+	// Пары (идентификатор терма, число вхождений), упорядоченные по идентификатору
+	std::vector<std::pair<TermId, std::uint32_t>> termFrequencies;
+	// Номера слов, сгруппированные по термам в порядке termFrequencies
+	std::vector<std::uint32_t> positions;
+	// Смещения в байтах опорных слов: фрагмент текста читается с ближайшего из них, а не с начала файла
+	std::vector<std::uint64_t> wordOffsets;
+};
+
+// Позиции термов запроса в документе и всё, что нужно для извлечения фрагмента его текста
+struct DocumentPositions
+{
+	std::string path;
+	FileVersion version;
+	std::size_t wordCount = 0;
+	// По одному списку на терм запроса; пустой, если терма в документе нет
+	std::vector<std::vector<std::uint32_t>> termPositions;
+	std::vector<std::uint64_t> wordOffsets;
 };
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "EpochReclaimer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+// Плотные номера живых потоков: номер завершившегося потока достаётся следующему новому,
+// так что число слотов ограничено числом одновременно живущих потоков
+class ThreadIndexRegistry
+{
+public:
+	static ThreadIndexRegistry& Get()
+	{
+		static ThreadIndexRegistry registry;
+		return registry;
+	}
+
+	std::size_t Acquire()
+	{
+		std::lock_guard lock(m_mutex);
+		if (!m_free.empty())
+		{
+			const std::size_t index = m_free.back();
+			m_free.pop_back();
+			return index;
+		}
+		// Новый поток должен попасть в обход слотов раньше, чем закрепит эпоху
+		const std::size_t index = m_limit.load(std::memory_order_relaxed);
+		m_limit.store(index + 1, std::memory_order_seq_cst);
+		return index;
+	}
+
+	void Release(std::size_t index)
+	{
+		std::lock_guard lock(m_mutex);
+		m_free.push_back(index);
+	}
+
+	// Номера потоков меньше этого значения
+	std::size_t GetLimit() const
+	{
+		return m_limit.load(std::memory_order_seq_cst);
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<std::size_t> m_free;
+	std::atomic<std::size_t> m_limit = 0;
+};
+
+struct ThreadIndex
+{
+	std::size_t value = ThreadIndexRegistry::Get().Acquire();
+
+	~ThreadIndex()
+	{
+		ThreadIndexRegistry::Get().Release(value);
+	}
+};
+
+std::size_t GetCurrentThreadIndex()
+{
+	thread_local const ThreadIndex index;
+	return index.value;
+}
+} // namespace
+
+EpochReclaimer::Guard::Guard(EpochReclaimer* reclaimer)
+	: m_reclaimer(reclaimer)
+{
+	Slot& slot = m_reclaimer->GetCurrentSlot();
+	if (slot.depth++ == 0)
+	{
+		// Эпоха читается с acquire: поток, увидевший эпоху после замены, увидит и новый указатель.
+		// Объявление эпохи упорядочено до чтения опубликованного указателя: писатель, не увидевший
+		// его при сборе, опубликовал замену раньше, и поток прочитает уже её
+		slot.epoch.store(m_reclaimer->m_epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+	}
+}
+
+EpochReclaimer::Guard::Guard(Guard&& other) noexcept
+	: m_reclaimer(std::exchange(other.m_reclaimer, nullptr))
+{
+}
+
+EpochReclaimer::Guard::~Guard()
+{
+	if (!m_reclaimer)
+	{
+		return;
+	}
+	Slot& slot = m_reclaimer->GetCurrentSlot();
+	if (--slot.depth == 0)
+	{
+		slot.epoch.store(0, std::memory_order_release);
+	}
+}
+
+EpochReclaimer::EpochReclaimer()
+	: m_slots(std::make_unique<Slot[]>(MaxThreadCount))
+{
+}
+
+EpochReclaimer::~EpochReclaimer()
+{
+	for (std::size_t i = 0; i < GetSlotCount(); ++i)
+	{
+		for (const auto& retired : m_slots[i].retired)
+		{
+			retired.deleter(retired.object);
+		}
+	}
+}
+
+EpochReclaimer::Guard EpochReclaimer::Pin()
+{
+	return Guard(this);
+}
+
+void EpochReclaimer::Retire(const void* object, Deleter deleter)
+{
+	Slot& slot = GetCurrentSlot();
+	bool isFull = false;
+	{
+		std::lock_guard lock(slot.retiredMutex);
+		// Эпоха сдвигается только сбором: потоки, закрепившие эпоху после него, прочитают уже замену
+		slot.retired.push_back({ m_epoch.load(std::memory_order_seq_cst), object, deleter });
+		isFull = slot.retired.size() >= slot.collectAt;
+	}
+	if (!isFull)
+	{
+		return;
+	}
+
+	Collect();
+	// Объекты, которые ещё читают, не должны запускать сбор при каждом следующем Retire
+	std::lock_guard lock(slot.retiredMutex);
+	slot.collectAt = slot.retired.size() + CollectThreshold;
+}
+
+void EpochReclaimer::Collect()
+{
+	// Объект, отложенный после сдвига эпохи, мог быть заменён уже после обхода слотов,
+	// поэтому собираются только объекты прежних эпох
+	std::uint64_t oldest = m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+	const std::size_t slotCount = GetSlotCount();
+	for (std::size_t i = 0; i < slotCount; ++i)
+	{
+		if (const std::uint64_t epoch = m_slots[i].epoch.load(std::memory_order_seq_cst); epoch != 0)
+		{
+			oldest = std::min(oldest, epoch);
+		}
+	}
+
+	// Объект, заменённый в эпоху e, могут читать только потоки, закрепившие эпоху не новее e
+	std::vector<RetiredObject> ready;
+	for (std::size_t i = 0; i < slotCount; ++i)
+	{
+		Slot& slot = m_slots[i];
+		std::lock_guard lock(slot.retiredMutex);
+		const auto kept = std::partition(slot.retired.begin(), slot.retired.end(), [oldest](const RetiredObject& retired) {
+			return retired.epoch >= oldest;
+		});
+		ready.insert(ready.end(), kept, slot.retired.end());
+		slot.retired.erase(kept, slot.retired.end());
+	}
+	// Удаление может быть долгим, поэтому идёт без блокировки
+	for (const auto& retired : ready)
+	{
+		retired.deleter(retired.object);
+	}
+}
+
+EpochReclaimer::Slot& EpochReclaimer::GetCurrentSlot()
+{
+	const std::size_t index = GetCurrentThreadIndex();
+	if (index >= MaxThreadCount)
+	{
+		throw std::runtime_error("Too many threads read the index concurrently");
+	}
+	return m_slots[index];
+}
+
+std::size_t EpochReclaimer::GetSlotCount()
+{
+	return std::min(ThreadIndexRegistry::Get().GetLimit(), MaxThreadCount);
+}
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Освобождение памяти по эпохам для структур, которые публикуются атомарной заменой указателя.
+// Читатель закрепляет текущую эпоху в слоте своего потока: слоты разных потоков лежат в разных
+// строках кэша, так что читатели не пишут в общую память. Писатель, заменивший объект, передаёт
+// старый в Retire, и тот удаляется, когда все потоки, закрепившие эпоху не новее замены, открепятся.
+// Отложенные объекты копятся в слоте потока, а сбор идёт пакетами
+class EpochReclaimer
+{
+public:
+	static constexpr std::size_t MaxThreadCount = 1024;
+	// Столько объектов поток откладывает между сборами, которые запускает сам
+	static constexpr std::size_t CollectThreshold = 64;
+
+	// Закрепление эпохи текущим потоком. Закрепления одного потока могут быть вложенными.
+	// Guard должен разрушаться в том же потоке, где создан
+	class Guard
+	{
+	public:
+		Guard(Guard&& other) noexcept;
+		Guard& operator=(Guard&& other) = delete;
+		~Guard();
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+
+	private:
+		friend class EpochReclaimer;
+
+		explicit Guard(EpochReclaimer* reclaimer);
+
+		EpochReclaimer* m_reclaimer;
+	};
+
+	// Указатель на объект, защищённый закреплением эпохи
+	template <typename T>
+	class Pinned
+	{
+	public:
+		Pinned(Guard guard, T* object)
+			: m_guard(std::move(guard))
+			, m_object(object)
+		{
+		}
+
+		T* operator->() const
+		{
+			return m_object;
+		}
+
+		T& operator*() const
+		{
+			return *m_object;
+		}
+
+	private:
+		Guard m_guard;
+		T* m_object;
+	};
+
+	EpochReclaimer();
+	// Удаляет все отложенные объекты: к этому моменту читателей быть не должно
+	~EpochReclaimer();
+
+	EpochReclaimer(const EpochReclaimer&) = delete;
+	EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+	Guard Pin();
+
+	// object уже недоступен новым читателям
+	template <typename T>
+	void Retire(const T* object)
+	{
+		Retire(object, [](const void* retired) {
+			delete static_cast<const T*>(retired);
+		});
+	}
+
+	// Удаляет объекты всех потоков, которые уже не может читать ни один поток. Retire вызывает его
+	// сам раз в CollectThreshold объектов, поэтому писатель, которому важно освободить заменённое
+	// сразу, собирает явно. Объект, заменённый под собственным закреплением, освободится
+	// лишь при следующем сборе
+	void Collect();
+
+private:
+	using Deleter = void (*)(const void* object);
+
+	struct RetiredObject
+	{
+		std::uint64_t epoch;
+		const void* object;
+		Deleter deleter;
+	};
+
+	struct alignas(64) Slot
+	{
+		// 0 — поток ничего не читает
+		std::atomic<std::uint64_t> epoch = 0;
+		// Меняется только потоком-владельцем слота
+		std::size_t depth = 0;
+
+		// Владелец слота кладёт объекты, сбор забирает освобождаемые; мьютекс почти всегда свободен
+		std::mutex retiredMutex;
+		std::vector<RetiredObject> retired;
+		// Размер retired, при котором владелец запустит сбор
+		std::size_t collectAt = CollectThreshold;
+	};
+
+	void Retire(const void* object, Deleter deleter);
+	Slot& GetCurrentSlot();
+	static std::size_t GetSlotCount();
+
+	std::atomic<std::uint64_t> m_epoch = 1;
+	std::unique_ptr<Slot[]> m_slots;
+};
\ No newline at end of file
@@ -0,0 +1,218 @@
+#include "FileLoader.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+std::int64_t GetModificationTime(const struct stat& info)
+{
+	return static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec;
+}
+
+// Некриптографический хеш: по 8 байт за шаг с перемешиванием умножением
+std::uint64_t HashContent(const char* data, std::size_t size)
+{
+	constexpr std::uint64_t Multiplier = 0x9E3779B97F4A7C15;
+	std::uint64_t hash = size * Multiplier;
+	std::size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * Multiplier;
+		hash ^= hash >> 29;
+	}
+	std::uint64_t tail = 0;
+	std::memcpy(&tail, data + i, size - i);
+	hash = (hash ^ tail) * Multiplier;
+	return hash ^ (hash >> 32);
+}
+} // namespace
+
+FileLoader::Content::Content(Content&& other) noexcept
+	: m_loader(std::exchange(other.m_loader, nullptr))
+	, m_buffer(std::move(other.m_buffer))
+	, m_data(std::exchange(other.m_data, nullptr))
+	, m_size(std::exchange(other.m_size, 0))
+	, m_mapped(std::exchange(other.m_mapped, false))
+	, m_version(other.m_version)
+{
+}
+
+FileLoader::Content& FileLoader::Content::operator=(Content&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+		m_loader = std::exchange(other.m_loader, nullptr);
+		m_buffer = std::move(other.m_buffer);
+		m_data = std::exchange(other.m_data, nullptr);
+		m_size = std::exchange(other.m_size, 0);
+		m_mapped = std::exchange(other.m_mapped, false);
+		m_version = other.m_version;
+	}
+	return *this;
+}
+
+FileLoader::Content::~Content()
+{
+	Release();
+}
+
+std::span<char> FileLoader::Content::GetData() const
+{
+	return { m_data, m_size };
+}
+
+const FileVersion& FileLoader::Content::GetVersion() const
+{
+	return m_version;
+}
+
+void FileLoader::Content::Release() noexcept
+{
+	if (m_mapped)
+	{
+		munmap(m_data, m_size);
+	}
+	else if (m_loader)
+	{
+		m_loader->ReleaseBuffer(std::move(m_buffer));
+	}
+	m_loader = nullptr;
+	m_data = nullptr;
+	m_size = 0;
+	m_mapped = false;
+}
+
+std::optional<FileLoader::Content> FileLoader::Load(const std::filesystem::path& path)
+{
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return std::nullopt;
+	}
+
+	struct stat info
+	{
+	};
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		close(fd);
+		return std::nullopt;
+	}
+	const auto size = static_cast<std::size_t>(info.st_size);
+
+	Content content;
+	content.m_version.modificationTime = GetModificationTime(info);
+	if (size >= MmapThreshold)
+	{
+		// Страницы копируются только там, где токенизатор действительно меняет регистр
+		void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+		{
+			return std::nullopt;
+		}
+		madvise(data, size, MADV_SEQUENTIAL);
+		madvise(data, size, MADV_WILLNEED);
+		content.m_data = static_cast<char*>(data);
+		content.m_size = size;
+		content.m_mapped = true;
+		content.m_version.size = size;
+		content.m_version.contentHash = HashContent(content.m_data, size);
+		return content;
+	}
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	content.m_loader = this;
+	content.m_buffer = AcquireBuffer();
+	// Буфер из пула только растёт, чтобы не заполнять его нулями при каждом файле
+	if (content.m_buffer.size() < size)
+	{
+		content.m_buffer.resize(size);
+	}
+
+	// Файл мог измениться после fstat: читается не больше size байт
+	std::size_t bytesRead = 0;
+	while (bytesRead < size)
+	{
+		const ssize_t result = pread(fd, content.m_buffer.data() + bytesRead, size - bytesRead, static_cast<off_t>(bytesRead));
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result < 0)
+		{
+			close(fd);
+			return std::nullopt;
+		}
+		if (result == 0)
+		{
+			break;
+		}
+		bytesRead += static_cast<std::size_t>(result);
+	}
+	close(fd);
+
+	content.m_data = content.m_buffer.data();
+	content.m_size = bytesRead;
+	content.m_version.size = bytesRead;
+	content.m_version.contentHash = HashContent(content.m_data, bytesRead);
+	return content;
+}
+
+FileLoader::LoadResult FileLoader::LoadIfChanged(const std::filesystem::path& path, const std::optional<FileVersion>& known)
+{
+	LoadResult result;
+	if (known)
+	{
+		struct stat info
+		{
+		};
+		if (::stat(path.c_str(), &info) == 0 && GetModificationTime(info) == known->modificationTime
+			&& static_cast<std::uint64_t>(info.st_size) == known->size)
+		{
+			result.unchanged = true;
+			return result;
+		}
+	}
+
+	// Время изменения могло обновиться без изменения содержимого, например при checkout.
+	// Такой файл не переиндексируется, но и записанная версия остаётся прежней
+	result.content = Load(path);
+	if (result.content && known && result.content->GetVersion().size == known->size
+		&& result.content->GetVersion().contentHash == known->contentHash)
+	{
+		result.content.reset();
+		result.unchanged = true;
+	}
+	return result;
+}
+
+std::vector<char> FileLoader::AcquireBuffer()
+{
+	std::lock_guard lock(m_poolMutex);
+	if (m_freeBuffers.empty())
+	{
+		return {};
+	}
+	auto buffer = std::move(m_freeBuffers.back());
+	m_freeBuffers.pop_back();
+	return buffer;
+}
+
+void FileLoader::ReleaseBuffer(std::vector<char> buffer)
+{
+	std::lock_guard lock(m_poolMutex);
+	if (m_freeBuffers.size() < MaxPooledBuffers)
+	{
+		m_freeBuffers.push_back(std::move(buffer));
+	}
+}
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Document.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+// Читает файлы для индексации без промежуточных копий. Небольшие файлы читаются через pread
+// в буферы из пула, крупные отображаются в память через mmap. Содержимое отдаётся изменяемым,
+// чтобы токенизатор переводил его в нижний регистр на месте: отображение частное,
+// и изменения в файл не попадают
+class FileLoader
+{
+public:
+	static constexpr std::size_t MmapThreshold = 256 * 1024;
+
+	// Содержимое файла. Буфер из пула возвращается в пул при уничтожении
+	class Content
+	{
+	public:
+		Content(Content&& other) noexcept;
+		Content& operator=(Content&& other) noexcept;
+		~Content();
+
+		Content(const Content&) = delete;
+		Content& operator=(const Content&) = delete;
+
+		std::span<char> GetData() const;
+		// Хеш содержимого посчитан до того, как буфер мог быть изменён
+		const FileVersion& GetVersion() const;
+
+	private:
+		friend class FileLoader;
+
+		Content() = default;
+		void Release() noexcept;
+
+		FileLoader* m_loader = nullptr;
+		std::vector<char> m_buffer;
+		char* m_data = nullptr;
+		std::size_t m_size = 0;
+		bool m_mapped = false;
+		FileVersion m_version;
+	};
+
+	// Файл не прочитан, если unchanged или при ошибке чтения
+	struct LoadResult
+	{
+		std::optional<Content> content;
+		bool unchanged = false;
+	};
+
+	FileLoader() = default;
+	FileLoader(const FileLoader&) = delete;
+	FileLoader& operator=(const FileLoader&) = delete;
+
+	std::optional<Content> Load(const std::filesystem::path& path);
+	// Файл с теми же временем изменения и размером, что в known, не читается вовсе.
+	// Иначе он читается, и совпадение размера и хеша тоже означает, что файл не изменился
+	LoadResult LoadIfChanged(const std::filesystem::path& path, const std::optional<FileVersion>& known);
+
+private:
+	static constexpr std::size_t MaxPooledBuffers = 64;
+
+	std::vector<char> AcquireBuffer();
+	void ReleaseBuffer(std::vector<char> buffer);
+
+	std::mutex m_poolMutex;
+	std::vector<std::vector<char>> m_freeBuffers;
+};
\ No newline at end of file
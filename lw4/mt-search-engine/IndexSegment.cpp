@@ -0,0 +1,542 @@
+#include "IndexSegment.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <ranges>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr std::size_t TableAlignment = 8;
+
+// Последовательная запись сегмента в файл или в буфер с учётом текущего смещения
+class SegmentSink
+{
+public:
+	explicit SegmentSink(std::ofstream& file)
+		: m_file(&file)
+	{
+	}
+
+	explicit SegmentSink(std::vector<std::uint8_t>& buffer)
+		: m_buffer(&buffer)
+	{
+	}
+
+	std::uint64_t GetOffset() const
+	{
+		return m_offset;
+	}
+
+	void Write(const void* data, std::size_t size)
+	{
+		if (m_file)
+		{
+			m_file->write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		}
+		else
+		{
+			const auto* bytes = static_cast<const std::uint8_t*>(data);
+			m_buffer->insert(m_buffer->end(), bytes, bytes + size);
+		}
+		m_offset += size;
+	}
+
+	void Align()
+	{
+		static constexpr char zeros[TableAlignment] = {};
+		Write(zeros, (TableAlignment - m_offset % TableAlignment) % TableAlignment);
+	}
+
+	template <typename T>
+	void WriteTable(const std::vector<T>& items)
+	{
+		Write(items.data(), items.size() * sizeof(T));
+	}
+
+	void WriteAt(std::uint64_t offset, const void* data, std::size_t size)
+	{
+		if (m_file)
+		{
+			m_file->seekp(static_cast<std::streamoff>(offset));
+			m_file->write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+		}
+		else
+		{
+			std::memcpy(m_buffer->data() + offset, data, size);
+		}
+	}
+
+private:
+	std::ofstream* m_file = nullptr;
+	std::vector<std::uint8_t>* m_buffer = nullptr;
+	std::uint64_t m_offset = 0;
+};
+
+void FillTermStats(const PostingListView& docs, std::uint32_t& maxFrequency, std::uint32_t& minDocumentLength, double& maxNormalizedTf)
+{
+	std::vector<std::uint64_t> docIds(PostingListView::BlockSize);
+	std::vector<PostingListView::Payload> payloads(PostingListView::BlockSize);
+	for (std::size_t block = 0; block < docs.GetBlockCount(); ++block)
+	{
+		const std::size_t count = docs.DecodeBlock(block, docIds.data(), payloads.data());
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const auto& payload = payloads[i];
+			maxFrequency = std::max(maxFrequency, payload.frequency);
+			minDocumentLength = std::min(minDocumentLength, payload.documentLength);
+			maxNormalizedTf = std::max(maxNormalizedTf,
+				static_cast<double>(payload.frequency) / static_cast<double>(payload.documentLength));
+		}
+	}
+}
+} // namespace
+
+IndexSegment::IndexSegment(const std::uint8_t* data, std::size_t size)
+	: m_data(data)
+	, m_size(size)
+	, m_mapped(true)
+	, m_header(reinterpret_cast<const Header*>(data))
+	, m_documents(nullptr)
+	, m_pathOrder(nullptr)
+	, m_terms(nullptr)
+	, m_ngrams(nullptr)
+	, m_wordOffsets(nullptr)
+{
+}
+
+IndexSegment::IndexSegment(std::vector<std::uint8_t> bytes)
+	: m_ownedBytes(std::move(bytes))
+	, m_data(m_ownedBytes.data())
+	, m_size(m_ownedBytes.size())
+	, m_mapped(false)
+	, m_header(reinterpret_cast<const Header*>(m_data))
+	, m_documents(nullptr)
+	, m_pathOrder(nullptr)
+	, m_terms(nullptr)
+	, m_ngrams(nullptr)
+	, m_wordOffsets(nullptr)
+{
+}
+
+IndexSegment::~IndexSegment()
+{
+	if (m_mapped)
+	{
+		munmap(const_cast<std::uint8_t*>(m_data), m_size);
+	}
+}
+
+std::shared_ptr<const IndexSegment> IndexSegment::Open(const std::string& path)
+{
+	const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		throw std::runtime_error("Cannot open index file: " + path);
+	}
+	struct stat info = {};
+	if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(Header))
+	{
+		close(fd);
+		throw std::runtime_error("Not an index file: " + path);
+	}
+	const auto size = static_cast<std::size_t>(info.st_size);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	// Отображение переживает дескриптор
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		throw std::runtime_error("Cannot map index file: " + path);
+	}
+
+	std::shared_ptr<IndexSegment> segment(new IndexSegment(static_cast<const std::uint8_t*>(data), size));
+	if (std::memcmp(segment->m_header->magic, Magic, sizeof(Magic)) != 0)
+	{
+		throw std::runtime_error("Not an index file: " + path);
+	}
+	if (segment->m_header->version != Version)
+	{
+		throw std::runtime_error("Unsupported index file version: " + path);
+	}
+	segment->InitTables();
+	segment->Validate();
+	return segment;
+}
+
+std::shared_ptr<const IndexSegment> IndexSegment::Build(int ngramSize,
+	const std::vector<Document>& docs,
+	const std::map<std::string, PostingList>& terms,
+	const std::map<std::string, PositionList>& positions,
+	const std::map<std::string, PostingList>& ngrams)
+{
+	std::vector<std::uint8_t> bytes;
+	SegmentSink sink(bytes);
+	WriteTo(sink, ngramSize, docs, terms, positions, ngrams);
+
+	std::shared_ptr<IndexSegment> segment(new IndexSegment(std::move(bytes)));
+	segment->InitTables();
+	return segment;
+}
+
+void IndexSegment::Write(const std::string& path, int ngramSize,
+	const std::vector<Document>& docs,
+	const std::map<std::string, PostingList>& terms,
+	const std::map<std::string, PositionList>& positions,
+	const std::map<std::string, PostingList>& ngrams)
+{
+	// Файл пишется рядом и подменяет старый только целиком: открытые отображения старого
+	// файла остаются действительными, а оборванная запись не портит индекс
+	const std::string tmpPath = path + ".tmp";
+	std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		throw std::runtime_error("Cannot create index file: " + tmpPath);
+	}
+	SegmentSink sink(file);
+	WriteTo(sink, ngramSize, docs, terms, positions, ngrams);
+	file.close();
+	if (!file)
+	{
+		throw std::runtime_error("Cannot write index file: " + tmpPath);
+	}
+	std::filesystem::rename(tmpPath, path);
+}
+
+template <typename Sink>
+void IndexSegment::WriteTo(Sink& writer, int ngramSize,
+	const std::vector<Document>& docs,
+	const std::map<std::string, PostingList>& terms,
+	const std::map<std::string, PositionList>& positions,
+	const std::map<std::string, PostingList>& ngrams)
+{
+	Header header = {};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.ngramSize = static_cast<std::uint32_t>(ngramSize);
+	writer.Write(&header, sizeof(header));
+
+	std::vector<std::uint8_t> buffer;
+	const auto writePostings = [&](const std::map<std::string, PostingList>& lists, std::vector<KeyRecord>& records) {
+		for (const auto& list : lists | std::views::values)
+		{
+			// Список читается на месте, поэтому его таблица пропусков выровнена
+			buffer.clear();
+			list.AppendTo(buffer);
+			writer.Align();
+			KeyRecord record = {};
+			record.postingOffset = writer.GetOffset() - header.postings.offset;
+			record.postingSize = buffer.size();
+			records.push_back(record);
+			writer.Write(buffer.data(), buffer.size());
+		}
+	};
+	std::vector<KeyRecord> termRecords;
+	std::vector<KeyRecord> ngramRecords;
+	writer.Align();
+	header.postings.offset = writer.GetOffset();
+	writePostings(terms, termRecords);
+	writePostings(ngrams, ngramRecords);
+	header.postings.size = writer.GetOffset() - header.postings.offset;
+
+	// Позиции — отдельный раздел за постингами: обычный поиск его страниц не касается
+	header.positions.offset = writer.GetOffset();
+	auto positionRecord = termRecords.begin();
+	for (const auto& term : terms | std::views::keys)
+	{
+		if (const auto it = positions.find(term); it != positions.end())
+		{
+			buffer.clear();
+			it->second.AppendTo(buffer);
+			positionRecord->positionOffset = writer.GetOffset() - header.positions.offset;
+			positionRecord->positionSize = buffer.size();
+			writer.Write(buffer.data(), buffer.size());
+		}
+		++positionRecord;
+	}
+	header.positions.size = writer.GetOffset() - header.positions.offset;
+
+	header.strings.offset = writer.GetOffset();
+	const auto writeString = [&](std::string_view str) {
+		const std::uint64_t offset = writer.GetOffset() - header.strings.offset;
+		writer.Write(str.data(), str.size());
+		return offset;
+	};
+	std::vector<DocumentRecord> docRecords;
+	docRecords.reserve(docs.size());
+	std::vector<std::uint64_t> wordOffsets;
+	std::uint64_t totalWords = 0;
+	for (const auto& doc : docs)
+	{
+		const auto wordCount = static_cast<std::uint32_t>(doc.wordCount);
+		docRecords.push_back({ doc.id, writeString(doc.path), static_cast<std::uint32_t>(doc.path.size()),
+			wordCount, doc.version.modificationTime, doc.version.size, doc.version.contentHash, wordOffsets.size() });
+		// Таблица документа всегда полной длины, даже если смещения не были собраны
+		auto offsets = doc.wordOffsets;
+		offsets.resize(GetWordOffsetCount(wordCount));
+		wordOffsets.insert(wordOffsets.end(), offsets.begin(), offsets.end());
+		totalWords += doc.wordCount;
+	}
+	auto termRecord = termRecords.begin();
+	for (const auto& [term, list] : terms)
+	{
+		termRecord->keyOffset = writeString(term);
+		termRecord->keyLength = static_cast<std::uint32_t>(term.size());
+		termRecord->minDocumentLength = std::numeric_limits<std::uint32_t>::max();
+		FillTermStats(list.GetView(), termRecord->maxFrequency, termRecord->minDocumentLength, termRecord->maxNormalizedTf);
+		++termRecord;
+	}
+	auto ngramRecord = ngramRecords.begin();
+	for (const auto& gram : ngrams | std::views::keys)
+	{
+		ngramRecord->keyOffset = writeString(gram);
+		ngramRecord->keyLength = static_cast<std::uint32_t>(gram.size());
+		++ngramRecord;
+	}
+	header.strings.size = writer.GetOffset() - header.strings.offset;
+	header.totalWords = totalWords;
+
+	std::vector<std::uint32_t> pathOrder(docs.size());
+	std::iota(pathOrder.begin(), pathOrder.end(), 0);
+	std::sort(pathOrder.begin(), pathOrder.end(), [&docs](std::uint32_t a, std::uint32_t b) {
+		return docs[a].path < docs[b].path;
+	});
+
+	const auto writeTable = [&writer](const auto& table, Section& section) {
+		writer.Align();
+		section.offset = writer.GetOffset();
+		writer.WriteTable(table);
+		section.size = writer.GetOffset() - section.offset;
+	};
+	writeTable(docRecords, header.documents);
+	writeTable(pathOrder, header.pathOrder);
+	writeTable(termRecords, header.terms);
+	writeTable(ngramRecords, header.ngrams);
+	writeTable(wordOffsets, header.wordOffsets);
+
+	writer.WriteAt(0, &header, sizeof(header));
+}
+
+void IndexSegment::InitTables()
+{
+	const Header& header = *m_header;
+	m_documents = GetTable<DocumentRecord>(header.documents);
+	m_pathOrder = GetTable<std::uint32_t>(header.pathOrder);
+	m_terms = GetTable<KeyRecord>(header.terms);
+	m_ngrams = GetTable<KeyRecord>(header.ngrams);
+	m_wordOffsets = GetTable<std::uint64_t>(header.wordOffsets);
+	GetTable<std::uint8_t>(header.strings);
+	GetTable<std::uint8_t>(header.postings);
+	GetTable<std::uint8_t>(header.positions);
+	if (header.pathOrder.size / sizeof(std::uint32_t) != GetDocumentCount())
+	{
+		throw std::runtime_error("Corrupted index file");
+	}
+}
+
+void IndexSegment::Validate() const
+{
+	const std::size_t docCount = GetDocumentCount();
+	if (std::any_of(m_pathOrder, m_pathOrder + docCount, [docCount](std::uint32_t index) { return index >= docCount; }))
+	{
+		throw std::runtime_error("Corrupted index file");
+	}
+
+	const auto validatePostings = [this](const KeyRecord* records, std::size_t count, bool withPayload) {
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			const auto& record = records[i];
+			if (!PostingListView::ReadFrom(GetPostingBytes(record), record.postingSize, withPayload).IsValid())
+			{
+				throw std::runtime_error("Corrupted index file");
+			}
+		}
+	};
+	validatePostings(m_terms, GetTermCount(), true);
+	validatePostings(m_ngrams, GetNgramCount(), false);
+}
+
+int IndexSegment::GetNgramSize() const
+{
+	return static_cast<int>(m_header->ngramSize);
+}
+
+std::uint64_t IndexSegment::GetTotalWords() const
+{
+	return m_header->totalWords;
+}
+
+std::size_t IndexSegment::GetDocumentCount() const
+{
+	return m_header->documents.size / sizeof(DocumentRecord);
+}
+
+std::uint64_t IndexSegment::GetDocumentId(std::size_t index) const
+{
+	return m_documents[index].id;
+}
+
+Document IndexSegment::GetDocument(std::size_t index) const
+{
+	const auto& record = m_documents[index];
+	Document doc;
+	doc.id = record.id;
+	doc.path = GetString(record.pathOffset, record.pathLength);
+	doc.wordCount = record.wordCount;
+	doc.version = { record.modificationTime, record.fileSize, record.contentHash };
+	return doc;
+}
+
+std::optional<std::size_t> IndexSegment::FindDocument(std::uint64_t docId) const
+{
+	const auto* end = m_documents + GetDocumentCount();
+	const auto* it = std::lower_bound(m_documents, end, docId,
+		[](const DocumentRecord& record, std::uint64_t id) { return record.id < id; });
+	if (it == end || it->id != docId)
+	{
+		return std::nullopt;
+	}
+	return static_cast<std::size_t>(it - m_documents);
+}
+
+std::optional<std::size_t> IndexSegment::FindDocumentByPath(std::string_view path) const
+{
+	const auto* end = m_pathOrder + GetDocumentCount();
+	const auto getPath = [this](std::uint32_t index) {
+		const auto& record = m_documents[index];
+		return GetString(record.pathOffset, record.pathLength);
+	};
+	const auto* it = std::lower_bound(m_pathOrder, end, path,
+		[&getPath](std::uint32_t index, std::string_view value) { return getPath(index) < value; });
+	if (it == end || getPath(*it) != path)
+	{
+		return std::nullopt;
+	}
+	return *it;
+}
+
+std::span<const std::uint64_t> IndexSegment::GetWordOffsets(std::size_t index) const
+{
+	const auto& record = m_documents[index];
+	const std::size_t tableSize = m_header->wordOffsets.size / sizeof(std::uint64_t);
+	const std::size_t count = GetWordOffsetCount(record.wordCount);
+	if (record.wordOffsetIndex > tableSize || count > tableSize - record.wordOffsetIndex)
+	{
+		throw std::runtime_error("Corrupted index file");
+	}
+	return { m_wordOffsets + record.wordOffsetIndex, count };
+}
+
+std::size_t IndexSegment::GetTermCount() const
+{
+	return m_header->terms.size / sizeof(KeyRecord);
+}
+
+std::string_view IndexSegment::GetTerm(std::size_t index) const
+{
+	return GetString(m_terms[index].keyOffset, m_terms[index].keyLength);
+}
+
+TermPostingsView IndexSegment::GetTermPostings(std::size_t index) const
+{
+	const auto& record = m_terms[index];
+	TermPostingsView postings;
+	postings.docs = PostingListView::ReadFrom(GetPostingBytes(record), record.postingSize, true);
+	postings.maxNormalizedTf = record.maxNormalizedTf;
+	postings.maxFrequency = record.maxFrequency;
+	postings.minDocumentLength = record.minDocumentLength;
+	return postings;
+}
+
+std::span<const std::uint8_t> IndexSegment::GetTermPositions(std::size_t index) const
+{
+	const auto& record = m_terms[index];
+	const auto& positions = m_header->positions;
+	if (record.positionOffset > positions.size || record.positionSize > positions.size - record.positionOffset)
+	{
+		throw std::runtime_error("Corrupted index file");
+	}
+	return { m_data + positions.offset + record.positionOffset, record.positionSize };
+}
+
+std::optional<std::size_t> IndexSegment::FindTerm(std::string_view term) const
+{
+	return FindKey(m_terms, GetTermCount(), term);
+}
+
+std::size_t IndexSegment::GetNgramCount() const
+{
+	return m_header->ngrams.size / sizeof(KeyRecord);
+}
+
+std::string_view IndexSegment::GetNgram(std::size_t index) const
+{
+	return GetString(m_ngrams[index].keyOffset, m_ngrams[index].keyLength);
+}
+
+PostingListView IndexSegment::GetNgramPostings(std::size_t index) const
+{
+	const auto& record = m_ngrams[index];
+	return PostingListView::ReadFrom(GetPostingBytes(record), record.postingSize, false);
+}
+
+std::optional<std::size_t> IndexSegment::FindNgram(std::string_view ngram) const
+{
+	return FindKey(m_ngrams, GetNgramCount(), ngram);
+}
+
+template <typename T>
+const T* IndexSegment::GetTable(const Section& section) const
+{
+	if (section.offset > m_size || section.size > m_size - section.offset
+		|| section.offset % alignof(T) != 0 || section.size % sizeof(T) != 0)
+	{
+		throw std::runtime_error("Corrupted index file");
+	}
+	return reinterpret_cast<const T*>(m_data + section.offset);
+}
+
+std::string_view IndexSegment::GetString(std::uint64_t offset, std::uint32_t length) const
+{
+	const auto& strings = m_header->strings;
+	if (offset > strings.size || length > strings.size - offset)
+	{
+		throw std::runtime_error("Corrupted index file");
+	}
+	return { reinterpret_cast<const char*>(m_data + strings.offset + offset), length };
+}
+
+const std::uint8_t* IndexSegment::GetPostingBytes(const KeyRecord& record) const
+{
+	const auto& postings = m_header->postings;
+	if (record.postingOffset > postings.size || record.postingSize > postings.size - record.postingOffset)
+	{
+		throw std::runtime_error("Corrupted index file");
+	}
+	return m_data + postings.offset + record.postingOffset;
+}
+
+std::size_t IndexSegment::GetWordOffsetCount(std::uint32_t wordCount)
+{
+	return (wordCount + Document::WordOffsetInterval - 1) / Document::WordOffsetInterval;
+}
+
+std::optional<std::size_t> IndexSegment::FindKey(const KeyRecord* records, std::size_t count, std::string_view key) const
+{
+	const auto* end = records + count;
+	const auto* it = std::lower_bound(records, end, key, [this](const KeyRecord& record, std::string_view value) {
+		return GetString(record.keyOffset, record.keyLength) < value;
+	});
+	if (it == end || GetString(it->keyOffset, it->keyLength) != key)
+	{
+		return std::nullopt;
+	}
+	return static_cast<std::size_t>(it - records);
+}
\ No newline at end of file
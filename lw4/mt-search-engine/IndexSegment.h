@@ -0,0 +1,155 @@
+#pragma once
+
+#include "Document.h"
+#include "PositionList.h"
+#include "PostingList.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемый сегмент индекса: таблица документов, словари термов и n-грамм с их постингами,
+// позиции термов и смещения опорных слов документов.
+// Файл сегмента отображается в память через mmap и читается на месте, так что открытие
+// не зависит от размера индекса, а страницы делятся между процессами через страничный кеш.
+// При открытии постинги файла один раз проверяются целиком.
+// Тот же формат, собранный в буфере, служит сегментом в памяти.
+// Таблицы фиксированного размера выровнены и упорядочены: документы — по id,
+// термы и n-граммы — по строке, для путей есть отдельный порядок по строке пути.
+// Позиции лежат отдельным разделом, и его страницы читаются, только когда они нужны запросу
+class IndexSegment
+{
+public:
+	~IndexSegment();
+
+	IndexSegment(const IndexSegment&) = delete;
+	IndexSegment& operator=(const IndexSegment&) = delete;
+
+	static std::shared_ptr<const IndexSegment> Open(const std::string& path);
+	// Документы должны быть упорядочены по id, termFrequencies и positions в них не сохраняются.
+	// Позиции термов передаются отдельно, с теми же ключами, что у terms
+	static std::shared_ptr<const IndexSegment> Build(int ngramSize,
+		const std::vector<Document>& docs,
+		const std::map<std::string, PostingList>& terms,
+		const std::map<std::string, PositionList>& positions,
+		const std::map<std::string, PostingList>& ngrams);
+	static void Write(const std::string& path, int ngramSize,
+		const std::vector<Document>& docs,
+		const std::map<std::string, PostingList>& terms,
+		const std::map<std::string, PositionList>& positions,
+		const std::map<std::string, PostingList>& ngrams);
+
+	int GetNgramSize() const;
+	std::uint64_t GetTotalWords() const;
+
+	std::size_t GetDocumentCount() const;
+	std::uint64_t GetDocumentId(std::size_t index) const;
+	Document GetDocument(std::size_t index) const;
+	std::optional<std::size_t> FindDocument(std::uint64_t docId) const;
+	std::optional<std::size_t> FindDocumentByPath(std::string_view path) const;
+	std::span<const std::uint64_t> GetWordOffsets(std::size_t index) const;
+
+	std::size_t GetTermCount() const;
+	std::string_view GetTerm(std::size_t index) const;
+	// Постинги читаются на месте и действительны, пока жив сегмент
+	TermPostingsView GetTermPostings(std::size_t index) const;
+	// Сериализованный PositionList терма, читается курсором на месте
+	std::span<const std::uint8_t> GetTermPositions(std::size_t index) const;
+	std::optional<std::size_t> FindTerm(std::string_view term) const;
+
+	std::size_t GetNgramCount() const;
+	std::string_view GetNgram(std::size_t index) const;
+	PostingListView GetNgramPostings(std::size_t index) const;
+	std::optional<std::size_t> FindNgram(std::string_view ngram) const;
+
+private:
+	struct Section
+	{
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	struct Header
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t ngramSize;
+		std::uint64_t totalWords;
+		Section documents;
+		Section pathOrder;
+		Section terms;
+		Section ngrams;
+		Section strings;
+		Section postings;
+		Section positions;
+		Section wordOffsets;
+	};
+
+	struct DocumentRecord
+	{
+		std::uint64_t id;
+		std::uint64_t pathOffset;
+		std::uint32_t pathLength;
+		std::uint32_t wordCount;
+		std::int64_t modificationTime;
+		std::uint64_t fileSize;
+		std::uint64_t contentHash;
+		// Первый элемент таблицы смещений опорных слов; их число определяется wordCount
+		std::uint64_t wordOffsetIndex;
+	};
+
+	// Для n-грамм поля статистики и позиций не заполняются
+	struct KeyRecord
+	{
+		std::uint64_t keyOffset;
+		std::uint32_t keyLength;
+		std::uint32_t maxFrequency;
+		std::uint32_t minDocumentLength;
+		std::uint32_t reserved;
+		double maxNormalizedTf;
+		std::uint64_t postingOffset;
+		std::uint64_t postingSize;
+		std::uint64_t positionOffset;
+		std::uint64_t positionSize;
+	};
+
+	static constexpr char Magic[8] = { 'M', 'T', 'S', 'E', 'G', 'M', 'N', 'T' };
+	static constexpr std::uint32_t Version = 3;
+
+	IndexSegment(const std::uint8_t* data, std::size_t size);
+	explicit IndexSegment(std::vector<std::uint8_t> bytes);
+
+	template <typename Sink>
+	static void WriteTo(Sink& writer, int ngramSize,
+		const std::vector<Document>& docs,
+		const std::map<std::string, PostingList>& terms,
+		const std::map<std::string, PositionList>& positions,
+		const std::map<std::string, PostingList>& ngrams);
+	void InitTables();
+	// Проверяет то, что запросы читают без проверок границ: порядок путей и постинги
+	void Validate() const;
+
+	template <typename T>
+	const T* GetTable(const Section& section) const;
+	std::string_view GetString(std::uint64_t offset, std::uint32_t length) const;
+	const std::uint8_t* GetPostingBytes(const KeyRecord& record) const;
+	static std::size_t GetWordOffsetCount(std::uint32_t wordCount);
+	std::optional<std::size_t> FindKey(const KeyRecord* records, std::size_t count, std::string_view key) const;
+
+	std::vector<std::uint8_t> m_ownedBytes;
+	const std::uint8_t* m_data;
+	std::size_t m_size;
+	bool m_mapped;
+	const Header* m_header;
+	const DocumentRecord* m_documents;
+	const std::uint32_t* m_pathOrder;
+	const KeyRecord* m_terms;
+	const KeyRecord* m_ngrams;
+	const std::uint64_t* m_wordOffsets;
+};
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "IngestPipeline.h"
+#include "TaskGroup.h"
+
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iterator>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t DirentBufferSize = 32 * 1024;
+
+// Запись, которую возвращает getdents64
+struct LinuxDirent64
+{
+	std::uint64_t d_ino;
+	std::int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+struct FileDescriptorCloser
+{
+	int fd;
+
+	~FileDescriptorCloser()
+	{
+		close(fd);
+	}
+};
+
+enum class EntryKind
+{
+	Other,
+	File,
+	Directory,
+};
+
+// Как и directory_iterator, ссылки на файлы считаются файлами, а ссылки на каталоги не обходятся
+EntryKind GetEntryKind(int dirFd, const LinuxDirent64& entry)
+{
+	switch (entry.d_type)
+	{
+	case DT_REG:
+		return EntryKind::File;
+	case DT_DIR:
+		return EntryKind::Directory;
+	case DT_LNK:
+	case DT_UNKNOWN:
+		break;
+	default:
+		return EntryKind::Other;
+	}
+
+	struct stat info
+	{
+	};
+	if (fstatat(dirFd, entry.d_name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+	{
+		return EntryKind::Other;
+	}
+	if (S_ISDIR(info.st_mode))
+	{
+		return EntryKind::Directory;
+	}
+	if (S_ISLNK(info.st_mode) && fstatat(dirFd, entry.d_name, &info, 0) != 0)
+	{
+		return EntryKind::Other;
+	}
+	return S_ISREG(info.st_mode) ? EntryKind::File : EntryKind::Other;
+}
+} // namespace
+
+void IngestPipeline::StageCounters::Reset()
+{
+	items = 0;
+	bytes = 0;
+	busyNanoseconds = 0;
+}
+
+void IngestPipeline::StageCounters::AddBusyTime(Clock::time_point start)
+{
+	const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+	busyNanoseconds.fetch_add(duration.count(), std::memory_order_relaxed);
+}
+
+IngestPipeline::StageStats IngestPipeline::StageCounters::Load() const
+{
+	return {
+		items.load(std::memory_order_relaxed),
+		bytes.load(std::memory_order_relaxed),
+		static_cast<double>(busyNanoseconds.load(std::memory_order_relaxed)) / 1e9,
+	};
+}
+
+void IngestPipeline::Queues::CloseAll()
+{
+	directories.Close();
+	paths.Close();
+	files.Close();
+}
+
+IngestPipeline::IngestPipeline(ThreadPool& pool, FileLoader& loader)
+	: m_pool(pool)
+	, m_loader(loader)
+{
+}
+
+void IngestPipeline::Run(const std::filesystem::path& root, bool recursive, const VersionFn& getVersion, const IndexFn& index)
+{
+	m_crawl.Reset();
+	m_read.Reset();
+	m_index.Reset();
+	m_directories = 0;
+	m_unchanged = 0;
+	m_errors = 0;
+	m_finishTicks = 0;
+	m_startTicks = Clock::now().time_since_epoch().count();
+
+	Queues queues;
+	queues.pendingDirectories = 1;
+	queues.activeReaders = ReaderThreadCount;
+	queues.directories.Push(root);
+
+	{
+		// Потоки стадий присоединяются при выходе из блока, в том числе при исключении индексации
+		std::vector<std::jthread> threads;
+		for (std::size_t i = 0; i < CrawlerThreadCount; ++i)
+		{
+			threads.emplace_back([this, &queues, recursive] { Crawl(queues, recursive); });
+		}
+		for (std::size_t i = 0; i < ReaderThreadCount; ++i)
+		{
+			threads.emplace_back([this, &queues, &getVersion] { Read(queues, getVersion); });
+		}
+
+		try
+		{
+			// Каждая задача индексации держит поток пула до конца работы, так что фоновые задачи
+			// индекса в этот пул ставить нельзя. Вызывающий поток индексирует вместе с пулом
+			TaskGroup indexers(m_pool);
+			for (std::size_t i = 0; i < m_pool.GetThreadCount(); ++i)
+			{
+				indexers.Run([this, &queues, &index] { Index(queues, index); });
+			}
+			Index(queues, index);
+			indexers.Wait();
+		}
+		catch (...)
+		{
+			queues.CloseAll();
+			m_finishTicks = Clock::now().time_since_epoch().count();
+			throw;
+		}
+	}
+	m_finishTicks = Clock::now().time_since_epoch().count();
+}
+
+IngestPipeline::Stats IngestPipeline::GetStats() const
+{
+	Stats stats;
+	stats.directories = m_directories.load(std::memory_order_relaxed);
+	stats.unchanged = m_unchanged.load(std::memory_order_relaxed);
+	stats.errors = m_errors.load(std::memory_order_relaxed);
+	stats.crawl = m_crawl.Load();
+	stats.read = m_read.Load();
+	stats.index = m_index.Load();
+
+	const Clock::rep finish = m_finishTicks.load();
+	const Clock::rep end = finish != 0 ? finish : Clock::now().time_since_epoch().count();
+	stats.elapsedSeconds = std::chrono::duration<double>(Clock::duration(end - m_startTicks.load())).count();
+	return stats;
+}
+
+void IngestPipeline::Crawl(Queues& queues, bool recursive)
+{
+	std::filesystem::path dir;
+	while (queues.directories.WaitAndPop(dir))
+	{
+		try
+		{
+			CrawlDirectory(dir, queues, recursive);
+		}
+		catch (...)
+		{
+			// Очереди закрыты из-за ошибки индексации, или не хватило памяти на пути
+			m_errors.fetch_add(1, std::memory_order_relaxed);
+		}
+		// Последний обойдённый каталог завершает стадию: новых каталогов и файлов не будет
+		if (queues.pendingDirectories.fetch_sub(1) == 1)
+		{
+			queues.directories.Close();
+			queues.paths.Close();
+		}
+	}
+}
+
+void IngestPipeline::CrawlDirectory(const std::filesystem::path& dir, Queues& queues, bool recursive)
+{
+	auto start = Clock::now();
+	const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		m_errors.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	const FileDescriptorCloser closer{ fd };
+
+	alignas(LinuxDirent64) char buffer[DirentBufferSize];
+	std::vector<std::filesystem::path> files;
+	for (;;)
+	{
+		const long size = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+		if (size <= 0)
+		{
+			if (size < 0)
+			{
+				m_errors.fetch_add(1, std::memory_order_relaxed);
+			}
+			break;
+		}
+
+		for (long offset = 0; offset < size;)
+		{
+			const auto& entry = *reinterpret_cast<const LinuxDirent64*>(buffer + offset);
+			offset += entry.d_reclen;
+			const std::string_view name(entry.d_name);
+			if (name == "." || name == "..")
+			{
+				continue;
+			}
+
+			const EntryKind kind = GetEntryKind(fd, entry);
+			if (kind == EntryKind::File)
+			{
+				files.push_back(dir / name);
+			}
+			else if (kind == EntryKind::Directory && recursive)
+			{
+				queues.pendingDirectories.fetch_add(1);
+				queues.directories.Push(dir / name);
+			}
+		}
+
+		// Файлы одного пакета getdents64 передаются дальше под одной блокировкой очереди.
+		// Время ожидания места в очереди в занятость стадии не входит
+		m_crawl.items.fetch_add(files.size(), std::memory_order_relaxed);
+		m_crawl.AddBusyTime(start);
+		queues.paths.PushRange(std::make_move_iterator(files.begin()), std::make_move_iterator(files.end()));
+		files.clear();
+		start = Clock::now();
+	}
+	m_directories.fetch_add(1, std::memory_order_relaxed);
+}
+
+void IngestPipeline::Read(Queues& queues, const VersionFn& getVersion)
+{
+	std::filesystem::path path;
+	while (queues.paths.WaitAndPop(path))
+	{
+		const auto start = Clock::now();
+		auto result = m_loader.LoadIfChanged(path, getVersion(path));
+		m_read.AddBusyTime(start);
+		if (result.unchanged)
+		{
+			m_unchanged.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		if (!result.content)
+		{
+			m_errors.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		m_read.items.fetch_add(1, std::memory_order_relaxed);
+		m_read.bytes.fetch_add(result.content->GetData().size(), std::memory_order_relaxed);
+
+		try
+		{
+			queues.files.Push(LoadedFile{ std::move(path), std::move(result.content) });
+		}
+		catch (...)
+		{
+			// Очередь закрыта из-за ошибки индексации
+			break;
+		}
+	}
+	if (queues.activeReaders.fetch_sub(1) == 1)
+	{
+		queues.files.Close();
+	}
+}
+
+void IngestPipeline::Index(Queues& queues, const IndexFn& index)
+{
+	LoadedFile file;
+	try
+	{
+		while (queues.files.WaitAndPop(file))
+		{
+			const auto start = Clock::now();
+			const auto content = file.content->GetData();
+			index(file.path, content, file.content->GetVersion());
+			m_index.items.fetch_add(1, std::memory_order_relaxed);
+			m_index.bytes.fetch_add(content.size(), std::memory_order_relaxed);
+			// Буфер возвращается в пул до ожидания следующего файла
+			file.content.reset();
+			m_index.AddBusyTime(start);
+		}
+	}
+	catch (...)
+	{
+		// Остальные задачи индексации и стадии останавливаются, не дожидаясь конца обхода
+		queues.CloseAll();
+		throw;
+	}
+}
\ No newline at end of file
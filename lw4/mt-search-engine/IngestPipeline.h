@@ -0,0 +1,115 @@
+#pragma once
+
+#include "FileLoader.h"
+#include "ThreadPool.h"
+#include "ThreadSafeQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+
+// Конвейер добавления каталога: обход каталогов → чтение файлов → токенизация и индексация.
+// Каталоги обходятся параллельно пакетами getdents64, стадии связаны ограниченными очередями,
+// так что индексация начинается с первых найденных файлов, а число прочитанных, но ещё не
+// проиндексированных файлов ограничено. Обход и чтение идут в отдельных потоках,
+// индексация — на пуле, где часть потоков оставлена для фоновых слияний сегментов.
+// Счётчики стадий можно читать во время работы
+class IngestPipeline
+{
+public:
+	// Версия уже проиндексированного файла, если он есть в индексе
+	using VersionFn = std::function<std::optional<FileVersion>(const std::filesystem::path& path)>;
+	// Вызывается для каждого нового или изменённого файла; буфер можно менять на месте
+	using IndexFn = std::function<void(const std::filesystem::path& path, std::span<char> content, const FileVersion& version)>;
+
+	struct StageStats
+	{
+		std::size_t items = 0;
+		std::uint64_t bytes = 0;
+		// Суммарное время работы потоков стадии без ожидания в очередях
+		double busySeconds = 0.0;
+	};
+
+	struct Stats
+	{
+		std::size_t directories = 0;
+		std::size_t unchanged = 0;
+		std::size_t errors = 0;
+		StageStats crawl;
+		StageStats read;
+		StageStats index;
+		double elapsedSeconds = 0.0;
+	};
+
+	static constexpr std::size_t CrawlerThreadCount = 2;
+	static constexpr std::size_t ReaderThreadCount = 4;
+
+	IngestPipeline(ThreadPool& pool, FileLoader& loader);
+
+	IngestPipeline(const IngestPipeline&) = delete;
+	IngestPipeline& operator=(const IngestPipeline&) = delete;
+
+	// Каталог, который не удалось открыть, и файл, который не удалось прочитать, пропускаются
+	// и учитываются в errors. Символические ссылки на каталоги не обходятся.
+	// Файлы, не изменившиеся с индексации, не передаются в index и учитываются в unchanged
+	void Run(const std::filesystem::path& root, bool recursive, const VersionFn& getVersion, const IndexFn& index);
+	Stats GetStats() const;
+
+private:
+	static constexpr std::size_t PathQueueCapacity = 1024;
+	static constexpr std::size_t FileQueueCapacity = 64;
+
+	using Clock = std::chrono::steady_clock;
+
+	struct StageCounters
+	{
+		std::atomic<std::size_t> items = 0;
+		std::atomic<std::uint64_t> bytes = 0;
+		std::atomic<std::int64_t> busyNanoseconds = 0;
+
+		void Reset();
+		void AddBusyTime(Clock::time_point start);
+		StageStats Load() const;
+	};
+
+	struct LoadedFile
+	{
+		std::filesystem::path path;
+		std::optional<FileLoader::Content> content;
+	};
+
+	struct Queues
+	{
+		ThreadSafeQueue<std::filesystem::path> directories;
+		ThreadSafeQueue<std::filesystem::path> paths{ PathQueueCapacity };
+		ThreadSafeQueue<LoadedFile> files{ FileQueueCapacity };
+		// Каталоги, найденные, но ещё не обойдённые
+		std::atomic<std::size_t> pendingDirectories = 0;
+		std::atomic<std::size_t> activeReaders = 0;
+
+		void CloseAll();
+	};
+
+	void Crawl(Queues& queues, bool recursive);
+	void CrawlDirectory(const std::filesystem::path& dir, Queues& queues, bool recursive);
+	void Read(Queues& queues, const VersionFn& getVersion);
+	void Index(Queues& queues, const IndexFn& index);
+
+	ThreadPool& m_pool;
+	FileLoader& m_loader;
+
+	StageCounters m_crawl;
+	StageCounters m_read;
+	StageCounters m_index;
+	std::atomic<std::size_t> m_directories = 0;
+	std::atomic<std::size_t> m_unchanged = 0;
+	std::atomic<std::size_t> m_errors = 0;
+	std::atomic<Clock::rep> m_startTicks = 0;
+	// 0, пока конвейер работает: тогда время считается до текущего момента
+	std::atomic<Clock::rep> m_finishTicks = 0;
+};
\ No newline at end of file
@@ -1,63 +1,317 @@
 #include "InvertedIndex.h"
+#include "PositionMatch.h"
+#include "PostingIntersection.h"
+#include "ThreadPool.h"
 #include "Tokenizer.h"
 
+#include <algorithm>
 #include <cmath>
-#include <filesystem>
+#include <functional>
+#include <limits>
+#include <map>
 #include <mutex>
+#include <optional>
 #include <ranges>
-
-namespace fs = std::filesystem;
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
 
 namespace
 {
-bool IsPathInDir(const std::string& filePath, const std::string& dirPath)
+constexpr size_t MaxResultCount = 10;
+constexpr double Bm25K1 = 1.2;
+constexpr double Bm25B = 0.75;
+// Сегмент сливается с более новыми, если он не больше чем в MergeSizeRatio раз их суммы
+constexpr std::size_t MergeSizeRatio = 2;
+// При ранжировании по близости переоцениваются ProximityCandidateFactor * MaxResultCount лучших
+// по обычной оценке документов. Оценка документа, где термы стоят подряд, растёт в 1 + ProximityWeight раз
+constexpr std::size_t ProximityCandidateFactor = 4;
+constexpr double ProximityWeight = 0.5;
+// Запрос выполняется на пуле, если по оценке в нём не меньше ParallelQueryMinCandidates кандидатов;
+// столько же приходится как минимум на каждую его часть. Частей берётся до ParallelQueryPartsPerThread
+// на поток, чтобы неравные по трудности части выравнивались между потоками
+constexpr std::size_t ParallelQueryMinCandidates = 32 * 1024;
+constexpr std::size_t ParallelQueryPartsPerThread = 2;
+// Корзин путей изменяемого сегмента вдвое больше, чем в нём бывает документов
+constexpr std::size_t MemoryPathBucketCount = 2048;
+
+std::size_t GetPathBucket(const std::string& path)
+{
+	return std::hash<std::string>{}(path) % MemoryPathBucketCount;
+}
+
+// Публикует новую версию элемента таблицы, nullptr удаляет элемент. Прежняя версия
+// откладывается в retired, пока её могут читать
+template <typename T>
+void Publish(ChunkedTable<T>& table, std::size_t index, std::unique_ptr<T> next,
+	std::vector<std::unique_ptr<const T>>& retired)
 {
-	const fs::path file(filePath);
-	const fs::path dir(dirPath);
-	try
+	if (const T* previous = table.Exchange(index, next.get()))
 	{
-		return file.parent_path() == dir;
+		retired.emplace_back(previous);
 	}
-	catch (...)
+	next.release();
+}
+
+// Элемент таблицы, созданный пустым при первом обращении
+template <typename T>
+T& GetOrCreate(ChunkedTable<T>& table, std::size_t index)
+{
+	if (T* item = table.Load(index))
 	{
-		return false;
+		return *item;
 	}
+	auto created = std::make_unique<T>();
+	T& item = *created;
+	table.Exchange(index, created.release());
+	return item;
 }
 
-bool IsPathInDirRecursive(const std::string& filePath, const std::string& dirPath)
+// Сливает списки разных сегментов, пропуская удалённые документы. Сегменты не пересекаются
+// по документам, так что на каждом шаге берётся наименьший docId среди курсоров
+PostingList MergePostings(const std::vector<std::pair<PostingListView, const TombstoneBitmap*>>& sources, bool withPayload)
 {
-	const fs::path file(filePath);
-	const fs::path dir(dirPath);
-	try
+	PostingList merged(withPayload);
+	std::vector<PostingListView::Cursor> cursors;
+	cursors.reserve(sources.size());
+	for (const auto& source : sources)
 	{
-		return file.lexically_relative(dir).empty() || !file.lexically_relative(dir).has_root_path();
+		cursors.push_back(source.first.GetCursor());
 	}
-	catch (...)
+
+	for (;;)
 	{
-		return false;
+		std::optional<std::size_t> next;
+		for (std::size_t i = 0; i < cursors.size(); ++i)
+		{
+			if (!cursors[i].IsEnd() && (!next || cursors[i].GetDocId() < cursors[*next].GetDocId()))
+			{
+				next = i;
+			}
+		}
+		if (!next)
+		{
+			return merged;
+		}
+		auto& cursor = cursors[*next];
+		const auto* deleted = sources[*next].second;
+		if (!deleted || !deleted->Contains(cursor.GetDocId()))
+		{
+			merged.Add(cursor.GetDocId(), cursor.GetPayload());
+		}
+		cursor.Next();
+	}
+}
+
+// Постинги только документов из docIds; docIds отсортированы
+PostingList KeepDocuments(const PostingListView& list, const std::vector<std::uint64_t>& docIds, bool withPayload)
+{
+	PostingList kept(withPayload);
+	auto doc = docIds.begin();
+	for (auto cursor = list.GetCursor(); !cursor.IsEnd(); cursor.Next())
+	{
+		doc = std::lower_bound(doc, docIds.end(), cursor.GetDocId());
+		if (doc == docIds.end())
+		{
+			break;
+		}
+		if (*doc == cursor.GetDocId())
+		{
+			kept.Add(cursor.GetDocId(), cursor.GetPayload());
+		}
+	}
+	return kept;
+}
+
+// Позиции сегментов сливаются так же, как постинги
+PositionList MergePositions(const std::vector<std::pair<std::span<const std::uint8_t>, const TombstoneBitmap*>>& sources)
+{
+	PositionList merged;
+	std::vector<PositionList::Cursor> cursors;
+	cursors.reserve(sources.size());
+	for (const auto& source : sources)
+	{
+		cursors.emplace_back(source.first);
+	}
+
+	std::vector<std::uint32_t> positions;
+	for (;;)
+	{
+		std::optional<std::size_t> next;
+		for (std::size_t i = 0; i < cursors.size(); ++i)
+		{
+			if (!cursors[i].IsEnd() && (!next || cursors[i].GetDocId() < cursors[*next].GetDocId()))
+			{
+				next = i;
+			}
+		}
+		if (!next)
+		{
+			return merged;
+		}
+		auto& cursor = cursors[*next];
+		const auto* deleted = sources[*next].second;
+		if (!deleted || !deleted->Contains(cursor.GetDocId()))
+		{
+			cursor.GetPositions(positions);
+			merged.Add(cursor.GetDocId(), positions);
+		}
+		cursor.Next();
+	}
+}
+
+// Позиции терма в документе изменяемого сегмента; пусто, если терма в документе нет
+void GetMemoryPositions(const Document& doc, TermId termId, std::vector<std::uint32_t>& out)
+{
+	out.clear();
+	std::size_t offset = 0;
+	for (const auto& [id, frequency] : doc.termFrequencies)
+	{
+		if (id == termId)
+		{
+			const auto first = doc.positions.begin() + static_cast<std::ptrdiff_t>(offset);
+			out.assign(first, first + frequency);
+			return;
+		}
+		if (id > termId)
+		{
+			return;
+		}
+		offset += frequency;
+	}
+}
+
+// Число живых документов списка: проверяется меньшее из двух множеств —
+// удалённые документы по списку или список по удалённым
+std::size_t CountLiveDocs(const PostingListView& docs, const TombstoneBitmap* deleted)
+{
+	if (!deleted)
+	{
+		return docs.GetSize();
+	}
+	std::size_t deletedCount = 0;
+	if (deleted->GetCount() < docs.GetSize())
+	{
+		deleted->ForEach([&](std::uint64_t docId) {
+			deletedCount += docs.Contains(docId) ? 1 : 0;
+		});
+	}
+	else
+	{
+		for (auto cursor = docs.GetCursor(); !cursor.IsEnd(); cursor.Next())
+		{
+			deletedCount += deleted->Contains(cursor.GetDocId()) ? 1 : 0;
+		}
+	}
+	return docs.GetSize() - deletedCount;
+}
+
+// Окно слияния [first, last) в списке сегментов от старых к новым. Сегмент, где удалена
+// хотя бы половина документов, переписывается отдельно. Иначе к самому новому сегменту
+// присоединяются более старые, пока каждый из них соизмерим с уже набранным окном:
+// так каждый документ переписывается O(log n) раз
+template <typename Segments>
+std::optional<std::pair<std::size_t, std::size_t>> SelectMergeWindow(const Segments& segments)
+{
+	for (std::size_t i = 0; i < segments.size(); ++i)
+	{
+		if (segments[i].GetLiveCount() * 2 <= segments[i].segment->GetDocumentCount())
+		{
+			return std::pair{ i, i + 1 };
+		}
+	}
+	if (segments.size() < 2)
+	{
+		return std::nullopt;
+	}
+
+	std::size_t first = segments.size() - 1;
+	std::size_t windowSize = segments[first].GetLiveCount();
+	while (first > 0 && segments[first - 1].GetLiveCount() <= MergeSizeRatio * windowSize)
+	{
+		--first;
+		windowSize += segments[first].GetLiveCount();
+	}
+	if (segments.size() - first < 2)
+	{
+		return std::nullopt;
 	}
+	return std::pair{ first, segments.size() };
 }
 
 template <typename T>
 void LimitResults(std::vector<T>& results)
 {
-	constexpr size_t maxCount = 10;
-	if (results.size() > maxCount)
+	if (results.size() > MaxResultCount)
 	{
-		results.resize(maxCount);
+		results.resize(MaxResultCount);
 	}
 }
 
 } // namespace
 
-InvertedIndex::InvertedIndex(int ngramSize)
+InvertedIndex::PostingShard::PostingShard(EpochReclaimer& reclaimer)
+	: terms(reclaimer)
+	, ngrams(reclaimer)
+{
+}
+
+InvertedIndex::DocumentShard::DocumentShard(EpochReclaimer& reclaimer)
+	: documents(reclaimer)
+{
+}
+
+InvertedIndex::MemorySegment::MemorySegment(std::size_t shardCount, EpochReclaimer& reclaimer)
+	: paths(reclaimer)
+{
+	for (std::size_t i = 0; i < shardCount; ++i)
+	{
+		postingShards.emplace_back(reclaimer);
+		documentShards.emplace_back(reclaimer);
+	}
+}
+
+bool InvertedIndex::StoredSegment::IsDeleted(std::uint64_t docId) const
+{
+	return deleted && deleted->Contains(docId);
+}
+
+std::size_t InvertedIndex::StoredSegment::GetLiveCount() const
+{
+	return segment->GetDocumentCount() - (deleted ? deleted->GetCount() : 0);
+}
+
+InvertedIndex::InvertedIndex(int ngramSize, std::size_t shardCount, ThreadPool* pool, ThreadPool* mergePool)
 	: m_ngramSize(ngramSize)
+	, m_shardCount(std::max<std::size_t>(1, shardCount))
+	, m_pool(pool)
+	, m_mergePool(mergePool)
+{
+	auto snapshot = std::make_unique<Snapshot>();
+	snapshot->memory = std::make_shared<MemorySegment>(m_shardCount, m_epochs);
+	snapshot->paths = std::make_shared<PathTable>(m_epochs);
+	m_snapshot.store(snapshot.release());
+}
+
+InvertedIndex::~InvertedIndex()
 {
+	// Фоновое слияние обращается к индексу, поэтому его нужно дождаться
+	std::lock_guard lock(m_mergeTaskMutex);
+	if (m_mergeTask.valid())
+	{
+		m_mergeTask.wait();
+	}
+	delete m_snapshot.load();
 }
 
-void InvertedIndex::AddDocument(std::uint64_t docId, const std::string& path, const std::string& content)
+void InvertedIndex::AddDocument(std::uint64_t docId, const std::string& path, std::span<char> content, const FileVersion& version)
 {
-	const auto words = Tokenizer::ExtractWords(content);
+	// Слова — string_view внутрь content, отдельные строки под них не создаются
+	std::vector<std::string_view> words;
+	Tokenizer::ForEachWord(content, [&words](std::string_view word) {
+		words.push_back(word);
+	});
 	if (words.empty())
 	{
 		return;
@@ -67,109 +321,210 @@ void InvertedIndex::AddDocument(std::uint64_t docId, const std::string& path, co
 	doc.id = docId;
 	doc.path = path;
 	doc.wordCount = words.size();
+	doc.version = version;
 
-	std::unordered_map<std::string, std::size_t> tf;
-	for (const auto& word : words)
+	// Все слова переводятся в идентификаторы за один проход по словарю, после чего частоты
+	// и позиции собираются по отсортированным парам (идентификатор, позиция) без хеширования строк
+	const auto ids = m_terms.Intern(words);
+	std::vector<std::pair<TermId, std::uint32_t>> occurrences(ids.size());
+	for (std::size_t i = 0; i < ids.size(); ++i)
 	{
-		tf[word]++;
+		occurrences[i] = { ids[i], static_cast<std::uint32_t>(i) };
 	}
-	doc.termFrequencies = std::move(tf);
-
-	std::unique_lock lock(m_mutex);
-
-	if (const auto it = m_pathToId.find(path); it != m_pathToId.end())
+	std::sort(occurrences.begin(), occurrences.end());
+	doc.positions.reserve(occurrences.size());
+	for (const auto& [id, position] : occurrences)
+	{
+		if (doc.termFrequencies.empty() || doc.termFrequencies.back().first != id)
+		{
+			doc.termFrequencies.emplace_back(id, 0);
+		}
+		++doc.termFrequencies.back().second;
+		doc.positions.push_back(position);
+	}
+	for (std::size_t i = 0; i < words.size(); i += Document::WordOffsetInterval)
 	{
-		RemoveDocumentInternal(it->second);
+		doc.wordOffsets.push_back(static_cast<std::uint64_t>(words[i].data() - content.data()));
 	}
 
-	m_documents[docId] = std::move(doc);
-	m_pathToId[path] = docId;
-
-	for (const auto& term : m_documents[docId].termFrequencies | std::views::keys)
+	bool isMemoryFull = false;
 	{
-		m_termToDocs[term].insert(docId);
-		for (auto grams = Tokenizer::GenerateNGrams(term, m_ngramSize);
-			const auto& gram : grams)
+		std::shared_lock writeLock(m_writeMutex);
+		const auto snapshot = GetSnapshot();
+		auto& memory = *snapshot->memory;
+		RetiredObjects retired;
+
+		// Сначала документ становится видимым целиком, и только потом путь переключается на него:
+		// параллельные добавление и удаление того же пути видят либо старую, либо новую версию.
+		// Путь по docId разрешается раньше, чем документ может попасть в результаты поиска
+		snapshot->paths->Add(docId, path);
+		auto published = std::make_unique<Document>(std::move(doc));
+		const Document& stored = *published;
 		{
-			m_ngramToDocs[gram].insert(docId);
+			auto& shard = GetDocumentShard(memory, docId);
+			std::lock_guard lock(shard.mutex);
+			Publish(shard.documents, GetDocumentSlot(docId), std::move(published), retired.documents);
 		}
+		m_totalDocs.fetch_add(1, std::memory_order_relaxed);
+		m_totalWords.fetch_add(stored.wordCount, std::memory_order_relaxed);
+		InsertPostings(memory, docId, stored, retired);
+		isMemoryFull = memory.docCount.fetch_add(1, std::memory_order_relaxed) + 1 >= MemorySegmentDocLimit;
+
+		if (const auto replacedId = UpdateMemoryPath(memory, path, docId, retired))
+		{
+			RemoveMemoryDocument(memory, *snapshot->paths, *replacedId, retired);
+		}
+		else if (!RemoveFrozenDocument(*snapshot, path, retired))
+		{
+			DeleteFromSegments({ path });
+		}
+		RetireObjects(std::move(retired));
 	}
-	m_totalDocs = m_documents.size();
-}
 
-void InvertedIndex::RemoveDocument(const std::string& path)
-{
-	std::unique_lock lock(m_mutex);
-	const auto it = m_pathToId.find(path);
-	if (it == m_pathToId.end())
+	m_generation.fetch_add(1, std::memory_order_release);
+
+	if (isMemoryFull)
 	{
-		return;
+		FlushMemorySegment(false);
 	}
+}
 
-	RemoveDocumentInternal(it->second);
-	m_pathToId.erase(it);
-	m_totalDocs = m_documents.size();
+void InvertedIndex::RemoveDocument(const std::string& path)
+{
+	RemoveDocuments({ path });
 }
 
 void InvertedIndex::RemoveDocumentsInDir(const std::string& dirPath, bool recursive)
 {
-	std::vector<std::string> toRemove;
+	RemoveDocuments(GetSnapshot()->paths->GetPathsInDirectory(dirPath, recursive));
+}
+
+std::vector<std::pair<std::uint64_t, double>> InvertedIndex::Search(const std::vector<std::string>& queryTerms) const
+{
+	auto query = PrepareQuery(queryTerms);
+	if (!query)
+	{
+		return {};
+	}
+
+	// Терм, встречающийся во всех документах, ничего не добавляет к релевантности.
+	// MaxScore перебирает термы по возрастанию верхней границы вклада
+	const auto prepareTerms = [](std::vector<QueryTerm>& terms) {
+		std::erase_if(terms, [](const QueryTerm& queryTerm) { return queryTerm.weight <= 0.0; });
+		std::sort(terms.begin(), terms.end(), [](const QueryTerm& a, const QueryTerm& b) {
+			return a.upperBound < b.upperBound;
+		});
+	};
+	prepareTerms(query->memoryTerms);
+	prepareTerms(query->frozenTerms);
+	for (auto& terms : query->segmentTerms)
+	{
+		prepareTerms(terms);
+	}
+
+	const bool isProximity = m_proximityRanking.load(std::memory_order_relaxed) && query->uniqueTerms.size() > 1;
+	const std::size_t capacity = isProximity ? ProximityCandidateFactor * MaxResultCount : MaxResultCount;
+	TopResults top(capacity);
+	const auto parts = SplitQuery(*query);
+	if (parts.empty())
 	{
-		std::shared_lock lock(m_mutex);
-		for (const auto& path : m_pathToId | std::views::keys)
+		// Порог top-K, набранный в одном источнике, сразу отсекает кандидатов в следующих
+		SearchMaxScore(QueryPart{ &query->memoryTerms }, query->scorer, top);
+		SearchMaxScore(QueryPart{ &query->frozenTerms }, query->scorer, top);
+		for (std::size_t i = 0; i < query->segmentTerms.size(); ++i)
 		{
-			const bool match = recursive
-				? IsPathInDirRecursive(path, dirPath)
-				: IsPathInDir(path, dirPath);
-			if (match)
+			SearchMaxScore(QueryPart{ &query->segmentTerms[i], &query->snapshot->segments[i] }, query->scorer, top);
+		}
+	}
+	else
+	{
+		// Каждая часть набирает свои top-K, итоговые — лучшие из их объединения
+		const auto partResults = m_pool->ParallelMap(0, parts.size(), 1, [&](std::size_t i) {
+			TopResults partTop(capacity);
+			SearchMaxScore(parts[i], query->scorer, partTop);
+			return partTop.TakeSorted();
+		});
+		for (const auto& results : partResults)
+		{
+			for (const auto& [docId, score] : results)
 			{
-				toRemove.push_back(path);
+				top.Push(docId, score);
 			}
 		}
 	}
-	for (const auto& path : toRemove)
+	auto results = top.TakeSorted();
+	if (isProximity)
 	{
-		RemoveDocument(path);
+		ApplyProximityBoost(*query, results);
 	}
+	return results;
 }
 
-std::vector<std::pair<std::uint64_t, double>> InvertedIndex::Search(const std::vector<std::string>& queryTerms) const
+std::vector<std::pair<std::uint64_t, double>> InvertedIndex::SearchPositional(const PositionalQuery& query) const
 {
-	if (queryTerms.empty())
+	const auto prepared = PrepareQuery(query.terms);
+	if (!prepared)
 	{
 		return {};
 	}
 
-	std::shared_lock lock(m_mutex);
-
-	std::unordered_set<std::uint64_t> candidateDocs;
-	for (const auto& term : queryTerms)
+	std::vector<std::size_t> wordTerms;
+	wordTerms.reserve(query.terms.size());
+	for (const auto& term : query.terms)
 	{
-		if (auto it = m_termToDocs.find(term); it != m_termToDocs.end())
+		const auto it = std::ranges::find(prepared->uniqueTerms, term, &std::pair<std::string, std::size_t>::first);
+		wordTerms.push_back(static_cast<std::size_t>(it - prepared->uniqueTerms.begin()));
+	}
+
+	// Источник 0 — изменяемый сегмент, 1 — замороженный, i + 2 — i-й неизменяемый
+	const auto searchSource = [&](std::size_t i, TopResults& top) {
+		if (i < 2)
 		{
-			candidateDocs.insert(it->second.begin(), it->second.end());
+			SearchPositions(query, wordTerms, *prepared, i == 0 ? prepared->memoryTerms : prepared->frozenTerms, top, nullptr);
 		}
-	}
-	if (candidateDocs.empty())
-	{
-		return {};
-	}
+		else
+		{
+			SearchPositions(query, wordTerms, *prepared, prepared->segmentTerms[i - 2], top, &prepared->snapshot->segments[i - 2]);
+		}
+	};
+	const std::size_t sourceCount = prepared->segmentTerms.size() + 2;
 
-	std::vector<std::pair<std::uint64_t, double>> results;
-	results.reserve(candidateDocs.size());
+	// Кандидатов в источнике не больше, чем документов в самом коротком списке
+	std::size_t estimated = 0;
+	const auto addEstimate = [&](const std::vector<QueryTerm>& terms) {
+		if (!terms.empty())
+		{
+			estimated += std::ranges::min(terms, {}, [](const QueryTerm& t) { return t.postings.docs.GetSize(); }).postings.docs.GetSize();
+		}
+	};
+	addEstimate(prepared->memoryTerms);
+	addEstimate(prepared->frozenTerms);
+	std::ranges::for_each(prepared->segmentTerms, addEstimate);
 
-	for (std::uint64_t docId : candidateDocs)
+	TopResults top(MaxResultCount);
+	if (IsParallelQuery(estimated))
 	{
-		if (double score = ComputeRelevance(docId, queryTerms, m_totalDocs); score > 0.0)
+		const auto sourceResults = m_pool->ParallelMap(0, sourceCount, 1, [&](std::size_t i) {
+			TopResults sourceTop(MaxResultCount);
+			searchSource(i, sourceTop);
+			return sourceTop.TakeSorted();
+		});
+		for (const auto& results : sourceResults)
 		{
-			results.emplace_back(docId, score);
+			for (const auto& [docId, score] : results)
+			{
+				top.Push(docId, score);
+			}
 		}
 	}
-
-	std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
-	LimitResults(results);
-
-	return results;
+	else
+	{
+		for (std::size_t i = 0; i < sourceCount; ++i)
+		{
+			searchSource(i, top);
+		}
+	}
+	return top.TakeSorted();
 }
 
 std::vector<std::uint64_t> InvertedIndex::SearchSubstring(const std::string& substring) const
@@ -188,151 +543,1466 @@ std::vector<std::uint64_t> InvertedIndex::SearchSubstring(const std::string& sub
 		return {};
 	}
 
-	std::shared_lock lock(m_mutex);
+	const auto snapshot = GetSnapshot();
+	std::vector<NgramQuery> queries;
+	queries.reserve(snapshot->segments.size() + 2);
+	queries.push_back(CollectMemoryNgrams(*snapshot->memory, queryNGrams));
+	if (snapshot->frozen)
+	{
+		queries.push_back(CollectMemoryNgrams(*snapshot->frozen, queryNGrams));
+	}
+	for (const auto& source : snapshot->segments)
+	{
+		queries.push_back(CollectSegmentNgrams(source, queryNGrams));
+	}
+
+	// Кандидатов в источнике не больше, чем документов в самом коротком списке
+	std::size_t estimated = 0;
+	for (const auto& query : queries)
+	{
+		if (!query.postings.empty())
+		{
+			estimated += std::ranges::min(query.postings, {}, &PostingListView::GetSize).GetSize();
+		}
+	}
 
-	auto resultDocs = IntersectNgramResults(queryNGrams);
+	// Из пересечения нужны только первые MaxResultCount docId, дальше его можно не считать.
+	// Поэтому на части делятся только источники: они не пересекаются по документам,
+	// так что результаты просто объединяются
+	std::vector<std::uint64_t> resultDocs;
+	const auto appendDocs = [&resultDocs](const std::vector<std::uint64_t>& docs) {
+		resultDocs.insert(resultDocs.end(), docs.begin(), docs.end());
+	};
+	if (queries.size() > 1 && IsParallelQuery(estimated))
+	{
+		const auto sourceDocs = m_pool->ParallelMap(0, queries.size(), 1, [&queries](std::size_t i) {
+			return IntersectNgrams(queries[i], MaxResultCount);
+		});
+		std::ranges::for_each(sourceDocs, appendDocs);
+	}
+	else
+	{
+		for (const auto& query : queries)
+		{
+			appendDocs(IntersectNgrams(query, MaxResultCount));
+		}
+	}
+	std::sort(resultDocs.begin(), resultDocs.end());
 	LimitResults(resultDocs);
 
 	return resultDocs;
 }
 
-std::string InvertedIndex::GetPathById(std::uint64_t id) const
+void InvertedIndex::SetProximityRanking(bool enabled)
 {
-	std::shared_lock lock(m_mutex);
-	const auto it = m_documents.find(id);
-	return (it != m_documents.end()) ? it->second.path : "";
+	m_proximityRanking.store(enabled, std::memory_order_relaxed);
 }
 
-bool InvertedIndex::HasDocument(const std::string& path) const
+bool InvertedIndex::IsProximityRanking() const
 {
-	std::shared_lock lock(m_mutex);
-	return m_pathToId.contains(path);
+	return m_proximityRanking.load(std::memory_order_relaxed);
 }
 
-std::vector<Document> InvertedIndex::GetIndexedDocuments() const
+void InvertedIndex::SetRankingModel(RankingModel model)
 {
-	std::shared_lock lock(m_mutex);
-	std::vector<Document> docs;
-	docs.reserve(m_documents.size());
-
-	for (const auto& doc : m_documents | std::views::values)
-	{
-		docs.push_back(doc);
-	}
-
-	std::sort(docs.begin(), docs.end(), [](const Document& a, const Document& b) {
-		return a.id < b.id;
-	});
-
-	return docs;
+	m_rankingModel.store(model, std::memory_order_relaxed);
 }
 
-double InvertedIndex::ComputeRelevance(std::uint64_t docId, const std::vector<std::string>& queryTerms, std::size_t totalDocs) const
+RankingModel InvertedIndex::GetRankingModel() const
 {
-	const auto& doc = m_documents.at(docId);
-	double score = 0.0;
-
-	for (const auto& term : queryTerms)
-	{
-		auto tfIt = doc.termFrequencies.find(term);
-		if (tfIt == doc.termFrequencies.end())
-		{
-			continue;
-		}
-
-		const double tf = static_cast<double>(tfIt->second) / static_cast<double>(doc.wordCount);
-
-		auto dfIt = m_termToDocs.find(term);
-		if (dfIt == m_termToDocs.end())
-		{
-			continue;
-		}
-
-		const std::size_t df = dfIt->second.size();
-		if (df == 0 || totalDocs == 0)
-		{
-			continue;
-		}
-
-		const double idf = std::log(static_cast<double>(totalDocs) / static_cast<double>(df));
-		score += tf * idf;
-	}
+	return m_rankingModel.load(std::memory_order_relaxed);
+}
 
-	return score;
+std::string InvertedIndex::GetPathById(std::uint64_t id) const
+{
+	return GetSnapshot()->paths->GetPath(id);
 }
 
-std::vector<std::uint64_t> InvertedIndex::IntersectNgramResults(
-	const std::vector<std::string>& ngrams) const
+EpochReclaimer::Pinned<const PathTable> InvertedIndex::GetPathTable() const
 {
-	if (ngrams.empty())
-	{
-		return {};
-	}
+	auto guard = m_epochs.Pin();
+	return { std::move(guard), m_snapshot.load(std::memory_order_seq_cst)->paths.get() };
+}
 
-	const auto it = m_ngramToDocs.find(ngrams[0]);
-	if (it == m_ngramToDocs.end())
+bool InvertedIndex::HasDocument(const std::string& path) const
+{
+	const auto snapshot = GetSnapshot();
+	if (FindMemoryPath(*snapshot->memory, path) || (snapshot->frozen && FindMemoryPath(*snapshot->frozen, path)))
 	{
-		return {};
+		return true;
 	}
 
-	std::vector resultDocs(it->second.begin(), it->second.end());
-	std::sort(resultDocs.begin(), resultDocs.end());
+	return std::ranges::any_of(snapshot->segments, [&](const StoredSegment& source) {
+		const auto index = source.segment->FindDocumentByPath(path);
+		return index && !source.IsDeleted(source.segment->GetDocumentId(*index));
+	});
+}
 
-	for (size_t i = 1; i < ngrams.size(); ++i)
+std::optional<FileVersion> InvertedIndex::GetDocumentVersion(const std::string& path) const
+{
+	const auto snapshot = GetSnapshot();
+	for (const auto* memory : { snapshot->memory.get(), snapshot->frozen.get() })
 	{
-		auto ngramIt = m_ngramToDocs.find(ngrams[i]);
-		if (ngramIt == m_ngramToDocs.end())
+		if (const auto docId = memory ? FindMemoryPath(*memory, path) : std::nullopt)
 		{
-			return {};
+			const Document* doc = FindMemoryDocument(*memory, *docId);
+			return doc ? std::optional(doc->version) : std::nullopt;
 		}
+	}
 
-		std::vector nextDocs(ngramIt->second.begin(), ngramIt->second.end());
-		std::sort(nextDocs.begin(), nextDocs.end());
-
-		std::vector<std::uint64_t> intersection;
-		std::set_intersection(
-			resultDocs.begin(), resultDocs.end(),
-			nextDocs.begin(), nextDocs.end(),
-			std::back_inserter(intersection));
-		resultDocs = std::move(intersection);
-
-		if (resultDocs.empty())
+	for (const auto& source : snapshot->segments)
+	{
+		const auto index = source.segment->FindDocumentByPath(path);
+		if (index && !source.IsDeleted(source.segment->GetDocumentId(*index)))
 		{
-			break;
+			return source.segment->GetDocument(*index).version;
 		}
 	}
-
-	return resultDocs;
+	return std::nullopt;
 }
 
-void InvertedIndex::RemoveDocumentInternal(std::uint64_t docId)
+std::vector<Document> InvertedIndex::GetIndexedDocuments() const
 {
-	const auto docIt = m_documents.find(docId);
-	if (docIt == m_documents.end())
-	{
-		return;
-	}
-	for (const auto& [id, path, wordCount, termFrequencies] = docIt->second;
-		const auto& term : termFrequencies | std::views::keys)
+	const auto snapshot = GetSnapshot();
+	std::vector<Document> docs;
+	for (const auto* memory : { snapshot->memory.get(), snapshot->frozen.get() })
 	{
-		auto& docSet = m_termToDocs[term];
-		docSet.erase(docId);
-		if (docSet.empty())
+		if (!memory)
+		{
+			continue;
+		}
+		for (const auto& shard : memory->documentShards)
 		{
-			m_termToDocs.erase(term);
+			shard.documents.ForEach([&docs](std::size_t, const Document& doc) {
+				Document copy;
+				copy.id = doc.id;
+				copy.path = doc.path;
+				copy.wordCount = doc.wordCount;
+				copy.version = doc.version;
+				docs.push_back(std::move(copy));
+			});
 		}
-
-		for (auto grams = Tokenizer::GenerateNGrams(term, m_ngramSize);
-			const auto& gram : grams)
+	}
+	for (const auto& source : snapshot->segments)
+	{
+		for (std::size_t i = 0; i < source.segment->GetDocumentCount(); ++i)
 		{
-			auto& gramSet = m_ngramToDocs[gram];
-			gramSet.erase(docId);
-			if (gramSet.empty())
+			if (!source.IsDeleted(source.segment->GetDocumentId(i)))
 			{
-				m_ngramToDocs.erase(gram);
+				docs.push_back(source.segment->GetDocument(i));
 			}
 		}
 	}
 
-	m_documents.erase(docIt);
+	std::sort(docs.begin(), docs.end(), [](const Document& a, const Document& b) {
+		return a.id < b.id;
+	});
+
+	return docs;
+}
+
+std::optional<DocumentPositions> InvertedIndex::GetDocumentPositions(std::uint64_t docId, const std::vector<std::string>& terms) const
+{
+	return FindDocumentPositions(*GetSnapshot(), docId, terms);
+}
+
+std::uint64_t InvertedIndex::GetGeneration() const
+{
+	return m_generation.load(std::memory_order_acquire);
+}
+
+std::size_t InvertedIndex::GetPostingShardIndex(TermId id) const
+{
+	return id % m_shardCount;
+}
+
+std::size_t InvertedIndex::GetPostingSlot(TermId id) const
+{
+	return id / m_shardCount;
+}
+
+const InvertedIndex::DocumentShard& InvertedIndex::GetDocumentShard(const MemorySegment& memory, std::uint64_t docId) const
+{
+	return memory.documentShards[docId % m_shardCount];
+}
+
+InvertedIndex::DocumentShard& InvertedIndex::GetDocumentShard(MemorySegment& memory, std::uint64_t docId)
+{
+	return memory.documentShards[docId % m_shardCount];
+}
+
+std::size_t InvertedIndex::GetDocumentSlot(std::uint64_t docId) const
+{
+	return docId / m_shardCount;
+}
+
+const Document* InvertedIndex::FindMemoryDocument(const MemorySegment& memory, std::uint64_t docId) const
+{
+	return GetDocumentShard(memory, docId).documents.Load(GetDocumentSlot(docId));
+}
+
+const Document* InvertedIndex::FindMemoryDocument(const Snapshot& snapshot, std::uint64_t docId) const
+{
+	const Document* doc = FindMemoryDocument(*snapshot.memory, docId);
+	return doc || !snapshot.frozen ? doc : FindMemoryDocument(*snapshot.frozen, docId);
+}
+
+std::optional<std::uint64_t> InvertedIndex::FindMemoryPath(const MemorySegment& memory, const std::string& path)
+{
+	const PathBucket* bucket = memory.paths.Load(GetPathBucket(path));
+	if (!bucket)
+	{
+		return std::nullopt;
+	}
+	const auto it = std::ranges::find(*bucket, path, &PathBucket::value_type::first);
+	return it != bucket->end() ? std::optional(it->second) : std::nullopt;
+}
+
+std::optional<std::uint64_t> InvertedIndex::UpdateMemoryPath(MemorySegment& memory, const std::string& path,
+	std::optional<std::uint64_t> docId, RetiredObjects& retired)
+{
+	std::lock_guard lock(memory.pathMutex);
+	const std::size_t index = GetPathBucket(path);
+	const PathBucket* current = memory.paths.Load(index);
+	auto bucket = current ? std::make_unique<PathBucket>(*current) : std::make_unique<PathBucket>();
+	std::optional<std::uint64_t> previous;
+	if (const auto it = std::ranges::find(*bucket, path, &PathBucket::value_type::first); it != bucket->end())
+	{
+		previous = it->second;
+		if (docId)
+		{
+			it->second = *docId;
+		}
+		else
+		{
+			bucket->erase(it);
+		}
+	}
+	else if (docId)
+	{
+		bucket->emplace_back(path, *docId);
+	}
+	else
+	{
+		return std::nullopt;
+	}
+	Publish<PathBucket>(memory.paths, index, bucket->empty() ? nullptr : std::move(bucket), retired.paths);
+	return previous;
+}
+
+void InvertedIndex::RetireObjects(RetiredObjects retired)
+{
+	if (!retired.terms.empty() || !retired.ngrams.empty() || !retired.storages.empty() || !retired.documents.empty()
+		|| !retired.paths.empty())
+	{
+		m_epochs.Retire(new RetiredObjects(std::move(retired)));
+	}
+}
+
+InvertedIndex::ShardedKeys InvertedIndex::GroupKeysByShard(const Document& doc)
+{
+	ShardedKeys keys;
+	keys.terms.resize(m_shardCount);
+	keys.ngrams.resize(m_shardCount);
+
+	// N-граммы — string_view внутрь строк словаря, которые не перемещаются
+	std::vector<std::string_view> grams;
+	for (const auto& entry : doc.termFrequencies)
+	{
+		keys.terms[GetPostingShardIndex(entry.first)].push_back(&entry);
+		Tokenizer::ForEachNGram(m_terms.GetTerm(entry.first), m_ngramSize, [&grams](std::string_view gram) {
+			grams.push_back(gram);
+		});
+	}
+
+	// Одна n-грамма встречается во многих термах документа, в постинги она попадает один раз
+	auto gramIds = m_ngrams.Intern(grams);
+	std::sort(gramIds.begin(), gramIds.end());
+	gramIds.erase(std::unique(gramIds.begin(), gramIds.end()), gramIds.end());
+	for (const TermId id : gramIds)
+	{
+		keys.ngrams[GetPostingShardIndex(id)].push_back(id);
+	}
+	return keys;
+}
+
+double InvertedIndex::TermScorer::operator()(std::uint32_t frequency, std::uint32_t documentLength) const
+{
+	const auto tf = static_cast<double>(frequency);
+	const auto length = static_cast<double>(documentLength);
+	if (model == RankingModel::Bm25)
+	{
+		return tf * (Bm25K1 + 1.0) / (tf + Bm25K1 * (1.0 - Bm25B + Bm25B * length / averageDocumentLength));
+	}
+	return tf / length;
+}
+
+InvertedIndex::SnapshotRef InvertedIndex::GetSnapshot() const
+{
+	auto guard = m_epochs.Pin();
+	return SnapshotRef(std::move(guard), m_snapshot.load(std::memory_order_seq_cst));
+}
+
+void InvertedIndex::PublishSnapshot(std::unique_ptr<const Snapshot> next)
+{
+	m_epochs.Retire(m_snapshot.exchange(next.release(), std::memory_order_seq_cst));
+}
+
+std::optional<InvertedIndex::PreparedQuery> InvertedIndex::PrepareQuery(const std::vector<std::string>& queryTerms) const
+{
+	if (queryTerms.empty())
+	{
+		return std::nullopt;
+	}
+
+	PreparedQuery query{ GetSnapshot(), {}, {}, {}, {}, {} };
+	// Повторы терма в запросе учитываются кратностью
+	for (const auto& term : queryTerms)
+	{
+		const auto it = std::find_if(query.uniqueTerms.begin(), query.uniqueTerms.end(), [&](const auto& t) { return t.first == term; });
+		if (it != query.uniqueTerms.end())
+		{
+			++it->second;
+			continue;
+		}
+		query.uniqueTerms.emplace_back(term, 1);
+	}
+
+	const std::size_t totalDocs = m_totalDocs.load(std::memory_order_relaxed);
+	if (totalDocs == 0)
+	{
+		return std::nullopt;
+	}
+	query.scorer = {
+		m_rankingModel.load(std::memory_order_relaxed),
+		static_cast<double>(m_totalWords.load(std::memory_order_relaxed)) / static_cast<double>(totalDocs),
+	};
+	const auto& scorer = query.scorer;
+
+	// Постинги собираются из каждого источника снимка отдельно, а idf — по суммарному df живых документов
+	query.memoryTerms = CollectMemoryTerms(*query.snapshot->memory, query.uniqueTerms);
+	if (query.snapshot->frozen)
+	{
+		query.frozenTerms = CollectMemoryTerms(*query.snapshot->frozen, query.uniqueTerms);
+	}
+	query.segmentTerms.reserve(query.snapshot->segments.size());
+	for (const auto& source : query.snapshot->segments)
+	{
+		query.segmentTerms.push_back(CollectSegmentTerms(*source.segment, query.uniqueTerms));
+	}
+
+	std::vector<std::size_t> dfs(query.uniqueTerms.size());
+	for (const auto* terms : { &query.memoryTerms, &query.frozenTerms })
+	{
+		for (const auto& queryTerm : *terms)
+		{
+			dfs[queryTerm.queryIndex] += queryTerm.postings.docs.GetSize();
+		}
+	}
+	for (std::size_t i = 0; i < query.segmentTerms.size(); ++i)
+	{
+		for (const auto& queryTerm : query.segmentTerms[i])
+		{
+			dfs[queryTerm.queryIndex] += CountLiveDocs(queryTerm.postings.docs, query.snapshot->segments[i].deleted.get());
+		}
+	}
+	// idf считается один раз на терм запроса, а не для каждой пары (документ, терм).
+	// Счётчики документов и списки читаются не атомарно вместе, поэтому df ограничивается сверху
+	std::vector<double> idfs(query.uniqueTerms.size());
+	for (std::size_t i = 0; i < query.uniqueTerms.size(); ++i)
+	{
+		const auto n = static_cast<double>(totalDocs);
+		const auto df = std::min(static_cast<double>(dfs[i]), n);
+		idfs[i] = scorer.model == RankingModel::Bm25
+			? std::log(1.0 + (n - df + 0.5) / (df + 0.5))
+			: std::log(n / df);
+	}
+
+	const auto weighTerms = [&](std::vector<QueryTerm>& terms) {
+		for (auto& queryTerm : terms)
+		{
+			const double idf = idfs[queryTerm.queryIndex];
+			const auto& postings = queryTerm.postings;
+			const double maxTermScore = scorer.model == RankingModel::Bm25
+				? scorer(postings.maxFrequency, postings.minDocumentLength)
+				: postings.maxNormalizedTf;
+			queryTerm.weight = static_cast<double>(queryTerm.multiplicity) * idf;
+			queryTerm.upperBound = queryTerm.weight * maxTermScore;
+		}
+	};
+	weighTerms(query.memoryTerms);
+	weighTerms(query.frozenTerms);
+	for (auto& terms : query.segmentTerms)
+	{
+		weighTerms(terms);
+	}
+	return query;
+}
+
+std::vector<InvertedIndex::QueryTerm> InvertedIndex::CollectMemoryTerms(const MemorySegment& memory,
+	const std::vector<std::pair<std::string, std::size_t>>& queryTerms) const
+{
+	// Терм, которого нет в словаре, не встречается ни в одном документе
+	std::vector<QueryTerm> terms;
+	for (std::size_t i = 0; i < queryTerms.size(); ++i)
+	{
+		const auto termId = m_terms.Find(queryTerms[i].first);
+		if (!termId)
+		{
+			continue;
+		}
+		const ConcurrentTermPostings* postings = memory.postingShards[GetPostingShardIndex(*termId)].terms.Load(GetPostingSlot(*termId));
+		const TermPostingsView view = postings ? postings->GetView() : TermPostingsView();
+		if (view.docs.IsEmpty())
+		{
+			continue;
+		}
+		QueryTerm queryTerm;
+		queryTerm.queryIndex = i;
+		queryTerm.multiplicity = queryTerms[i].second;
+		queryTerm.keyIndex = *termId;
+		queryTerm.postings = view;
+		terms.push_back(std::move(queryTerm));
+	}
+	return terms;
+}
+
+std::vector<InvertedIndex::QueryTerm> InvertedIndex::CollectSegmentTerms(const IndexSegment& segment,
+	const std::vector<std::pair<std::string, std::size_t>>& queryTerms)
+{
+	std::vector<QueryTerm> terms;
+	for (std::size_t i = 0; i < queryTerms.size(); ++i)
+	{
+		const auto index = segment.FindTerm(queryTerms[i].first);
+		if (!index)
+		{
+			continue;
+		}
+		QueryTerm queryTerm;
+		queryTerm.queryIndex = i;
+		queryTerm.multiplicity = queryTerms[i].second;
+		queryTerm.keyIndex = *index;
+		queryTerm.postings = segment.GetTermPostings(*index);
+		terms.push_back(std::move(queryTerm));
+	}
+	return terms;
+}
+
+std::vector<InvertedIndex::QueryPart> InvertedIndex::SplitQuery(const PreparedQuery& query) const
+{
+	std::vector<QueryPart> sources;
+	sources.reserve(query.segmentTerms.size() + 2);
+	sources.push_back(QueryPart{ &query.memoryTerms });
+	sources.push_back(QueryPart{ &query.frozenTerms });
+	for (std::size_t i = 0; i < query.segmentTerms.size(); ++i)
+	{
+		sources.push_back(QueryPart{ &query.segmentTerms[i], &query.snapshot->segments[i] });
+	}
+
+	// Оценка числа кандидатов — суммарная длина списков, отсечение MaxScore её только уменьшает
+	std::vector<std::size_t> estimates;
+	std::size_t total = 0;
+	for (const auto& source : sources)
+	{
+		std::size_t estimate = 0;
+		for (const auto& queryTerm : *source.terms)
+		{
+			estimate += queryTerm.postings.docs.GetSize();
+		}
+		estimates.push_back(estimate);
+		total += estimate;
+	}
+	if (!IsParallelQuery(total))
+	{
+		return {};
+	}
+
+	const std::size_t partCount = std::min(
+		(m_pool->GetThreadCount() + 1) * ParallelQueryPartsPerThread,
+		total / ParallelQueryMinCandidates);
+	std::vector<QueryPart> parts;
+	for (std::size_t i = 0; i < sources.size(); ++i)
+	{
+		if (estimates[i] == 0)
+		{
+			continue;
+		}
+
+		// Источнику достаётся доля частей по его оценке. Его диапазон docId делится поровну:
+		// документы получают идентификаторы подряд, так что кандидаты распределены по нему равномерно
+		std::uint64_t firstDocId = std::numeric_limits<std::uint64_t>::max();
+		std::uint64_t lastDocId = 0;
+		for (const auto& queryTerm : *sources[i].terms)
+		{
+			const auto& docs = queryTerm.postings.docs;
+			if (!docs.IsEmpty())
+			{
+				firstDocId = std::min(firstDocId, docs.GetBlockFirstDocId(0));
+				lastDocId = std::max(lastDocId, docs.GetBlockLastDocId(docs.GetBlockCount() - 1));
+			}
+		}
+		const std::size_t count = std::max<std::size_t>(1, partCount * estimates[i] / total);
+		const std::uint64_t width = (lastDocId - firstDocId) / count + 1;
+		for (std::size_t j = 0; j < count; ++j)
+		{
+			QueryPart part = sources[i];
+			part.firstDocId = firstDocId + j * width;
+			if (j + 1 < count)
+			{
+				part.endDocId = part.firstDocId + width;
+			}
+			parts.push_back(part);
+		}
+	}
+	if (parts.size() < 2)
+	{
+		return {};
+	}
+	return parts;
+}
+
+bool InvertedIndex::IsParallelQuery(std::size_t estimatedCandidates) const
+{
+	return m_pool && m_pool->GetThreadCount() > 0 && estimatedCandidates >= ParallelQueryMinCandidates;
+}
+
+void InvertedIndex::SearchMaxScore(const QueryPart& part, const TermScorer& scorer, TopResults& top)
+{
+	// Префикс термов, чья суммарная граница вклада не превышает порога top-K, «несущественный»:
+	// документ, найденный только в них, в top-K не попадёт. Кандидаты перебираются лишь
+	// по существенным спискам, а несущественные проверяются точечно и только пока документ
+	// ещё может обойти порог
+	const auto& terms = *part.terms;
+
+	std::vector<double> boundPrefix(terms.size());
+	std::vector<PostingListView::Cursor> cursors;
+	cursors.reserve(terms.size());
+	double boundSum = 0.0;
+	for (std::size_t i = 0; i < terms.size(); ++i)
+	{
+		boundSum += terms[i].upperBound;
+		boundPrefix[i] = boundSum;
+		cursors.push_back(terms[i].postings.docs.GetCursor());
+		if (part.firstDocId > 0)
+		{
+			cursors.back().SkipTo(part.firstDocId);
+		}
+	}
+
+	std::size_t firstEssential = 0;
+	const auto updateFirstEssential = [&] {
+		while (firstEssential < terms.size() && boundPrefix[firstEssential] <= top.GetThreshold())
+		{
+			++firstEssential;
+		}
+	};
+	updateFirstEssential();
+
+	while (firstEssential < terms.size())
+	{
+		std::uint64_t docId = std::numeric_limits<std::uint64_t>::max();
+		for (std::size_t i = firstEssential; i < terms.size(); ++i)
+		{
+			if (!cursors[i].IsEnd())
+			{
+				docId = std::min(docId, cursors[i].GetDocId());
+			}
+		}
+		if (docId == std::numeric_limits<std::uint64_t>::max() || docId >= part.endDocId)
+		{
+			break;
+		}
+
+		const auto contribution = [&](std::size_t i) {
+			const auto& payload = cursors[i].GetPayload();
+			return terms[i].weight * scorer(payload.frequency, payload.documentLength);
+		};
+
+		const bool isDeleted = part.source && part.source->IsDeleted(docId);
+		double score = 0.0;
+		for (std::size_t i = firstEssential; i < terms.size(); ++i)
+		{
+			if (!cursors[i].IsEnd() && cursors[i].GetDocId() == docId)
+			{
+				score += isDeleted ? 0.0 : contribution(i);
+				cursors[i].Next();
+			}
+		}
+		if (isDeleted)
+		{
+			continue;
+		}
+
+		for (std::size_t i = firstEssential; i-- > 0;)
+		{
+			if (score + boundPrefix[i] <= top.GetThreshold())
+			{
+				break;
+			}
+			cursors[i].SkipTo(docId);
+			if (!cursors[i].IsEnd() && cursors[i].GetDocId() == docId)
+			{
+				score += contribution(i);
+			}
+		}
+
+		if (score > 0.0 && top.Push(docId, score))
+		{
+			updateFirstEssential();
+		}
+	}
+}
+
+void InvertedIndex::SearchPositions(const PositionalQuery& query, const std::vector<std::size_t>& wordTerms,
+	const PreparedQuery& prepared, const std::vector<QueryTerm>& terms, TopResults& top,
+	const StoredSegment* source) const
+{
+	// Документ должен содержать все термы запроса, поэтому кандидаты — пересечение их списков,
+	// и позиции читаются только для них. Термы собраны по порядку, так что terms[i] — i-й уникальный
+	if (terms.size() != prepared.uniqueTerms.size())
+	{
+		return;
+	}
+	std::vector<PostingListView> postings;
+	std::vector<PostingListView::Cursor> postingCursors;
+	std::vector<PositionList::Cursor> positionCursors;
+	for (const auto& queryTerm : terms)
+	{
+		postings.push_back(queryTerm.postings.docs);
+		if (source)
+		{
+			postingCursors.push_back(queryTerm.postings.docs.GetCursor());
+			positionCursors.emplace_back(source->segment->GetTermPositions(queryTerm.keyIndex));
+		}
+	}
+
+	std::vector<std::vector<std::uint32_t>> positions(terms.size());
+	std::vector<std::span<const std::uint32_t>> matched;
+	for (const std::uint64_t docId : PostingIntersection::Intersect(std::move(postings)))
+	{
+		if (source && source->IsDeleted(docId))
+		{
+			continue;
+		}
+
+		std::uint32_t documentLength = 0;
+		if (source)
+		{
+			// Кандидаты идут по возрастанию, так что курсоры только продвигаются вперёд
+			postingCursors.front().SkipTo(docId);
+			documentLength = postingCursors.front().GetPayload().documentLength;
+			for (std::size_t i = 0; i < terms.size(); ++i)
+			{
+				positionCursors[i].SkipTo(docId);
+				if (positionCursors[i].IsEnd() || positionCursors[i].GetDocId() != docId)
+				{
+					throw std::runtime_error("Corrupted index file");
+				}
+				positionCursors[i].GetPositions(positions[i]);
+			}
+		}
+		else
+		{
+			const Document* doc = FindMemoryDocument(*prepared.snapshot, docId);
+			// Документ удалён после того, как были скопированы постинги
+			if (!doc)
+			{
+				continue;
+			}
+			documentLength = static_cast<std::uint32_t>(doc->wordCount);
+			for (std::size_t i = 0; i < terms.size(); ++i)
+			{
+				GetMemoryPositions(*doc, static_cast<TermId>(terms[i].keyIndex), positions[i]);
+			}
+		}
+
+		matched.clear();
+		bool isMatch = false;
+		if (query.kind == PositionalQuery::Kind::Phrase)
+		{
+			for (const std::size_t term : wordTerms)
+			{
+				matched.emplace_back(positions[term]);
+			}
+			isMatch = PositionMatch::ContainsPhrase(matched);
+		}
+		else
+		{
+			matched.assign(positions.begin(), positions.end());
+			const auto window = PositionMatch::FindShortestWindow(matched);
+			isMatch = window && window->second - window->first <= query.distance;
+		}
+		if (!isMatch)
+		{
+			continue;
+		}
+
+		// Совпадение засчитывается, даже если все термы встречаются везде и оценка нулевая
+		double score = 0.0;
+		for (std::size_t i = 0; i < terms.size(); ++i)
+		{
+			score += terms[i].weight * prepared.scorer(static_cast<std::uint32_t>(positions[i].size()), documentLength);
+		}
+		top.Push(docId, score);
+	}
+}
+
+std::optional<DocumentPositions> InvertedIndex::FindDocumentPositions(const Snapshot& snapshot, std::uint64_t docId,
+	const std::vector<std::string>& terms) const
+{
+	DocumentPositions result;
+	result.termPositions.resize(terms.size());
+	if (const Document* doc = FindMemoryDocument(snapshot, docId))
+	{
+		result.path = doc->path;
+		result.version = doc->version;
+		result.wordCount = doc->wordCount;
+		result.wordOffsets = doc->wordOffsets;
+		for (std::size_t i = 0; i < terms.size(); ++i)
+		{
+			if (const auto termId = m_terms.Find(terms[i]))
+			{
+				GetMemoryPositions(*doc, *termId, result.termPositions[i]);
+			}
+		}
+		return result;
+	}
+
+	// Позиции сегмента читаются только для термов запроса и только в блоке этого документа
+	for (const auto& source : snapshot.segments)
+	{
+		const auto index = source.segment->FindDocument(docId);
+		if (!index || source.IsDeleted(docId))
+		{
+			continue;
+		}
+		auto doc = source.segment->GetDocument(*index);
+		result.path = std::move(doc.path);
+		result.version = doc.version;
+		result.wordCount = doc.wordCount;
+		const auto wordOffsets = source.segment->GetWordOffsets(*index);
+		result.wordOffsets.assign(wordOffsets.begin(), wordOffsets.end());
+		for (std::size_t i = 0; i < terms.size(); ++i)
+		{
+			const auto termIndex = source.segment->FindTerm(terms[i]);
+			if (!termIndex)
+			{
+				continue;
+			}
+			PositionList::Cursor cursor(source.segment->GetTermPositions(*termIndex));
+			cursor.SkipTo(docId);
+			if (!cursor.IsEnd() && cursor.GetDocId() == docId)
+			{
+				cursor.GetPositions(result.termPositions[i]);
+			}
+		}
+		return result;
+	}
+	return std::nullopt;
+}
+
+void InvertedIndex::ApplyProximityBoost(const PreparedQuery& prepared, std::vector<std::pair<std::uint64_t, double>>& results) const
+{
+	// Оценка умножается на 1 + ProximityWeight * (m - 1) / span, где m — число термов запроса
+	// в документе, а span — длина кратчайшего окна со всеми ними минус один: для термов подряд это m - 1
+	std::vector<std::string> terms;
+	for (const auto& term : prepared.uniqueTerms | std::views::keys)
+	{
+		terms.push_back(term);
+	}
+	std::vector<std::span<const std::uint32_t>> present;
+	for (auto& [docId, score] : results)
+	{
+		const auto positions = FindDocumentPositions(*prepared.snapshot, docId, terms);
+		if (!positions)
+		{
+			continue;
+		}
+		present.clear();
+		for (const auto& list : positions->termPositions)
+		{
+			if (!list.empty())
+			{
+				present.emplace_back(list);
+			}
+		}
+		if (present.size() < 2)
+		{
+			continue;
+		}
+		const auto window = PositionMatch::FindShortestWindow(present);
+		const auto span = static_cast<double>(window->second - window->first);
+		score *= 1.0 + ProximityWeight * static_cast<double>(present.size() - 1) / span;
+	}
+
+	std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+		return a.second > b.second || (a.second == b.second && a.first < b.first);
+	});
+	LimitResults(results);
+}
+
+InvertedIndex::NgramQuery InvertedIndex::CollectMemoryNgrams(const MemorySegment& memory,
+	const std::vector<std::string>& ngrams) const
+{
+	NgramQuery query;
+	query.postings.reserve(ngrams.size());
+	for (const auto& gram : ngrams)
+	{
+		const auto gramId = m_ngrams.Find(gram);
+		if (!gramId)
+		{
+			return {};
+		}
+		const ConcurrentPostingList* list = memory.postingShards[GetPostingShardIndex(*gramId)].ngrams.Load(GetPostingSlot(*gramId));
+		const PostingListView view = list ? list->GetView() : PostingListView();
+		if (view.IsEmpty())
+		{
+			return {};
+		}
+		query.postings.push_back(view);
+	}
+	return query;
+}
+
+InvertedIndex::NgramQuery InvertedIndex::CollectSegmentNgrams(const StoredSegment& source,
+	const std::vector<std::string>& ngrams)
+{
+	NgramQuery query;
+	query.source = &source;
+	query.postings.reserve(ngrams.size());
+	for (const auto& gram : ngrams)
+	{
+		const auto index = source.segment->FindNgram(gram);
+		if (!index)
+		{
+			return {};
+		}
+		query.postings.push_back(source.segment->GetNgramPostings(*index));
+	}
+	return query;
+}
+
+std::vector<std::uint64_t> InvertedIndex::IntersectNgrams(const NgramQuery& query, std::size_t limit)
+{
+	if (query.postings.empty())
+	{
+		return {};
+	}
+
+	if (!query.source)
+	{
+		return PostingIntersection::Intersect(query.postings, limit);
+	}
+
+	// Удалённые документы отсеиваются после пересечения, поэтому запас берётся на их число
+	const auto& source = *query.source;
+	const std::size_t deletedCount = source.deleted ? source.deleted->GetCount() : 0;
+	const std::size_t extendedLimit = limit > std::numeric_limits<std::size_t>::max() - deletedCount
+		? std::numeric_limits<std::size_t>::max()
+		: limit + deletedCount;
+	auto result = PostingIntersection::Intersect(query.postings, extendedLimit);
+	std::erase_if(result, [&source](std::uint64_t docId) { return source.IsDeleted(docId); });
+	if (result.size() > limit)
+	{
+		result.resize(limit);
+	}
+	return result;
+}
+
+void InvertedIndex::InsertPostings(MemorySegment& memory, std::uint64_t docId, const Document& doc, RetiredObjects& retired)
+{
+	const auto keys = GroupKeysByShard(doc);
+	const auto documentLength = static_cast<std::uint32_t>(doc.wordCount);
+	for (std::size_t i = 0; i < m_shardCount; ++i)
+	{
+		if (keys.terms[i].empty() && keys.ngrams[i].empty())
+		{
+			continue;
+		}
+
+		auto& shard = memory.postingShards[i];
+		std::lock_guard lock(shard.mutex);
+		for (const auto* entry : keys.terms[i])
+		{
+			GetOrCreate(shard.terms, GetPostingSlot(entry->first)).Add(docId, { entry->second, documentLength }, retired.storages);
+		}
+		for (const TermId gramId : keys.ngrams[i])
+		{
+			GetOrCreate(shard.ngrams, GetPostingSlot(gramId)).Add(docId, {}, retired.storages);
+		}
+	}
+}
+
+void InvertedIndex::ErasePostings(MemorySegment& memory, std::uint64_t docId, const Document& doc, RetiredObjects& retired)
+{
+	// Опустевший список удаляется из таблицы вместе со статистикой терма
+	const auto eraseFrom = [docId, &retired](auto& table, std::size_t slot, auto& retiredItems, auto getDocs) {
+		auto* item = table.Load(slot);
+		if (!item || !getDocs(*item).Remove(docId, retired.storages) || !getDocs(*item).GetView().IsEmpty())
+		{
+			return;
+		}
+		table.Exchange(slot, nullptr);
+		retiredItems.emplace_back(item);
+	};
+
+	const auto keys = GroupKeysByShard(doc);
+	for (std::size_t i = 0; i < m_shardCount; ++i)
+	{
+		if (keys.terms[i].empty() && keys.ngrams[i].empty())
+		{
+			continue;
+		}
+
+		auto& shard = memory.postingShards[i];
+		std::lock_guard lock(shard.mutex);
+		for (const auto* entry : keys.terms[i])
+		{
+			eraseFrom(shard.terms, GetPostingSlot(entry->first), retired.terms,
+				[](auto& postings) -> auto& { return postings.docs; });
+		}
+		for (const TermId gramId : keys.ngrams[i])
+		{
+			eraseFrom(shard.ngrams, GetPostingSlot(gramId), retired.ngrams, [](auto& postings) -> auto& { return postings; });
+		}
+	}
+}
+
+void InvertedIndex::RemoveMemoryDocument(MemorySegment& memory, PathTable& paths, std::uint64_t docId, RetiredObjects& retired)
+{
+	const Document* doc = nullptr;
+	{
+		auto& shard = GetDocumentShard(memory, docId);
+		std::lock_guard lock(shard.mutex);
+		doc = shard.documents.Exchange(GetDocumentSlot(docId), nullptr);
+	}
+	if (!doc)
+	{
+		return;
+	}
+	// Документ освобождается вместе с прочими вытесненными версиями, когда его перестанут читать
+	retired.documents.emplace_back(doc);
+	paths.Remove(docId);
+	memory.docCount.fetch_sub(1, std::memory_order_relaxed);
+	m_totalDocs.fetch_sub(1, std::memory_order_relaxed);
+	m_totalWords.fetch_sub(doc->wordCount, std::memory_order_relaxed);
+	ErasePostings(memory, docId, *doc, retired);
+}
+
+bool InvertedIndex::RemoveFrozenDocument(const Snapshot& snapshot, const std::string& path, RetiredObjects& retired)
+{
+	if (!snapshot.frozen)
+	{
+		return false;
+	}
+	const auto docId = UpdateMemoryPath(*snapshot.frozen, path, std::nullopt, retired);
+	if (!docId)
+	{
+		return false;
+	}
+	RemoveMemoryDocument(*snapshot.frozen, *snapshot.paths, *docId, retired);
+	return true;
+}
+
+void InvertedIndex::RemoveDocuments(const std::vector<std::string>& paths)
+{
+	std::shared_lock writeLock(m_writeMutex);
+	const auto snapshot = GetSnapshot();
+	auto& memory = *snapshot->memory;
+
+	RetiredObjects retired;
+	std::vector<std::string> segmentPaths;
+	for (const auto& path : paths)
+	{
+		if (const auto docId = UpdateMemoryPath(memory, path, std::nullopt, retired))
+		{
+			RemoveMemoryDocument(memory, *snapshot->paths, *docId, retired);
+		}
+		else if (!RemoveFrozenDocument(*snapshot, path, retired))
+		{
+			segmentPaths.push_back(path);
+		}
+	}
+	RetireObjects(std::move(retired));
+	// Документы неизменяемых сегментов удаляются одной публикацией нового снимка
+	DeleteFromSegments(segmentPaths);
+	m_generation.fetch_add(1, std::memory_order_release);
+}
+
+void InvertedIndex::DeleteFromSegments(const std::vector<std::string>& paths)
+{
+	// Сегменты неизменяемы, поэтому проверка без блокировки отсеивает обычный случай —
+	// путь, которого в сегментах нет
+	const auto isLive = [](const StoredSegment& source, const std::string& path) {
+		const auto index = source.segment->FindDocumentByPath(path);
+		return index && !source.IsDeleted(source.segment->GetDocumentId(*index));
+	};
+	const auto current = GetSnapshot();
+	const bool hasLive = std::ranges::any_of(paths, [&](const std::string& path) {
+		return std::ranges::any_of(current->segments, [&](const StoredSegment& source) { return isLive(source, path); });
+	});
+	if (!hasLive)
+	{
+		return;
+	}
+
+	std::lock_guard lock(m_publishMutex);
+	auto next = std::make_unique<Snapshot>(*GetSnapshot());
+	bool changed = false;
+	for (auto& source : next->segments)
+	{
+		// Карта копируется не больше одного раза на сегмент, и копия разделяет с ней
+		// нетронутые блоки: удаление копирует лишь указатели на блоки и изменённый блок
+		std::shared_ptr<TombstoneBitmap> deleted;
+		for (const auto& path : paths)
+		{
+			const auto index = source.segment->FindDocumentByPath(path);
+			if (!index)
+			{
+				continue;
+			}
+			const std::uint64_t docId = source.segment->GetDocumentId(*index);
+			if (!deleted)
+			{
+				if (source.IsDeleted(docId))
+				{
+					continue;
+				}
+				const std::size_t docCount = source.segment->GetDocumentCount();
+				deleted = source.deleted
+					? std::make_shared<TombstoneBitmap>(*source.deleted)
+					: std::make_shared<TombstoneBitmap>(source.segment->GetDocumentId(0), source.segment->GetDocumentId(docCount - 1));
+			}
+			if (deleted->Insert(docId))
+			{
+				next->paths->Remove(docId);
+				m_totalDocs.fetch_sub(1, std::memory_order_relaxed);
+				m_totalWords.fetch_sub(source.segment->GetDocument(*index).wordCount, std::memory_order_relaxed);
+			}
+		}
+		if (deleted)
+		{
+			source.deleted = std::move(deleted);
+			changed = true;
+		}
+	}
+	if (changed)
+	{
+		PublishSnapshot(std::move(next));
+	}
+}
+
+InvertedIndex::SegmentContents InvertedIndex::CollectMemoryContents(const MemorySegment& memory) const
+{
+	// Сегмент заморожен: документы в него не добавляются, но могут удаляться. Вызывающий
+	// держит закрепление эпохи, так что прочитанные документы и списки не освобождаются
+	std::vector<const Document*> docs;
+	for (const auto& shard : memory.documentShards)
+	{
+		shard.documents.ForEach([&docs](std::size_t, const Document& doc) {
+			docs.push_back(&doc);
+		});
+	}
+	std::sort(docs.begin(), docs.end(), [](const Document* a, const Document* b) {
+		return a->id < b->id;
+	});
+
+	// Документы идут по возрастанию id, поэтому позиции дописываются в конец списков
+	SegmentContents contents;
+	std::unordered_map<TermId, PositionList> positions;
+	std::vector<std::uint64_t> docIds;
+	docIds.reserve(docs.size());
+	for (const Document* doc : docs)
+	{
+		docIds.push_back(doc->id);
+		Document stored;
+		stored.id = doc->id;
+		stored.path = doc->path;
+		stored.wordCount = doc->wordCount;
+		stored.version = doc->version;
+		stored.wordOffsets = doc->wordOffsets;
+		contents.docs.push_back(std::move(stored));
+
+		std::size_t offset = 0;
+		for (const auto& [termId, frequency] : doc->termFrequencies)
+		{
+			positions[termId].Add(doc->id, std::span(doc->positions).subspan(offset, frequency));
+			offset += frequency;
+		}
+	}
+	for (auto& [termId, list] : positions)
+	{
+		contents.positions.emplace(m_terms.GetTerm(termId), std::move(list));
+	}
+
+	for (std::size_t shardIndex = 0; shardIndex < m_shardCount; ++shardIndex)
+	{
+		const auto& shard = memory.postingShards[shardIndex];
+		const auto getId = [&](std::size_t slot) {
+			return static_cast<TermId>(slot * m_shardCount + shardIndex);
+		};
+		// В списках ещё могут быть документы, удалённые до сбора docs
+		shard.terms.ForEach([&](std::size_t slot, const ConcurrentTermPostings& postings) {
+			if (auto kept = KeepDocuments(postings.docs.GetView(), docIds, true); !kept.IsEmpty())
+			{
+				contents.terms.emplace(m_terms.GetTerm(getId(slot)), std::move(kept));
+			}
+		});
+		shard.ngrams.ForEach([&](std::size_t slot, const ConcurrentPostingList& postings) {
+			if (auto kept = KeepDocuments(postings.GetView(), docIds, false); !kept.IsEmpty())
+			{
+				contents.ngrams.emplace(m_ngrams.GetTerm(getId(slot)), std::move(kept));
+			}
+		});
+	}
+	return contents;
+}
+
+InvertedIndex::SegmentContents InvertedIndex::CollectSegmentContents(const std::vector<StoredSegment>& sources)
+{
+	SegmentContents contents;
+	for (const auto& source : sources)
+	{
+		for (std::size_t i = 0; i < source.segment->GetDocumentCount(); ++i)
+		{
+			if (!source.IsDeleted(source.segment->GetDocumentId(i)))
+			{
+				auto doc = source.segment->GetDocument(i);
+				const auto wordOffsets = source.segment->GetWordOffsets(i);
+				doc.wordOffsets.assign(wordOffsets.begin(), wordOffsets.end());
+				contents.docs.push_back(std::move(doc));
+			}
+		}
+	}
+	std::sort(contents.docs.begin(), contents.docs.end(), [](const Document& a, const Document& b) {
+		return a.id < b.id;
+	});
+
+	// Таблицы ключей сегментов упорядочены по строке, так что они сливаются за один проход,
+	// а ключи попадают в map уже по порядку. mergeKey получает пары (источник, номер ключа в нём)
+	const auto mergeKeys = [&sources](auto getCount, auto getKey, auto mergeKey) {
+		std::vector<std::size_t> positions(sources.size());
+		std::vector<std::pair<const StoredSegment*, std::size_t>> entries;
+		for (;;)
+		{
+			std::optional<std::string_view> key;
+			for (std::size_t i = 0; i < sources.size(); ++i)
+			{
+				const auto& segment = *sources[i].segment;
+				if (positions[i] < getCount(segment) && (!key || getKey(segment, positions[i]) < *key))
+				{
+					key = getKey(segment, positions[i]);
+				}
+			}
+			if (!key)
+			{
+				return;
+			}
+
+			entries.clear();
+			for (std::size_t i = 0; i < sources.size(); ++i)
+			{
+				const auto& segment = *sources[i].segment;
+				if (positions[i] < getCount(segment) && getKey(segment, positions[i]) == *key)
+				{
+					entries.emplace_back(&sources[i], positions[i]);
+					++positions[i];
+				}
+			}
+			mergeKey(*key, entries);
+		}
+	};
+
+	// Списки, целиком состоящие из удалённых документов, в новый сегмент не попадают
+	mergeKeys(
+		[](const IndexSegment& segment) { return segment.GetTermCount(); },
+		[](const IndexSegment& segment, std::size_t i) { return segment.GetTerm(i); },
+		[&contents](std::string_view key, const auto& entries) {
+			std::vector<std::pair<PostingListView, const TombstoneBitmap*>> lists;
+			std::vector<std::pair<std::span<const std::uint8_t>, const TombstoneBitmap*>> positionLists;
+			for (const auto& [source, index] : entries)
+			{
+				lists.emplace_back(source->segment->GetTermPostings(index).docs, source->deleted.get());
+				positionLists.emplace_back(source->segment->GetTermPositions(index), source->deleted.get());
+			}
+			if (auto merged = MergePostings(lists, true); !merged.IsEmpty())
+			{
+				contents.terms.emplace_hint(contents.terms.end(), std::string(key), std::move(merged));
+				contents.positions.emplace_hint(contents.positions.end(), std::string(key), MergePositions(positionLists));
+			}
+		});
+	mergeKeys(
+		[](const IndexSegment& segment) { return segment.GetNgramCount(); },
+		[](const IndexSegment& segment, std::size_t i) { return segment.GetNgram(i); },
+		[&contents](std::string_view key, const auto& entries) {
+			std::vector<std::pair<PostingListView, const TombstoneBitmap*>> lists;
+			for (const auto& [source, index] : entries)
+			{
+				lists.emplace_back(source->segment->GetNgramPostings(index), source->deleted.get());
+			}
+			if (auto merged = MergePostings(lists, false); !merged.IsEmpty())
+			{
+				contents.ngrams.emplace_hint(contents.ngrams.end(), std::string(key), std::move(merged));
+			}
+		});
+	return contents;
+}
+
+void InvertedIndex::FlushMemorySegment(bool force)
+{
+	// Сброс, пришедший во время другого, не нужен: новый изменяемый сегмент ещё почти пуст.
+	// Сохранение индекса дожидается текущего сброса и сбрасывает всё, что накопилось после него
+	std::unique_lock flushLock(m_flushMutex, std::defer_lock);
+	if (force)
+	{
+		flushLock.lock();
+	}
+	else if (!flushLock.try_lock())
+	{
+		return;
+	}
+
+	// Писатели исключаются только на время замены изменяемого сегмента свежим
+	std::shared_ptr<MemorySegment> frozen;
+	{
+		std::unique_lock writeLock(m_writeMutex);
+		const auto snapshot = GetSnapshot();
+		const std::size_t docCount = snapshot->memory->docCount.load(std::memory_order_relaxed);
+		// Несколько писателей могли одновременно заполнить сегмент, сбрасывает его первый
+		if (docCount == 0 || (!force && docCount < MemorySegmentDocLimit))
+		{
+			return;
+		}
+
+		std::lock_guard lock(m_publishMutex);
+		auto next = std::make_unique<Snapshot>(*GetSnapshot());
+		frozen = std::exchange(next->memory, std::make_shared<MemorySegment>(m_shardCount, m_epochs));
+		next->frozen = frozen;
+		PublishSnapshot(std::move(next));
+	}
+
+	const auto contents = [&] {
+		const auto guard = m_epochs.Pin();
+		return CollectMemoryContents(*frozen);
+	}();
+	auto segment = contents.docs.empty()
+		? nullptr
+		: IndexSegment::Build(m_ngramSize, contents.docs, contents.terms, contents.positions, contents.ngrams);
+
+	{
+		// Удаления из замороженного сегмента идут под разделяемой блокировкой,
+		// так что под исключительной его состав больше не меняется
+		std::unique_lock writeLock(m_writeMutex);
+		std::lock_guard lock(m_publishMutex);
+		const auto current = GetSnapshot();
+		// Загрузка индекса заменила снимок целиком вместе с замороженным сегментом
+		if (current->frozen != frozen)
+		{
+			return;
+		}
+
+		// Документы, удалённые во время сборки, удаляются и из нового сегмента
+		std::shared_ptr<TombstoneBitmap> deleted;
+		for (const auto& doc : contents.docs)
+		{
+			if (FindMemoryDocument(*frozen, doc.id))
+			{
+				continue;
+			}
+			if (!deleted)
+			{
+				deleted = std::make_shared<TombstoneBitmap>(contents.docs.front().id, contents.docs.back().id);
+			}
+			deleted->Insert(doc.id);
+		}
+
+		auto next = std::make_unique<Snapshot>(*current);
+		next->frozen = nullptr;
+		if (segment && (!deleted || deleted->GetCount() < contents.docs.size()))
+		{
+			next->segments.push_back({ std::move(segment), std::move(deleted) });
+		}
+		PublishSnapshot(std::move(next));
+	}
+	// Прежние снимки заменены под собственным закреплением и освобождаются только теперь
+	m_epochs.Collect();
+	ScheduleMerge();
+}
+
+void InvertedIndex::ScheduleMerge()
+{
+	// Одновременно выполняется не больше одной цепочки слияний, а запросы, пришедшие
+	// во время неё, обслуживает она же
+	if (m_mergeRequests.fetch_add(1) != 0)
+	{
+		return;
+	}
+	if (!m_mergePool)
+	{
+		RunMerges();
+		return;
+	}
+	std::lock_guard lock(m_mergeTaskMutex);
+	m_mergeTask = m_mergePool->Enqueue([this] { RunMerges(); });
+}
+
+void InvertedIndex::RunMerges()
+{
+	std::size_t requests = m_mergeRequests.load();
+	for (;;)
+	{
+		try
+		{
+			MergeSegments();
+		}
+		catch (const std::exception& e)
+		{
+			// Сегменты остаются как были и сольются при следующем запросе
+			std::lock_guard lock(m_mergeErrorMutex);
+			m_mergeError = std::string("Background segment merge failed: ") + e.what();
+		}
+		catch (...)
+		{
+			std::lock_guard lock(m_mergeErrorMutex);
+			m_mergeError = "Background segment merge failed: unknown exception";
+		}
+		// Слияния публикуют снимки под собственным закреплением, заменённые снимки освобождаются после них
+		m_epochs.Collect();
+
+		// Последнее обращение к индексу: после него может начаться новая цепочка,
+		// и деструктор будет ждать уже её задачу
+		const std::size_t remaining = m_mergeRequests.fetch_sub(requests) - requests;
+		if (remaining == 0)
+		{
+			return;
+		}
+		requests = remaining;
+	}
+}
+
+void InvertedIndex::MergeSegments()
+{
+	for (;;)
+	{
+		const auto snapshot = GetSnapshot();
+		const auto window = SelectMergeWindow(snapshot->segments);
+		if (!window)
+		{
+			return;
+		}
+
+		const std::vector<StoredSegment> sources(snapshot->segments.begin() + window->first,
+			snapshot->segments.begin() + window->second);
+		const auto contents = CollectSegmentContents(sources);
+		const auto merged = contents.docs.empty()
+			? nullptr
+			: IndexSegment::Build(m_ngramSize, contents.docs, contents.terms, contents.positions, contents.ngrams);
+
+		std::lock_guard lock(m_publishMutex);
+		const auto current = GetSnapshot();
+		// Окно ищется заново: снимок мог смениться сбросом, удалением или загрузкой индекса
+		const auto first = std::ranges::find_if(current->segments, [&](const StoredSegment& source) {
+			return source.segment == sources.front().segment;
+		});
+		const auto offset = static_cast<std::size_t>(first - current->segments.begin());
+		const bool isWindowIntact = first != current->segments.end()
+			&& current->segments.size() - offset >= sources.size()
+			&& std::equal(sources.begin(), sources.end(), first, [](const StoredSegment& a, const StoredSegment& b) {
+				   return a.segment == b.segment;
+			   });
+		if (!isWindowIntact)
+		{
+			continue;
+		}
+
+		// Документы, удалённые из источников во время слияния, удаляются и из результата
+		StoredSegment replacement{ merged, nullptr };
+		std::shared_ptr<TombstoneBitmap> deleted;
+		for (std::size_t i = 0; merged && i < sources.size(); ++i)
+		{
+			const auto& before = sources[i].deleted;
+			const auto& after = first[i].deleted;
+			if (!after || after == before)
+			{
+				continue;
+			}
+			after->ForEach([&](std::uint64_t docId) {
+				if (before && before->Contains(docId))
+				{
+					return;
+				}
+				if (!deleted)
+				{
+					deleted = std::make_shared<TombstoneBitmap>(merged->GetDocumentId(0),
+						merged->GetDocumentId(merged->GetDocumentCount() - 1));
+				}
+				deleted->Insert(docId);
+			});
+		}
+		replacement.deleted = std::move(deleted);
+
+		auto next = std::make_unique<Snapshot>(*current);
+		const auto windowBegin = next->segments.begin() + static_cast<std::ptrdiff_t>(offset);
+		const auto position = next->segments.erase(windowBegin, windowBegin + static_cast<std::ptrdiff_t>(sources.size()));
+		if (merged)
+		{
+			next->segments.insert(position, std::move(replacement));
+		}
+		PublishSnapshot(std::move(next));
+	}
+}
+
+std::optional<std::string> InvertedIndex::TakeMergeError()
+{
+	std::lock_guard lock(m_mergeErrorMutex);
+	return std::exchange(m_mergeError, std::nullopt);
+}
+
+void InvertedIndex::Save(const std::string& path)
+{
+	// Изменяемый сегмент сбрасывается, и файл собирается слиянием всех неизменяемых
+	FlushMemorySegment(true);
+	const auto snapshot = GetSnapshot();
+	const auto contents = CollectSegmentContents(snapshot->segments);
+	IndexSegment::Write(path, m_ngramSize, contents.docs, contents.terms, contents.positions, contents.ngrams);
+}
+
+std::uint64_t InvertedIndex::Load(const std::string& path)
+{
+	auto segment = IndexSegment::Open(path);
+	if (segment->GetNgramSize() != m_ngramSize)
+	{
+		throw std::runtime_error("Index file uses a different n-gram size: " + path);
+	}
+
+	// Всё, что было в индексе, заменяется содержимым сегмента. Словари не очищаются:
+	// идентификаторы в них остаются действительными, просто их списки пусты
+	const std::size_t docCount = segment->GetDocumentCount();
+	const std::uint64_t maxDocId = docCount == 0 ? 0 : segment->GetDocumentId(docCount - 1);
+	const std::uint64_t totalWords = segment->GetTotalWords();
+
+	auto paths = std::make_shared<PathTable>(m_epochs);
+	for (std::size_t i = 0; i < docCount; ++i)
+	{
+		paths->Add(segment->GetDocumentId(i), segment->GetDocument(i).path);
+	}
+
+	{
+		std::unique_lock writeLock(m_writeMutex);
+		std::lock_guard lock(m_publishMutex);
+		auto next = std::make_unique<Snapshot>();
+		next->memory = std::make_shared<MemorySegment>(m_shardCount, m_epochs);
+		next->paths = std::move(paths);
+		if (docCount != 0)
+		{
+			next->segments.push_back({ std::move(segment), nullptr });
+		}
+		PublishSnapshot(std::move(next));
+		m_totalDocs.store(docCount, std::memory_order_relaxed);
+		m_totalWords.store(totalWords, std::memory_order_relaxed);
+		m_generation.fetch_add(1, std::memory_order_release);
+	}
+	// Прежнее содержимое индекса освобождается сразу, не дожидаясь сбора по числу объектов
+	m_epochs.Collect();
+	return maxDocId;
 }
\ No newline at end of file
@@ -1,42 +1,348 @@
 #pragma once
 
+#include "ChunkedTable.h"
+#include "ConcurrentPostingList.h"
 #include "Document.h"
+#include "EpochReclaimer.h"
+#include "IndexSegment.h"
+#include "PathTable.h"
+#include "PositionList.h"
+#include "PostingList.h"
+#include "TermDictionary.h"
+#include "TombstoneBitmap.h"
+#include "TopResults.h"
 
+#include <atomic>
 #include <cstddef>
+#include <deque>
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <shared_mutex>
+#include <span>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
+class ThreadPool;
+
+enum class RankingModel
+{
+	TfIdf,
+	Bm25,
+};
+
+// Запрос с условием на расположение слов
+struct PositionalQuery
+{
+	enum class Kind
+	{
+		// Слова подряд и в том же порядке
+		Phrase,
+		// Все слова в окне, где первое и последнее отстоят не больше чем на distance слов
+		Near,
+	};
+
+	Kind kind = Kind::Phrase;
+	std::vector<std::string> terms;
+	std::size_t distance = 0;
+};
+
+// Индекс устроен как LSM-дерево: документы добавляются в изменяемый сегмент в памяти,
+// который по достижении MemorySegmentDocLimit документов сбрасывается в неизменяемый
+// IndexSegment. Удаление из неизменяемого сегмента лишь отмечает документ в его
+// TombstoneBitmap. Мелкие сегменты и сегменты с большой долей удалённых документов
+// сливаются в фоне на отдельном пуле слияний. Снимки списка сегментов неизменяемы и публикуются атомарной
+// заменой указателя: читатель закрепляет эпоху в слоте своего потока и не трогает общих
+// счётчиков ссылок и блокировок, а заменённый снимок удаляется, когда его никто не читает.
+// Тяжёлые запросы делятся на части по источникам и диапазонам docId и выполняются на пуле запросов
 class InvertedIndex
 {
 public:
-	explicit InvertedIndex(int ngramSize = 3);
+	static constexpr std::size_t DefaultShardCount = 16;
+	static constexpr std::size_t MemorySegmentDocLimit = 1000;
+
+	// Без пула запросы выполняются в вызывающем потоке, без пула слияний слияния выполняются
+	// в потоке, сбросившем сегмент. Слияние занимает поток пула слияний надолго, поэтому
+	// этот пул не должен быть пулом, потоки которого добавляют документы и ждут друг друга
+	explicit InvertedIndex(int ngramSize = 3, std::size_t shardCount = DefaultShardCount, ThreadPool* pool = nullptr,
+		ThreadPool* mergePool = nullptr);
+	~InvertedIndex();
+
+	InvertedIndex(const InvertedIndex&) = delete;
+	InvertedIndex& operator=(const InvertedIndex&) = delete;
 
-	void AddDocument(std::uint64_t docId, const std::string& path, const std::string& content);
+	// Текст документа токенизируется на месте: после вызова буфер переведён в нижний регистр
+	void AddDocument(std::uint64_t docId, const std::string& path, std::span<char> content, const FileVersion& version);
 	void RemoveDocument(const std::string& path);
 	void RemoveDocumentsInDir(const std::string& dirPath, bool recursive = false);
 	std::vector<std::pair<std::uint64_t, double>> Search(const std::vector<std::string>& queryTerms) const;
+	// Документы, где выполняется условие запроса, ранжированные так же, как в Search
+	std::vector<std::pair<std::uint64_t, double>> SearchPositional(const PositionalQuery& query) const;
 	std::vector<std::uint64_t> SearchSubstring(const std::string& substring) const;
 	std::string GetPathById(std::uint64_t id) const;
+	// Таблица путей текущего снимка: по ней результаты поиска разрешаются в пути без блокировок индекса.
+	// Закрепляет снимок за потоком, поэтому должна разрушаться в том же потоке
+	EpochReclaimer::Pinned<const PathTable> GetPathTable() const;
 	bool HasDocument(const std::string& path) const;
+	std::optional<FileVersion> GetDocumentVersion(const std::string& path) const;
+	// termFrequencies, positions и wordOffsets не заполняются
 	std::vector<Document> GetIndexedDocuments() const;
+	std::optional<DocumentPositions> GetDocumentPositions(std::uint64_t docId, const std::vector<std::string>& terms) const;
+	// Растёт после каждого изменения набора документов, когда изменение уже видно поиску:
+	// результат, полученный после чтения поколения, верен, пока оно не сменилось
+	std::uint64_t GetGeneration() const;
+
+	void SetRankingModel(RankingModel model);
+	RankingModel GetRankingModel() const;
+	// Поднимает в выдаче Search документы, где термы запроса стоят близко друг к другу
+	void SetProximityRanking(bool enabled);
+	bool IsProximityRanking() const;
+
+	// Сохраняет все документы индекса в файл сегмента
+	void Save(const std::string& path);
+	// Заменяет содержимое индекса сегментом из файла. Возвращает наибольший docId сегмента,
+	// новые документы должны получать идентификаторы больше него
+	std::uint64_t Load(const std::string& path);
+
+	// Ошибка фонового слияния, если оно не удалось после прошлого вызова. Неслитые сегменты
+	// остаются в индексе и сливаются при следующем сбросе
+	std::optional<std::string> TakeMergeError();
 
 private:
-	double ComputeRelevance(
-		std::uint64_t docId,
-		const std::vector<std::string>& queryTerms,
-		std::size_t totalDocs) const;
-	std::vector<std::uint64_t> IntersectNgramResults(const std::vector<std::string>& ngrams) const;
-	void RemoveDocumentInternal(std::uint64_t docId);
+	// Термы и n-граммы хранятся в словарях, а постинги адресуются их плотными идентификаторами:
+	// шард выбирается остатком от деления идентификатора, место в шарде — частным.
+	// Данные документов шардируются по docId. Писатель блокирует только те шарды,
+	// которые затрагивает документ. Читатели блокировок не берут: списки дописываются на месте
+	// и публикуют своё состояние сами, а документы и корзины путей неизменяемы, и писатель
+	// публикует изменённую копию. Вытесненное освобождается через EpochReclaimer.
+	// Пустой список из таблицы удаляется
+	struct PostingShard
+	{
+		explicit PostingShard(EpochReclaimer& reclaimer);
+
+		// Упорядочивает писателей шарда
+		std::mutex mutex;
+		ChunkedTable<ConcurrentTermPostings> terms;
+		ChunkedTable<ConcurrentPostingList> ngrams;
+	};
+
+	struct DocumentShard
+	{
+		explicit DocumentShard(EpochReclaimer& reclaimer);
+
+		std::mutex mutex;
+		// По docId / m_shardCount
+		ChunkedTable<Document> documents;
+	};
+
+	// Пути документов с одинаковым остатком хеша
+	using PathBucket = std::vector<std::pair<std::string, std::uint64_t>>;
+
+	// Изменяемый сегмент. При сбросе он замораживается: документы в него больше не добавляют,
+	// но удаляют, пока из него собирается неизменяемый сегмент. Читатели старого снимка
+	// дочитывают его как есть
+	struct MemorySegment
+	{
+		MemorySegment(std::size_t shardCount, EpochReclaimer& reclaimer);
+
+		std::deque<PostingShard> postingShards;
+		std::deque<DocumentShard> documentShards;
+		std::mutex pathMutex;
+		ChunkedTable<PathBucket> paths;
+		std::atomic<std::size_t> docCount = 0;
+	};
+
+	// Объекты изменяемого сегмента, вытесненные одним изменением.
+	// Передаются в EpochReclaimer вместе, одним объектом
+	struct RetiredObjects
+	{
+		std::vector<std::unique_ptr<const ConcurrentTermPostings>> terms;
+		std::vector<std::unique_ptr<const ConcurrentPostingList>> ngrams;
+		std::vector<std::unique_ptr<const ConcurrentPostingList::Storage>> storages;
+		std::vector<std::unique_ptr<const Document>> documents;
+		std::vector<std::unique_ptr<const PathBucket>> paths;
+	};
+
+	struct StoredSegment
+	{
+		std::shared_ptr<const IndexSegment> segment;
+		// nullptr — удалённых документов нет
+		std::shared_ptr<const TombstoneBitmap> deleted;
+
+		bool IsDeleted(std::uint64_t docId) const;
+		std::size_t GetLiveCount() const;
+	};
+
+	// Снимок индекса. Сегменты упорядочены от старых к новым, путь живого документа
+	// встречается не больше чем в одном источнике. Таблица путей общая для всех источников
+	// и заменяется только при загрузке индекса
+	struct Snapshot
+	{
+		std::shared_ptr<MemorySegment> memory;
+		// Замороженный изменяемый сегмент, который сейчас сбрасывается; nullptr — сброса нет.
+		// Его документы новее неизменяемых сегментов и старше изменяемого
+		std::shared_ptr<MemorySegment> frozen;
+		std::vector<StoredSegment> segments;
+		std::shared_ptr<PathTable> paths;
+	};
+
+	using SnapshotRef = EpochReclaimer::Pinned<const Snapshot>;
+
+	// Ключи документа, разложенные по шардам постингов
+	struct ShardedKeys
+	{
+		std::vector<std::vector<const std::pair<TermId, std::uint32_t>*>> terms;
+		std::vector<std::vector<TermId>> ngrams;
+	};
+
+	// Содержимое будущего неизменяемого сегмента
+	struct SegmentContents
+	{
+		std::vector<Document> docs;
+		std::map<std::string, PostingList> terms;
+		std::map<std::string, PositionList> positions;
+		std::map<std::string, PostingList> ngrams;
+	};
+
+	std::size_t GetPostingShardIndex(TermId id) const;
+	std::size_t GetPostingSlot(TermId id) const;
+	ShardedKeys GroupKeysByShard(const Document& doc);
+	const DocumentShard& GetDocumentShard(const MemorySegment& memory, std::uint64_t docId) const;
+	DocumentShard& GetDocumentShard(MemorySegment& memory, std::uint64_t docId);
+	std::size_t GetDocumentSlot(std::uint64_t docId) const;
+	const Document* FindMemoryDocument(const MemorySegment& memory, std::uint64_t docId) const;
+	// Документ из изменяемого или замороженного сегмента снимка
+	const Document* FindMemoryDocument(const Snapshot& snapshot, std::uint64_t docId) const;
+	static std::optional<std::uint64_t> FindMemoryPath(const MemorySegment& memory, const std::string& path);
+	// Связывает путь с docId, а при пустом docId удаляет его. Возвращает прежний docId пути
+	static std::optional<std::uint64_t> UpdateMemoryPath(MemorySegment& memory, const std::string& path,
+		std::optional<std::uint64_t> docId, RetiredObjects& retired);
+	void RetireObjects(RetiredObjects retired);
+
+	// Терм запроса с его постингами из одного источника;
+	// повторы терма в запросе учитываются кратностью
+	struct QueryTerm
+	{
+		std::size_t queryIndex = 0;
+		std::size_t multiplicity = 0;
+		// TermId в изменяемом сегменте, номер терма в неизменяемом
+		std::size_t keyIndex = 0;
+		TermPostingsView postings;
+		double weight = 0.0;
+		double upperBound = 0.0;
+	};
+
+	// Вклад одного вхождения терма без учёта idf для выбранной модели
+	struct TermScorer
+	{
+		RankingModel model;
+		double averageDocumentLength;
+
+		double operator()(std::uint32_t frequency, std::uint32_t documentLength) const;
+	};
+
+	// Термы запроса, собранные из каждого источника снимка, с весами по суммарному df
+	struct PreparedQuery
+	{
+		SnapshotRef snapshot;
+		std::vector<std::pair<std::string, std::size_t>> uniqueTerms;
+		TermScorer scorer;
+		std::vector<QueryTerm> memoryTerms;
+		// Пусто, если в снимке нет замороженного сегмента
+		std::vector<QueryTerm> frozenTerms;
+		// По набору на каждый неизменяемый сегмент снимка
+		std::vector<std::vector<QueryTerm>> segmentTerms;
+	};
+
+	// Часть запроса: термы одного источника и диапазон docId [firstDocId, endDocId)
+	struct QueryPart
+	{
+		const std::vector<QueryTerm>* terms = nullptr;
+		const StoredSegment* source = nullptr;
+		std::uint64_t firstDocId = 0;
+		std::uint64_t endDocId = std::numeric_limits<std::uint64_t>::max();
+	};
+
+	// Постинги n-грамм подстроки в одном источнике; пусто, если какой-то n-граммы в нём нет
+	struct NgramQuery
+	{
+		std::vector<PostingListView> postings;
+		const StoredSegment* source = nullptr;
+	};
+
+	SnapshotRef GetSnapshot() const;
+	// Вызывается под m_publishMutex
+	void PublishSnapshot(std::unique_ptr<const Snapshot> next);
+	std::optional<PreparedQuery> PrepareQuery(const std::vector<std::string>& queryTerms) const;
+	std::vector<QueryTerm> CollectMemoryTerms(const MemorySegment& memory,
+		const std::vector<std::pair<std::string, std::size_t>>& queryTerms) const;
+	static std::vector<QueryTerm> CollectSegmentTerms(const IndexSegment& segment,
+		const std::vector<std::pair<std::string, std::size_t>>& queryTerms);
+	// Делит запрос на части для пула; пустой результат — запрос лёгкий и выполняется целиком
+	std::vector<QueryPart> SplitQuery(const PreparedQuery& query) const;
+	// Термы части должны быть упорядочены по возрастанию upperBound
+	static void SearchMaxScore(const QueryPart& part, const TermScorer& scorer, TopResults& top);
+	// wordTerms — номер уникального терма для каждого слова запроса
+	void SearchPositions(const PositionalQuery& query, const std::vector<std::size_t>& wordTerms,
+		const PreparedQuery& prepared, const std::vector<QueryTerm>& terms, TopResults& top,
+		const StoredSegment* source) const;
+	std::optional<DocumentPositions> FindDocumentPositions(const Snapshot& snapshot, std::uint64_t docId,
+		const std::vector<std::string>& terms) const;
+	void ApplyProximityBoost(const PreparedQuery& prepared, std::vector<std::pair<std::uint64_t, double>>& results) const;
+	bool IsParallelQuery(std::size_t estimatedCandidates) const;
+	NgramQuery CollectMemoryNgrams(const MemorySegment& memory, const std::vector<std::string>& ngrams) const;
+	static NgramQuery CollectSegmentNgrams(const StoredSegment& source, const std::vector<std::string>& ngrams);
+	static std::vector<std::uint64_t> IntersectNgrams(const NgramQuery& query, std::size_t limit);
+
+	void InsertPostings(MemorySegment& memory, std::uint64_t docId, const Document& doc, RetiredObjects& retired);
+	void ErasePostings(MemorySegment& memory, std::uint64_t docId, const Document& doc, RetiredObjects& retired);
+	void RemoveMemoryDocument(MemorySegment& memory, PathTable& paths, std::uint64_t docId, RetiredObjects& retired);
+	// Возвращает false, если документа с таким путём в замороженном сегменте нет
+	bool RemoveFrozenDocument(const Snapshot& snapshot, const std::string& path, RetiredObjects& retired);
+	void RemoveDocuments(const std::vector<std::string>& paths);
+	void DeleteFromSegments(const std::vector<std::string>& paths);
+
+	// Из сегмента могут удалять документы во время сбора: постинги берутся только для документов,
+	// попавших в docs, а документы, удалённые после этого, отмечаются при публикации
+	SegmentContents CollectMemoryContents(const MemorySegment& memory) const;
+	static SegmentContents CollectSegmentContents(const std::vector<StoredSegment>& sources);
+	void FlushMemorySegment(bool force);
+	// Ставит цепочку слияний в m_mergePool, а без него выполняет её сразу
+	void ScheduleMerge();
+	// Выполняет слияния, пока есть запросы. Ошибки не выбрасывает, а сохраняет в m_mergeError
+	void RunMerges();
+	void MergeSegments();
 
 	const int m_ngramSize;
-	mutable std::shared_mutex m_mutex;
-	std::unordered_map<std::uint64_t, Document> m_documents;
-	std::unordered_map<std::string, std::uint64_t> m_pathToId;
-	std::unordered_map<std::string, std::unordered_set<std::uint64_t>> m_termToDocs;
-	std::unordered_map<std::string, std::unordered_set<std::uint64_t>> m_ngramToDocs;
-	// зачем?
-	std::size_t m_totalDocs = 0;
+	const std::size_t m_shardCount;
+	ThreadPool* m_pool;
+	ThreadPool* m_mergePool;
+	TermDictionary m_terms;
+	TermDictionary m_ngrams;
+
+	// Писатели изменяемого сегмента держат её разделяемой. Сброс берёт её исключительной
+	// лишь на время заморозки сегмента и публикации собранного
+	std::shared_mutex m_writeMutex;
+	// Сбросы выполняются по одному, так что замороженный сегмент в снимке не больше чем один
+	std::mutex m_flushMutex;
+	// Упорядочивает публикацию новых снимков
+	std::mutex m_publishMutex;
+	mutable EpochReclaimer m_epochs;
+	std::atomic<const Snapshot*> m_snapshot = nullptr;
+
+	// Запросы слияния, ещё не обслуженные цепочкой слияний; 0 — цепочка не выполняется
+	std::atomic<std::size_t> m_mergeRequests = 0;
+	std::mutex m_mergeTaskMutex;
+	std::future<void> m_mergeTask;
+	std::mutex m_mergeErrorMutex;
+	std::optional<std::string> m_mergeError;
+
+	std::atomic<std::size_t> m_totalDocs = 0;
+	std::atomic<std::uint64_t> m_totalWords = 0;
+	std::atomic<RankingModel> m_rankingModel = RankingModel::TfIdf;
+	std::atomic<bool> m_proximityRanking = false;
+	std::atomic<std::uint64_t> m_generation = 0;
 };
\ No newline at end of file
@@ -0,0 +1,144 @@
+#include "PathTable.h"
+
+#include <mutex>
+#include <ranges>
+
+PathTable::PathTable(EpochReclaimer& reclaimer)
+	: m_reclaimer(reclaimer)
+	, m_entries(reclaimer)
+{
+}
+
+void PathTable::Add(std::uint64_t docId, std::string_view path)
+{
+	std::unique_lock lock(m_mutex);
+	// Прежняя запись того же docId снимается раньше, чем путь займёт новая
+	if (const FileEntry* previous = m_entries.Exchange(docId, nullptr))
+	{
+		Unlink(docId, previous);
+	}
+
+	Directory* directory = &m_root;
+	std::size_t begin = 0;
+	for (std::size_t slash = path.find('/'); slash != std::string_view::npos; slash = path.find('/', begin))
+	{
+		std::string component(path.substr(begin, slash - begin));
+		auto& child = directory->children[component];
+		if (!child)
+		{
+			child = std::make_unique<Directory>();
+			child->parent = directory;
+			child->name = std::move(component);
+		}
+		directory = child.get();
+		begin = slash + 1;
+	}
+
+	// Запись публикуется после того, как полностью заполнена
+	auto entry = std::make_unique<FileEntry>();
+	entry->directory = directory;
+	entry->name = path.substr(begin);
+	directory->files[entry->name] = docId;
+	m_entries.Exchange(docId, entry.release());
+}
+
+void PathTable::Remove(std::uint64_t docId)
+{
+	std::unique_lock lock(m_mutex);
+	if (const FileEntry* entry = m_entries.Exchange(docId, nullptr))
+	{
+		Unlink(docId, entry);
+	}
+}
+
+std::string PathTable::GetPath(std::uint64_t docId) const
+{
+	const FileEntry* entry = m_entries.Load(docId);
+	if (!entry)
+	{
+		return "";
+	}
+	std::string path;
+	AppendDirectoryPath(*entry->directory, path);
+	path += entry->name;
+	return path;
+}
+
+std::vector<std::string> PathTable::GetPathsInDirectory(std::string_view dirPath, bool recursive) const
+{
+	// Завершающие '/' не образуют отдельного каталога, а "/" — это каталог с пустым именем
+	while (!dirPath.empty() && dirPath.back() == '/')
+	{
+		dirPath.remove_suffix(1);
+	}
+
+	std::shared_lock lock(m_mutex);
+	const Directory* directory = &m_root;
+	for (std::size_t begin = 0;;)
+	{
+		const std::size_t slash = dirPath.find('/', begin);
+		const auto it = directory->children.find(std::string(dirPath.substr(begin, slash - begin)));
+		if (it == directory->children.end())
+		{
+			return {};
+		}
+		directory = it->second.get();
+		if (slash == std::string_view::npos)
+		{
+			break;
+		}
+		begin = slash + 1;
+	}
+
+	std::vector<std::string> paths;
+	CollectPaths(*directory, std::string(dirPath) + '/', recursive, paths);
+	return paths;
+}
+
+void PathTable::Unlink(std::uint64_t docId, const FileEntry* entry)
+{
+	// Под тем же именем мог появиться документ с другим docId
+	Directory* directory = entry->directory;
+	if (const auto it = directory->files.find(entry->name); it != directory->files.end() && it->second == docId)
+	{
+		directory->files.erase(it);
+	}
+	m_reclaimer.Retire(entry);
+
+	// Опустевшие каталоги снимаются с дерева снизу вверх. Читатель, успевший взять запись,
+	// ещё проходит по их родителям, поэтому они освобождаются через EpochReclaimer
+	while (directory->parent && directory->files.empty() && directory->children.empty())
+	{
+		Directory* parent = directory->parent;
+		auto node = parent->children.extract(directory->name);
+		m_reclaimer.Retire(static_cast<const Directory*>(node.mapped().release()));
+		directory = parent;
+	}
+}
+
+void PathTable::AppendDirectoryPath(const Directory& directory, std::string& path)
+{
+	if (!directory.parent)
+	{
+		return;
+	}
+	AppendDirectoryPath(*directory.parent, path);
+	path += directory.name;
+	path += '/';
+}
+
+void PathTable::CollectPaths(const Directory& directory, const std::string& prefix, bool recursive,
+	std::vector<std::string>& paths)
+{
+	for (const auto& name : directory.files | std::views::keys)
+	{
+		paths.push_back(prefix + name);
+	}
+	if (recursive)
+	{
+		for (const auto& [name, child] : directory.children)
+		{
+			CollectPaths(*child, prefix + name + '/', recursive, paths);
+		}
+	}
+}
\ No newline at end of file
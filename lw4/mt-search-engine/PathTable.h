@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ChunkedTable.h"
+#include "EpochReclaimer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Пути документов индекса. Каталоги образуют префиксное дерево по компонентам пути,
+// документ хранит только свой каталог и имя, так что общие префиксы хранятся один раз.
+// Записи документов неизменяемы и лежат в ChunkedTable по docId, поэтому путь по docId
+// разрешается без блокировок, если читатель держит закрепление эпохи. Изменения дерева
+// каталогов упорядочены собственной блокировкой, удаление каталога — обход его поддерева,
+// а не всех путей. Удалённые записи и опустевшие каталоги освобождаются через EpochReclaimer
+class PathTable
+{
+public:
+	static constexpr std::size_t ChunkSize = 4096;
+
+	explicit PathTable(EpochReclaimer& reclaimer);
+
+	PathTable(const PathTable&) = delete;
+	PathTable& operator=(const PathTable&) = delete;
+
+	void Add(std::uint64_t docId, std::string_view path);
+	void Remove(std::uint64_t docId);
+	// Пустая строка, если документа нет или он удалён
+	std::string GetPath(std::uint64_t docId) const;
+	// Пути документов каталога, а при recursive — и всех его подкаталогов
+	std::vector<std::string> GetPathsInDirectory(std::string_view dirPath, bool recursive) const;
+
+private:
+	struct Directory
+	{
+		// Имя и родитель не меняются и читаются без блокировки, словари — только под m_mutex
+		Directory* parent = nullptr;
+		std::string name;
+		std::unordered_map<std::string, std::unique_ptr<Directory>> children;
+		std::unordered_map<std::string, std::uint64_t> files;
+	};
+
+	struct FileEntry
+	{
+		Directory* directory = nullptr;
+		std::string name;
+	};
+
+	// Вызывается под m_mutex для записи, снятой с таблицы
+	void Unlink(std::uint64_t docId, const FileEntry* entry);
+	static void AppendDirectoryPath(const Directory& directory, std::string& path);
+	static void CollectPaths(const Directory& directory, const std::string& prefix, bool recursive,
+		std::vector<std::string>& paths);
+
+	EpochReclaimer& m_reclaimer;
+	mutable std::shared_mutex m_mutex;
+	// Корень без имени; путь, начинающийся с '/', идёт через его потомка с пустым именем
+	Directory m_root;
+	ChunkedTable<FileEntry, ChunkSize> m_entries;
+};
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "PositionList.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+constexpr std::size_t SkipEntrySize = 2 * sizeof(std::uint64_t);
+
+// Varint, не выходящий за end: оборванный или длиннее 64 бит означает испорченный список
+std::uint64_t ReadVarint(const std::uint8_t*& pos, const std::uint8_t* end)
+{
+	std::uint64_t value = 0;
+	for (int shift = 0; pos < end && shift < 64; shift += 7)
+	{
+		const std::uint8_t byte = *pos++;
+		value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			return value;
+		}
+	}
+	throw std::runtime_error("Corrupted position list");
+}
+
+void AppendVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<std::uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<std::uint8_t>(value));
+}
+
+std::size_t GetVarintSize(std::uint64_t value)
+{
+	std::size_t size = 1;
+	for (; value >= 0x80; value >>= 7)
+	{
+		++size;
+	}
+	return size;
+}
+
+std::uint64_t LoadUint64(const std::uint8_t* data)
+{
+	std::uint64_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+} // namespace
+
+PositionList::Cursor::Cursor(std::span<const std::uint8_t> data)
+{
+	// Пустой вид — пустой список
+	if (data.empty())
+	{
+		return;
+	}
+	if (data.size() < sizeof(std::uint64_t))
+	{
+		throw std::runtime_error("Corrupted position list");
+	}
+	const std::uint64_t blockCount = LoadUint64(data.data());
+	if (blockCount > (data.size() - sizeof(std::uint64_t)) / SkipEntrySize)
+	{
+		throw std::runtime_error("Corrupted position list");
+	}
+	m_blockCount = static_cast<std::size_t>(blockCount);
+	m_skips = data.data() + sizeof(std::uint64_t);
+	m_records = m_skips + m_blockCount * SkipEntrySize;
+	m_recordsSize = data.size() - sizeof(std::uint64_t) - m_blockCount * SkipEntrySize;
+	LoadBlock(0);
+}
+
+void PositionList::Cursor::GetPositions(std::vector<std::uint32_t>& out) const
+{
+	out.clear();
+	std::uint32_t position = 0;
+	for (const std::uint8_t* pos = m_positions; pos < m_positionsEnd;)
+	{
+		position += static_cast<std::uint32_t>(ReadVarint(pos, m_positionsEnd));
+		out.push_back(position);
+	}
+}
+
+void PositionList::Cursor::Next()
+{
+	if (m_next >= m_blockEnd)
+	{
+		LoadBlock(m_block + 1);
+		return;
+	}
+	ReadRecord(m_docId);
+}
+
+void PositionList::Cursor::SkipTo(std::uint64_t target)
+{
+	if (IsEnd() || m_docId >= target)
+	{
+		return;
+	}
+
+	// Последний блок, начинающийся не позже target: блоки левее него не распаковываются
+	std::size_t low = m_block + 1;
+	std::size_t high = m_blockCount;
+	while (low < high)
+	{
+		const std::size_t middle = low + (high - low) / 2;
+		if (GetBlockFirstDocId(middle) <= target)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	if (low - 1 > m_block)
+	{
+		LoadBlock(low - 1);
+	}
+	while (!IsEnd() && m_docId < target)
+	{
+		Next();
+	}
+}
+
+std::uint64_t PositionList::Cursor::GetBlockFirstDocId(std::size_t block) const
+{
+	return LoadUint64(m_skips + block * SkipEntrySize);
+}
+
+std::uint64_t PositionList::Cursor::GetBlockOffset(std::size_t block) const
+{
+	return LoadUint64(m_skips + block * SkipEntrySize + sizeof(std::uint64_t));
+}
+
+void PositionList::Cursor::LoadBlock(std::size_t block)
+{
+	m_block = block;
+	if (IsEnd())
+	{
+		return;
+	}
+	const std::uint64_t begin = GetBlockOffset(block);
+	const std::uint64_t end = block + 1 < m_blockCount ? GetBlockOffset(block + 1) : m_recordsSize;
+	if (begin >= end || end > m_recordsSize)
+	{
+		throw std::runtime_error("Corrupted position list");
+	}
+	m_next = m_records + begin;
+	m_blockEnd = m_records + end;
+	ReadRecord(GetBlockFirstDocId(block));
+}
+
+void PositionList::Cursor::ReadRecord(std::uint64_t previousDocId)
+{
+	m_docId = previousDocId + ReadVarint(m_next, m_blockEnd);
+	const std::uint64_t size = ReadVarint(m_next, m_blockEnd);
+	if (size > static_cast<std::uint64_t>(m_blockEnd - m_next))
+	{
+		throw std::runtime_error("Corrupted position list");
+	}
+	m_positions = m_next;
+	m_positionsEnd = m_next + size;
+	m_next = m_positionsEnd;
+}
+
+void PositionList::Add(std::uint64_t docId, std::span<const std::uint32_t> positions)
+{
+	// Первая запись блока хранит разность с его первым docId, то есть ноль
+	if (m_size % BlockSize == 0)
+	{
+		m_skips.push_back({ docId, m_bytes.size() });
+		m_lastDocId = docId;
+	}
+	AppendVarint(m_bytes, docId - m_lastDocId);
+
+	std::size_t size = 0;
+	for (std::uint32_t previous = 0; const std::uint32_t position : positions)
+	{
+		size += GetVarintSize(position - previous);
+		previous = position;
+	}
+	AppendVarint(m_bytes, size);
+	for (std::uint32_t previous = 0; const std::uint32_t position : positions)
+	{
+		AppendVarint(m_bytes, position - previous);
+		previous = position;
+	}
+
+	m_lastDocId = docId;
+	++m_size;
+}
+
+void PositionList::AppendTo(std::vector<std::uint8_t>& out) const
+{
+	const auto append = [&out](const void* data, std::size_t size) {
+		const auto* bytes = static_cast<const std::uint8_t*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	};
+	const std::uint64_t blockCount = m_skips.size();
+	append(&blockCount, sizeof(blockCount));
+	append(m_skips.data(), m_skips.size() * sizeof(SkipEntry));
+	append(m_bytes.data(), m_bytes.size());
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Позиции терма в документах, упорядоченных по docId. Запись документа — разность docId,
+// длина позиций в байтах и сами позиции разностями, всё в varint, так что документ
+// пропускается без распаковки его позиций. Таблица пропусков через каждые BlockSize документов
+// позволяет перешагивать целые блоки. Курсор читает сериализованный вид на месте:
+// позиции сегмента, отображённого в память, не копируются и не читаются с диска,
+// пока их не запросят фразовый запрос или извлечение фрагмента
+class PositionList
+{
+public:
+	static constexpr std::size_t BlockSize = 128;
+
+	class Cursor
+	{
+	public:
+		// data — сериализованный вид из AppendTo
+		explicit Cursor(std::span<const std::uint8_t> data);
+
+		bool IsEnd() const
+		{
+			return m_block >= m_blockCount;
+		}
+		std::uint64_t GetDocId() const
+		{
+			return m_docId;
+		}
+		// Позиции текущего документа по возрастанию
+		void GetPositions(std::vector<std::uint32_t>& out) const;
+
+		void Next();
+		// Переходит к первому docId, не меньшему target
+		void SkipTo(std::uint64_t target);
+
+	private:
+		std::uint64_t GetBlockFirstDocId(std::size_t block) const;
+		std::uint64_t GetBlockOffset(std::size_t block) const;
+		void LoadBlock(std::size_t block);
+		void ReadRecord(std::uint64_t previousDocId);
+
+		const std::uint8_t* m_skips = nullptr;
+		const std::uint8_t* m_records = nullptr;
+		std::size_t m_recordsSize = 0;
+		std::size_t m_blockCount = 0;
+		std::size_t m_block = 0;
+		const std::uint8_t* m_blockEnd = nullptr;
+		const std::uint8_t* m_next = nullptr;
+		const std::uint8_t* m_positions = nullptr;
+		const std::uint8_t* m_positionsEnd = nullptr;
+		std::uint64_t m_docId = 0;
+	};
+
+	// docId должны возрастать
+	void Add(std::uint64_t docId, std::span<const std::uint32_t> positions);
+
+	std::size_t GetSize() const
+	{
+		return m_size;
+	}
+	bool IsEmpty() const
+	{
+		return m_size == 0;
+	}
+
+	void AppendTo(std::vector<std::uint8_t>& out) const;
+
+private:
+	struct SkipEntry
+	{
+		std::uint64_t firstDocId;
+		std::uint64_t offset;
+	};
+
+	std::vector<SkipEntry> m_skips;
+	std::vector<std::uint8_t> m_bytes;
+	std::size_t m_size = 0;
+	std::uint64_t m_lastDocId = 0;
+};
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "PositionMatch.h"
+
+#include <algorithm>
+#include <limits>
+
+bool PositionMatch::ContainsPhrase(const std::vector<std::span<const std::uint32_t>>& positions)
+{
+	if (positions.empty())
+	{
+		return false;
+	}
+
+	// Начала фразы перебираются по самому короткому списку, остальные проверяются двоичным поиском
+	const auto rarest = static_cast<std::size_t>(std::ranges::min_element(positions, {}, &std::span<const std::uint32_t>::size) - positions.begin());
+	for (const std::uint32_t position : positions[rarest])
+	{
+		if (position < rarest)
+		{
+			continue;
+		}
+		const std::uint32_t start = position - static_cast<std::uint32_t>(rarest);
+		bool matches = true;
+		for (std::size_t i = 0; i < positions.size() && matches; ++i)
+		{
+			matches = i == rarest || std::ranges::binary_search(positions[i], start + static_cast<std::uint32_t>(i));
+		}
+		if (matches)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+std::optional<PositionMatch::Window> PositionMatch::FindShortestWindow(const std::vector<std::span<const std::uint32_t>>& positions)
+{
+	if (positions.empty() || std::ranges::any_of(positions, &std::span<const std::uint32_t>::empty))
+	{
+		return std::nullopt;
+	}
+
+	// Окно задают текущие позиции списков; сдвигается список с наименьшей, пока он не кончится
+	std::vector<std::size_t> cursors(positions.size());
+	std::optional<Window> best;
+	for (;;)
+	{
+		std::size_t lowest = 0;
+		std::uint32_t highest = 0;
+		for (std::size_t i = 0; i < positions.size(); ++i)
+		{
+			if (positions[i][cursors[i]] < positions[lowest][cursors[lowest]])
+			{
+				lowest = i;
+			}
+			highest = std::max(highest, positions[i][cursors[i]]);
+		}
+		const std::uint32_t first = positions[lowest][cursors[lowest]];
+		if (!best || highest - first < best->second - best->first)
+		{
+			best = Window{ first, highest };
+		}
+		if (++cursors[lowest] == positions[lowest].size())
+		{
+			return best;
+		}
+	}
+}
+
+std::optional<PositionMatch::Window> PositionMatch::FindDensestWindow(const std::vector<std::span<const std::uint32_t>>& positions, std::size_t maxWords)
+{
+	std::vector<std::pair<std::uint32_t, std::size_t>> events;
+	for (std::size_t i = 0; i < positions.size(); ++i)
+	{
+		for (const std::uint32_t position : positions[i])
+		{
+			events.emplace_back(position, i);
+		}
+	}
+	if (events.empty() || maxWords == 0)
+	{
+		return std::nullopt;
+	}
+	std::ranges::sort(events);
+
+	std::vector<std::size_t> counts(positions.size());
+	std::size_t distinct = 0;
+	std::size_t bestDistinct = 0;
+	Window best{ events.front().first, events.front().first };
+	for (std::size_t first = 0, last = 0; last < events.size(); ++last)
+	{
+		distinct += counts[events[last].second]++ == 0 ? 1 : 0;
+		while (events[last].first - events[first].first >= maxWords)
+		{
+			distinct -= --counts[events[first].second] == 0 ? 1 : 0;
+			++first;
+		}
+		const std::uint32_t span = events[last].first - events[first].first;
+		if (distinct > bestDistinct || (distinct == bestDistinct && span < best.second - best.first))
+		{
+			bestDistinct = distinct;
+			best = { events[first].first, events[last].first };
+		}
+	}
+	return best;
+}
\ No newline at end of file
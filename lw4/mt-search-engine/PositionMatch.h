@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Проверки взаимного расположения слов по отсортированным спискам позиций
+namespace PositionMatch
+{
+using Window = std::pair<std::uint32_t, std::uint32_t>;
+
+// Есть ли p, при котором positions[i] содержит p + i для каждого i
+bool ContainsPhrase(const std::vector<std::span<const std::uint32_t>>& positions);
+
+// Кратчайшее окно [first, last], содержащее позицию из каждого списка; nullopt, если какой-то список пуст
+std::optional<Window> FindShortestWindow(const std::vector<std::span<const std::uint32_t>>& positions);
+
+// Окно не длиннее maxWords слов, содержащее позиции наибольшего числа разных списков,
+// из равных — кратчайшее; nullopt, если все списки пусты
+std::optional<Window> FindDensestWindow(const std::vector<std::span<const std::uint32_t>>& positions, std::size_t maxWords);
+} // namespace PositionMatch
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include "PostingIntersection.h"
+
+#include <algorithm>
+#include <array>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POSTING_INTERSECTION_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+// Во сколько раз список должен быть длиннее текущего результата, чтобы выгоднее было искать галопом
+constexpr std::size_t GallopRatio = 16;
+
+using IntersectFn = std::size_t (*)(const std::uint64_t*, std::size_t, const std::uint64_t*, std::size_t, std::uint64_t*);
+
+std::size_t IntersectScalar(
+	const std::uint64_t* a, std::size_t aSize,
+	const std::uint64_t* b, std::size_t bSize,
+	std::uint64_t* out)
+{
+	std::size_t i = 0;
+	std::size_t j = 0;
+	std::size_t count = 0;
+	while (i < aSize && j < bSize)
+	{
+		if (a[i] < b[j])
+		{
+			++i;
+		}
+		else if (b[j] < a[i])
+		{
+			++j;
+		}
+		else
+		{
+			out[count++] = a[i];
+			++i;
+			++j;
+		}
+	}
+	return count;
+}
+
+#ifdef POSTING_INTERSECTION_X86
+// Блоки сравниваются «все со всеми» через перестановки второго блока.
+// Сдвигается блок с меньшим максимумом (или оба при равенстве), остаток добирается скалярно
+__attribute__((target("sse4.1"))) std::size_t IntersectSse41(
+	const std::uint64_t* a, std::size_t aSize,
+	const std::uint64_t* b, std::size_t bSize,
+	std::uint64_t* out)
+{
+	std::size_t i = 0;
+	std::size_t j = 0;
+	std::size_t count = 0;
+	while (i + 2 <= aSize && j + 2 <= bSize)
+	{
+		const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+		const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+		const __m128i vbSwapped = _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2));
+		const __m128i eq = _mm_or_si128(_mm_cmpeq_epi64(va, vb), _mm_cmpeq_epi64(va, vbSwapped));
+		const int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+		if (mask & 1)
+		{
+			out[count++] = a[i];
+		}
+		if (mask & 2)
+		{
+			out[count++] = a[i + 1];
+		}
+
+		const std::uint64_t aMax = a[i + 1];
+		const std::uint64_t bMax = b[j + 1];
+		i += aMax <= bMax ? 2 : 0;
+		j += bMax <= aMax ? 2 : 0;
+	}
+	return count + IntersectScalar(a + i, aSize - i, b + j, bSize - j, out + count);
+}
+
+__attribute__((target("avx2"))) std::size_t IntersectAvx2(
+	const std::uint64_t* a, std::size_t aSize,
+	const std::uint64_t* b, std::size_t bSize,
+	std::uint64_t* out)
+{
+	std::size_t i = 0;
+	std::size_t j = 0;
+	std::size_t count = 0;
+	while (i + 4 <= aSize && j + 4 <= bSize)
+	{
+		const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+		const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+		const __m256i eq = _mm256_or_si256(
+			_mm256_or_si256(
+				_mm256_cmpeq_epi64(va, vb),
+				_mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+			_mm256_or_si256(
+				_mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+				_mm256_cmpeq_epi64(va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+		for (int mask = _mm256_movemask_pd(_mm256_castsi256_pd(eq)); mask != 0; mask &= mask - 1)
+		{
+			out[count++] = a[i + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)))];
+		}
+
+		const std::uint64_t aMax = a[i + 3];
+		const std::uint64_t bMax = b[j + 3];
+		i += aMax <= bMax ? 4 : 0;
+		j += bMax <= aMax ? 4 : 0;
+	}
+	return count + IntersectSse41(a + i, aSize - i, b + j, bSize - j, out + count);
+}
+#endif
+
+IntersectFn SelectIntersectImpl()
+{
+#ifdef POSTING_INTERSECTION_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return IntersectAvx2;
+	}
+	if (__builtin_cpu_supports("sse4.1"))
+	{
+		return IntersectSse41;
+	}
+#endif
+	return IntersectScalar;
+}
+
+std::vector<std::uint64_t> GallopFilter(
+	const std::vector<std::uint64_t>& candidates, const PostingListView& list, std::size_t limit)
+{
+	std::vector<std::uint64_t> result;
+	auto cursor = list.GetCursor();
+	for (const std::uint64_t docId : candidates)
+	{
+		cursor.SkipTo(docId);
+		if (cursor.IsEnd())
+		{
+			break;
+		}
+		if (cursor.GetDocId() == docId)
+		{
+			result.push_back(docId);
+			if (result.size() == limit)
+			{
+				break;
+			}
+		}
+	}
+	return result;
+}
+
+std::vector<std::uint64_t> BlockIntersect(
+	const std::vector<std::uint64_t>& candidates, const PostingListView& list, std::size_t limit)
+{
+	std::vector<std::uint64_t> result(std::min(candidates.size(), list.GetSize()));
+	std::array<std::uint64_t, PostingListView::BlockSize> block{};
+	std::size_t count = 0;
+	std::size_t pos = 0;
+	for (std::size_t b = 0; b < list.GetBlockCount() && pos < candidates.size() && count < limit; ++b)
+	{
+		// Блок, лежащий целиком левее очередного кандидата, даже не распаковывается
+		if (list.GetBlockLastDocId(b) < candidates[pos])
+		{
+			continue;
+		}
+		const std::size_t blockSize = list.DecodeBlock(b, block.data());
+		const auto end = std::upper_bound(candidates.begin() + static_cast<std::ptrdiff_t>(pos), candidates.end(), block[blockSize - 1]);
+		const auto endPos = static_cast<std::size_t>(end - candidates.begin());
+		count += PostingIntersection::IntersectSorted(
+			candidates.data() + pos, endPos - pos, block.data(), blockSize, result.data() + count);
+		pos = endPos;
+	}
+	result.resize(std::min(count, limit));
+	return result;
+}
+
+} // namespace
+
+std::size_t PostingIntersection::IntersectSorted(
+	const std::uint64_t* a, std::size_t aSize,
+	const std::uint64_t* b, std::size_t bSize,
+	std::uint64_t* out)
+{
+	static const IntersectFn impl = SelectIntersectImpl();
+	return impl(a, aSize, b, bSize, out);
+}
+
+std::vector<std::uint64_t> PostingIntersection::Intersect(std::vector<PostingListView> lists, std::size_t limit)
+{
+	if (lists.empty() || limit == 0)
+	{
+		return {};
+	}
+
+	std::sort(lists.begin(), lists.end(), [](const PostingListView& a, const PostingListView& b) {
+		return a.GetSize() < b.GetSize();
+	});
+	if (lists.front().IsEmpty())
+	{
+		return {};
+	}
+
+	auto result = lists.front().Decode();
+	for (std::size_t i = 1; i < lists.size() && !result.empty(); ++i)
+	{
+		// Ограничение действует только на последнем шаге: раньше любой кандидат ещё может отсеяться
+		const std::size_t stepLimit = i + 1 == lists.size() ? limit : std::numeric_limits<std::size_t>::max();
+		result = lists[i].GetSize() / result.size() >= GallopRatio
+			? GallopFilter(result, lists[i], stepLimit)
+			: BlockIntersect(result, lists[i], stepLimit);
+	}
+
+	if (result.size() > limit)
+	{
+		result.resize(limit);
+	}
+	return result;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "PostingList.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace PostingIntersection
+{
+// Пересекает списки, начиная с самого редкого. К спискам, намного длиннее текущего
+// результата, применяется галопирующий поиск по таблице пропусков, к сопоставимым —
+// поблочное пересечение (SSE4.1/AVX2, если процессор умеет). Возвращает не больше limit
+// наименьших общих docId
+std::vector<std::uint64_t> Intersect(
+	std::vector<PostingListView> lists,
+	std::size_t limit = std::numeric_limits<std::size_t>::max());
+
+// Пересечение двух отсортированных массивов без повторов; out вмещает min(aSize, bSize)
+std::size_t IntersectSorted(
+	const std::uint64_t* a, std::size_t aSize,
+	const std::uint64_t* b, std::size_t bSize,
+	std::uint64_t* out);
+} // namespace PostingIntersection
\ No newline at end of file
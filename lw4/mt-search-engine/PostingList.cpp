@@ -0,0 +1,413 @@
+#include "PostingList.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+std::uint64_t ReadVarint(const std::uint8_t*& pos)
+{
+	std::uint64_t value = 0;
+	int shift = 0;
+	while (*pos & 0x80)
+	{
+		value |= static_cast<std::uint64_t>(*pos++ & 0x7F) << shift;
+		shift += 7;
+	}
+	value |= static_cast<std::uint64_t>(*pos++) << shift;
+	return value;
+}
+
+// Varint, не выходящий за end; false, если он оборван или длиннее 64 бит
+bool ReadVarint(const std::uint8_t*& pos, const std::uint8_t* end, std::uint64_t& value)
+{
+	value = 0;
+	for (int shift = 0; pos < end && shift < 64; shift += 7)
+	{
+		const std::uint8_t byte = *pos++;
+		value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Первый элемент, для которого isBefore ложно: шаг удваивается, затем двоичный поиск в найденном окне
+template <typename It, typename Pred>
+It GallopTo(It first, It last, Pred isBefore)
+{
+	std::ptrdiff_t step = 1;
+	while (step < last - first && isBefore(first[step - 1]))
+	{
+		first += step;
+		step *= 2;
+	}
+	return std::partition_point(first, std::min(first + step, last), isBefore);
+}
+} // namespace
+
+PostingListView::Cursor::Cursor(const PostingListView& list)
+	: m_list(list)
+{
+	LoadBlock(0);
+}
+
+void PostingListView::Cursor::Next()
+{
+	if (++m_position == m_count)
+	{
+		LoadBlock(m_block + 1);
+	}
+}
+
+void PostingListView::Cursor::SkipTo(std::uint64_t target)
+{
+	if (IsEnd() || GetDocId() >= target)
+	{
+		return;
+	}
+
+	if (m_list.GetSkip(m_block).lastDocId < target)
+	{
+		// Блоки, целиком лежащие левее target, пропускаются по таблице без распаковки
+		LoadBlock(m_list.FindBlock(m_block + 1, target));
+		if (IsEnd())
+		{
+			return;
+		}
+	}
+
+	const auto begin = m_docIds.begin() + static_cast<std::ptrdiff_t>(m_position);
+	const auto end = m_docIds.begin() + static_cast<std::ptrdiff_t>(m_count);
+	m_position = static_cast<std::size_t>(GallopTo(begin, end, [target](std::uint64_t docId) { return docId < target; }) - m_docIds.begin());
+}
+
+void PostingListView::Cursor::LoadBlock(std::size_t block)
+{
+	m_block = block;
+	m_position = 0;
+	m_count = IsEnd() ? 0 : m_list.DecodeBlock(block, m_docIds.data(), m_payloads.data());
+}
+
+PostingListView::PostingListView(std::span<const SkipEntry> skips, std::span<const std::uint8_t> bytes,
+	std::size_t size, bool withPayload)
+	: m_bytes(bytes)
+	, m_size(size)
+	, m_withPayload(withPayload)
+{
+	if (!skips.empty())
+	{
+		m_skips = skips.first(skips.size() - 1);
+		m_lastSkip = skips.back();
+		m_blockCount = skips.size();
+	}
+}
+
+PostingListView::PostingListView(std::span<const SkipEntry> skips, const SkipEntry& lastSkip,
+	std::span<const std::uint8_t> bytes, std::size_t size, bool withPayload)
+	: m_skips(skips)
+	, m_lastSkip(lastSkip)
+	, m_blockCount(skips.size() + 1)
+	, m_bytes(bytes)
+	, m_size(size)
+	, m_withPayload(withPayload)
+{
+}
+
+PostingListView PostingListView::ReadFrom(const std::uint8_t* data, std::size_t size, bool withPayload)
+{
+	std::uint64_t header[3];
+	if (size < sizeof(header) || reinterpret_cast<std::uintptr_t>(data) % alignof(SkipEntry) != 0)
+	{
+		throw std::runtime_error("Corrupted posting list");
+	}
+	std::memcpy(header, data, sizeof(header));
+	const auto [count, blockCount, byteCount] = header;
+	if (blockCount > (size - sizeof(header)) / sizeof(SkipEntry)
+		|| byteCount != size - sizeof(header) - blockCount * sizeof(SkipEntry))
+	{
+		throw std::runtime_error("Corrupted posting list");
+	}
+
+	const auto* skips = reinterpret_cast<const SkipEntry*>(data + sizeof(header));
+	const auto* bytes = data + sizeof(header) + blockCount * sizeof(SkipEntry);
+	return PostingListView({ skips, blockCount }, { bytes, byteCount }, count, withPayload);
+}
+
+bool PostingListView::Contains(std::uint64_t docId) const
+{
+	auto cursor = GetCursor();
+	cursor.SkipTo(docId);
+	return !cursor.IsEnd() && cursor.GetDocId() == docId;
+}
+
+std::vector<std::uint64_t> PostingListView::Decode() const
+{
+	std::vector<std::uint64_t> docIds(m_size);
+	std::size_t written = 0;
+	for (std::size_t block = 0; block < m_blockCount; ++block)
+	{
+		written += DecodeBlock(block, docIds.data() + written);
+	}
+	return docIds;
+}
+
+bool PostingListView::IsValid() const
+{
+	std::size_t total = 0;
+	for (std::size_t block = 0; block < m_blockCount; ++block)
+	{
+		// Блоки упорядочены и лежат в байтах подряд, каждый непуст и не длиннее BlockSize
+		const auto& entry = GetSkip(block);
+		const std::size_t end = block + 1 < m_blockCount ? GetSkip(block + 1).offset : m_bytes.size();
+		if (entry.count == 0 || entry.count > BlockSize || entry.offset > end || end > m_bytes.size()
+			|| entry.firstDocId > entry.lastDocId || (block > 0 && entry.firstDocId <= GetSkip(block - 1).lastDocId))
+		{
+			return false;
+		}
+
+		// Разности положительны и приводят ровно к lastDocId, varint заканчиваются на границе блока
+		const std::uint8_t* pos = m_bytes.data() + entry.offset;
+		const std::uint8_t* blockEnd = m_bytes.data() + end;
+		std::uint64_t docId = entry.firstDocId;
+		std::uint64_t value = 0;
+		for (std::uint32_t i = 0; i < entry.count; ++i)
+		{
+			if (i > 0)
+			{
+				if (!ReadVarint(pos, blockEnd, value) || value == 0 || value > entry.lastDocId - docId)
+				{
+					return false;
+				}
+				docId += value;
+			}
+			for (int field = 0; m_withPayload && field < 2; ++field)
+			{
+				if (!ReadVarint(pos, blockEnd, value) || value > std::numeric_limits<std::uint32_t>::max())
+				{
+					return false;
+				}
+			}
+		}
+		if (docId != entry.lastDocId || pos != blockEnd)
+		{
+			return false;
+		}
+		total += entry.count;
+	}
+	return total == m_size;
+}
+
+std::size_t PostingListView::DecodeBlock(std::size_t block, std::uint64_t* docIds, Payload* payloads) const
+{
+	const auto& entry = GetSkip(block);
+	const std::uint8_t* pos = m_bytes.data() + entry.offset;
+	std::uint64_t docId = entry.firstDocId;
+	for (std::uint32_t i = 0; i < entry.count; ++i)
+	{
+		if (i > 0)
+		{
+			docId += ReadVarint(pos);
+		}
+		docIds[i] = docId;
+		if (m_withPayload)
+		{
+			const auto frequency = static_cast<std::uint32_t>(ReadVarint(pos));
+			const auto documentLength = static_cast<std::uint32_t>(ReadVarint(pos));
+			if (payloads)
+			{
+				payloads[i] = { frequency, documentLength };
+			}
+		}
+	}
+	return entry.count;
+}
+
+std::size_t PostingListView::FindBlock(std::size_t first, std::uint64_t target) const
+{
+	// Поиск галопом: при близкой цели он дешевле двоичного по всему хвосту таблицы
+	if (first < m_skips.size())
+	{
+		const auto it = GallopTo(m_skips.begin() + static_cast<std::ptrdiff_t>(first), m_skips.end(),
+			[target](const SkipEntry& entry) { return entry.lastDocId < target; });
+		if (it != m_skips.end())
+		{
+			return static_cast<std::size_t>(it - m_skips.begin());
+		}
+	}
+	return m_lastSkip.lastDocId < target ? m_blockCount : m_blockCount - 1;
+}
+
+PostingList::PostingList(const PostingListView& view)
+	: m_withPayload(view.m_withPayload)
+	, m_skips(view.m_skips.begin(), view.m_skips.end())
+	, m_bytes(view.m_bytes.begin(), view.m_bytes.end())
+	, m_size(view.m_size)
+{
+	if (view.m_blockCount > 0)
+	{
+		m_skips.push_back(view.m_lastSkip);
+	}
+}
+
+void PostingList::Add(std::uint64_t docId, Payload payload)
+{
+	if (m_skips.empty() || docId > m_skips.back().lastDocId)
+	{
+		// Идентификаторы выдаются по возрастанию, поэтому обычно хватает дописать хвост
+		if (m_skips.empty() || m_skips.back().count == BlockSize)
+		{
+			m_skips.push_back({ docId, docId, static_cast<std::uint32_t>(m_bytes.size()), 1 });
+		}
+		else
+		{
+			auto& last = m_skips.back();
+			AppendVarint(m_bytes, docId - last.lastDocId);
+			last.lastDocId = docId;
+			++last.count;
+		}
+		AppendPayload(m_bytes, payload);
+		++m_size;
+		return;
+	}
+
+	const std::size_t block = FindBlock(docId);
+	std::vector<std::uint64_t> docIds(m_skips[block].count);
+	std::vector<Payload> payloads(m_skips[block].count);
+	GetView().DecodeBlock(block, docIds.data(), payloads.data());
+	const auto it = std::lower_bound(docIds.begin(), docIds.end(), docId);
+	if (it != docIds.end() && *it == docId)
+	{
+		return;
+	}
+	payloads.insert(payloads.begin() + (it - docIds.begin()), payload);
+	docIds.insert(it, docId);
+	RewriteBlock(block, docIds, payloads);
+	++m_size;
+}
+
+bool PostingList::Remove(std::uint64_t docId)
+{
+	if (m_skips.empty())
+	{
+		return false;
+	}
+
+	const std::size_t block = FindBlock(docId);
+	std::vector<std::uint64_t> docIds(m_skips[block].count);
+	std::vector<Payload> payloads(m_skips[block].count);
+	GetView().DecodeBlock(block, docIds.data(), payloads.data());
+	const auto it = std::lower_bound(docIds.begin(), docIds.end(), docId);
+	if (it == docIds.end() || *it != docId)
+	{
+		return false;
+	}
+	payloads.erase(payloads.begin() + (it - docIds.begin()));
+	docIds.erase(it);
+	RewriteBlock(block, docIds, payloads);
+	--m_size;
+	return true;
+}
+
+std::size_t PostingList::GetMemoryUsage() const
+{
+	return m_bytes.capacity() + m_skips.capacity() * sizeof(SkipEntry);
+}
+
+void PostingList::AppendVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back(static_cast<std::uint8_t>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<std::uint8_t>(value));
+}
+
+void PostingList::AppendPayload(std::vector<std::uint8_t>& out, const Payload& payload) const
+{
+	if (m_withPayload)
+	{
+		AppendVarint(out, payload.frequency);
+		AppendVarint(out, payload.documentLength);
+	}
+}
+
+void PostingList::AppendTo(std::vector<std::uint8_t>& out) const
+{
+	const std::uint64_t header[] = { m_size, m_skips.size(), m_bytes.size() };
+	const auto append = [&out](const void* data, std::size_t size) {
+		const auto* bytes = static_cast<const std::uint8_t*>(data);
+		out.insert(out.end(), bytes, bytes + size);
+	};
+	append(header, sizeof(header));
+	append(m_skips.data(), m_skips.size() * sizeof(SkipEntry));
+	append(m_bytes.data(), m_bytes.size());
+}
+
+std::size_t PostingList::FindBlock(std::uint64_t docId) const
+{
+	// Последний блок, начинающийся не правее docId; левее первого блока — сам первый блок
+	const auto it = std::upper_bound(m_skips.begin(), m_skips.end(), docId,
+		[](std::uint64_t value, const SkipEntry& entry) { return value < entry.firstDocId; });
+	return it == m_skips.begin() ? 0 : static_cast<std::size_t>(it - m_skips.begin()) - 1;
+}
+
+std::size_t PostingList::GetBlockEnd(std::size_t block) const
+{
+	return block + 1 < m_skips.size() ? m_skips[block + 1].offset : m_bytes.size();
+}
+
+void PostingList::RewriteBlock(std::size_t block, const std::vector<std::uint64_t>& docIds, const std::vector<Payload>& payloads)
+{
+	// Переполненный блок делится пополам, опустевший удаляется
+	std::vector<SkipEntry> entries;
+	std::vector<std::uint8_t> bytes;
+	const std::size_t parts = (docIds.size() + BlockSize - 1) / BlockSize;
+	for (std::size_t part = 0; part < parts; ++part)
+	{
+		const std::size_t begin = docIds.size() * part / parts;
+		const std::size_t end = docIds.size() * (part + 1) / parts;
+		entries.push_back({ docIds[begin], docIds[end - 1], static_cast<std::uint32_t>(bytes.size()),
+			static_cast<std::uint32_t>(end - begin) });
+		for (std::size_t i = begin; i < end; ++i)
+		{
+			if (i > begin)
+			{
+				AppendVarint(bytes, docIds[i] - docIds[i - 1]);
+			}
+			AppendPayload(bytes, payloads[i]);
+		}
+	}
+
+	const std::uint32_t offset = m_skips[block].offset;
+	const std::size_t oldLength = GetBlockEnd(block) - offset;
+	for (auto& entry : entries)
+	{
+		entry.offset += offset;
+	}
+
+	const auto bytesPos = m_bytes.begin() + offset;
+	if (bytes.size() <= oldLength)
+	{
+		std::copy(bytes.begin(), bytes.end(), bytesPos);
+		m_bytes.erase(bytesPos + static_cast<std::ptrdiff_t>(bytes.size()), bytesPos + static_cast<std::ptrdiff_t>(oldLength));
+	}
+	else
+	{
+		std::copy(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(oldLength), bytesPos);
+		m_bytes.insert(bytesPos + static_cast<std::ptrdiff_t>(oldLength), bytes.begin() + static_cast<std::ptrdiff_t>(oldLength), bytes.end());
+	}
+
+	const auto delta = static_cast<std::int64_t>(bytes.size()) - static_cast<std::int64_t>(oldLength);
+	for (std::size_t i = block + 1; i < m_skips.size(); ++i)
+	{
+		m_skips[i].offset = static_cast<std::uint32_t>(m_skips[i].offset + delta);
+	}
+
+	const auto skipPos = m_skips.erase(m_skips.begin() + static_cast<std::ptrdiff_t>(block));
+	m_skips.insert(skipPos, entries.begin(), entries.end());
+}
\ No newline at end of file
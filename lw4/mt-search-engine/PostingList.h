@@ -0,0 +1,205 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+// Отсортированный список docId, сжатый блоками: в блоке до BlockSize идентификаторов,
+// первый хранится в таблице пропусков, остальные — разностями в varint.
+// Таблица пропусков позволяет перешагивать целые блоки, не распаковывая их.
+// Список термов дополнительно хранит рядом с каждым docId частоту терма и длину документа.
+// Вид только читает таблицу и байты блоков на месте: из отображённого в память сегмента
+// или из списка в памяти, который должен его пережить. Запись последнего блока вид хранит
+// у себя: у дописываемого списка она меняется, и читатель берёт её копию
+class PostingListView
+{
+public:
+	static constexpr std::size_t BlockSize = 128;
+
+	struct Payload
+	{
+		std::uint32_t frequency = 0;
+		std::uint32_t documentLength = 0;
+	};
+
+	struct SkipEntry
+	{
+		std::uint64_t firstDocId;
+		std::uint64_t lastDocId;
+		std::uint32_t offset;
+		std::uint32_t count;
+	};
+
+	class Cursor;
+
+	PostingListView() = default;
+	PostingListView(std::span<const SkipEntry> skips, std::span<const std::uint8_t> bytes, std::size_t size, bool withPayload);
+	// Таблица без записи последнего блока и сама эта запись
+	PostingListView(std::span<const SkipEntry> skips, const SkipEntry& lastSkip, std::span<const std::uint8_t> bytes,
+		std::size_t size, bool withPayload);
+
+	// Вид на результат PostingList::AppendTo. data выровнены по SkipEntry и должны пережить вид
+	static PostingListView ReadFrom(const std::uint8_t* data, std::size_t size, bool withPayload);
+
+	// Проверяет таблицу пропусков и все блоки: после неё курсор и DecodeBlock
+	// не выходят за границы байтов, чтение которых обходится без проверок
+	bool IsValid() const;
+
+	bool Contains(std::uint64_t docId) const;
+	std::size_t GetSize() const
+	{
+		return m_size;
+	}
+	bool IsEmpty() const
+	{
+		return m_size == 0;
+	}
+
+	std::vector<std::uint64_t> Decode() const;
+	Cursor GetCursor() const;
+
+	std::size_t GetBlockCount() const
+	{
+		return m_blockCount;
+	}
+	std::uint64_t GetBlockFirstDocId(std::size_t block) const
+	{
+		return GetSkip(block).firstDocId;
+	}
+	std::uint64_t GetBlockLastDocId(std::size_t block) const
+	{
+		return GetSkip(block).lastDocId;
+	}
+	// Распаковывает блок в docIds (и payloads, если передан), каждый не меньше BlockSize элементов.
+	// Возвращает число docId
+	std::size_t DecodeBlock(std::size_t block, std::uint64_t* docIds, Payload* payloads = nullptr) const;
+
+private:
+	friend class PostingList;
+	friend class ConcurrentPostingList;
+
+	const SkipEntry& GetSkip(std::size_t block) const
+	{
+		return block < m_skips.size() ? m_skips[block] : m_lastSkip;
+	}
+	// Первый блок не левее first, где есть docId не меньше target; GetBlockCount(), если такого нет
+	std::size_t FindBlock(std::size_t first, std::uint64_t target) const;
+
+	// Все блоки, кроме последнего
+	std::span<const SkipEntry> m_skips;
+	SkipEntry m_lastSkip{};
+	std::size_t m_blockCount = 0;
+	std::span<const std::uint8_t> m_bytes;
+	std::size_t m_size = 0;
+	bool m_withPayload = false;
+};
+
+class PostingListView::Cursor
+{
+public:
+	explicit Cursor(const PostingListView& list);
+
+	bool IsEnd() const
+	{
+		return m_block >= m_list.m_blockCount;
+	}
+	std::uint64_t GetDocId() const
+	{
+		return m_docIds[m_position];
+	}
+	const Payload& GetPayload() const
+	{
+		return m_payloads[m_position];
+	}
+
+	void Next();
+	// Переходит к первому docId, не меньшему target
+	void SkipTo(std::uint64_t target);
+
+private:
+	void LoadBlock(std::size_t block);
+
+	PostingListView m_list;
+	std::size_t m_block = 0;
+	std::size_t m_position = 0;
+	std::size_t m_count = 0;
+	std::array<std::uint64_t, BlockSize> m_docIds{};
+	std::array<Payload, BlockSize> m_payloads{};
+};
+
+inline PostingListView::Cursor PostingListView::GetCursor() const
+{
+	return Cursor(*this);
+}
+
+// Изменяемый список в памяти; читается через GetView
+class PostingList
+{
+public:
+	static constexpr std::size_t BlockSize = PostingListView::BlockSize;
+	using Payload = PostingListView::Payload;
+	using Cursor = PostingListView::Cursor;
+
+	explicit PostingList(bool withPayload = false)
+		: m_withPayload(withPayload)
+	{
+	}
+	// Копия списка, на который смотрит view
+	explicit PostingList(const PostingListView& view);
+
+	void Add(std::uint64_t docId)
+	{
+		Add(docId, Payload{});
+	}
+	void Add(std::uint64_t docId, Payload payload);
+	bool Remove(std::uint64_t docId);
+
+	std::size_t GetSize() const
+	{
+		return m_size;
+	}
+	bool IsEmpty() const
+	{
+		return m_size == 0;
+	}
+	std::size_t GetMemoryUsage() const;
+
+	// Вид действителен до следующего изменения списка
+	PostingListView GetView() const
+	{
+		return PostingListView(m_skips, m_bytes, m_size, m_withPayload);
+	}
+
+	// Сериализованный вид: заголовок с размерами, таблица пропусков и байты блоков как есть.
+	// Читать его на месте можно, только если начало выровнено по alignof(std::uint64_t)
+	void AppendTo(std::vector<std::uint8_t>& out) const;
+
+private:
+	using SkipEntry = PostingListView::SkipEntry;
+
+	static void AppendVarint(std::vector<std::uint8_t>& out, std::uint64_t value);
+	void AppendPayload(std::vector<std::uint8_t>& out, const Payload& payload) const;
+	std::size_t FindBlock(std::uint64_t docId) const;
+	void RewriteBlock(std::size_t block, const std::vector<std::uint64_t>& docIds, const std::vector<Payload>& payloads);
+	std::size_t GetBlockEnd(std::size_t block) const;
+
+	bool m_withPayload;
+	std::vector<SkipEntry> m_skips;
+	std::vector<std::uint8_t> m_bytes;
+	std::size_t m_size = 0;
+};
+
+// Постинги терма несут частоту и длину документа, так что ранжирование обходится без поиска
+// по документам; df — это длина списка. Экстремумы частот ограничивают вклад терма сверху
+// для отсечения MaxScore. При удалении документов они не пересчитываются и остаются верной,
+// хоть и менее точной, границей
+struct TermPostingsView
+{
+	PostingListView docs;
+	double maxNormalizedTf = 0.0;
+	std::uint32_t maxFrequency = 0;
+	std::uint32_t minDocumentLength = std::numeric_limits<std::uint32_t>::max();
+};
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "QueryCache.h"
+
+#include <algorithm>
+#include <functional>
+
+QueryCache::QueryCache(std::size_t capacity)
+	: m_shardCapacity(std::max<std::size_t>(1, (capacity + ShardCount - 1) / ShardCount))
+	, m_shards(std::make_unique<Shard[]>(ShardCount))
+{
+}
+
+std::optional<QueryCache::Results> QueryCache::Find(const std::string& key, std::uint64_t generation)
+{
+	auto& shard = GetShard(key);
+	std::lock_guard lock(shard.mutex);
+	const auto it = shard.index.find(key);
+	if (it == shard.index.end())
+	{
+		m_misses.fetch_add(1, std::memory_order_relaxed);
+		return std::nullopt;
+	}
+	if (it->second->generation != generation)
+	{
+		shard.entries.erase(it->second);
+		shard.index.erase(it);
+		m_misses.fetch_add(1, std::memory_order_relaxed);
+		m_stale.fetch_add(1, std::memory_order_relaxed);
+		return std::nullopt;
+	}
+	shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+	m_hits.fetch_add(1, std::memory_order_relaxed);
+	return it->second->results;
+}
+
+void QueryCache::Insert(const std::string& key, std::uint64_t generation, Results results)
+{
+	auto& shard = GetShard(key);
+	std::lock_guard lock(shard.mutex);
+	if (const auto it = shard.index.find(key); it != shard.index.end())
+	{
+		// Параллельный запрос мог успеть записать результат более нового поколения
+		if (it->second->generation > generation)
+		{
+			return;
+		}
+		it->second->generation = generation;
+		it->second->results = std::move(results);
+		shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+		return;
+	}
+
+	shard.entries.push_front(Entry{ key, generation, std::move(results) });
+	try
+	{
+		shard.index.emplace(key, shard.entries.begin());
+	}
+	catch (...)
+	{
+		shard.entries.pop_front();
+		throw;
+	}
+	if (shard.entries.size() > m_shardCapacity)
+	{
+		shard.index.erase(shard.entries.back().key);
+		shard.entries.pop_back();
+	}
+}
+
+void QueryCache::RecordLatency(bool hit, Clock::time_point start)
+{
+	const auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start);
+	(hit ? m_hitNanoseconds : m_missNanoseconds).fetch_add(duration.count(), std::memory_order_relaxed);
+}
+
+QueryCache::Stats QueryCache::GetStats() const
+{
+	Stats stats;
+	stats.capacity = m_shardCapacity * ShardCount;
+	for (std::size_t i = 0; i < ShardCount; ++i)
+	{
+		std::lock_guard lock(m_shards[i].mutex);
+		stats.entries += m_shards[i].entries.size();
+	}
+	stats.hits = m_hits.load(std::memory_order_relaxed);
+	stats.misses = m_misses.load(std::memory_order_relaxed);
+	stats.stale = m_stale.load(std::memory_order_relaxed);
+	stats.hitSeconds = static_cast<double>(m_hitNanoseconds.load(std::memory_order_relaxed)) / 1e9;
+	stats.missSeconds = static_cast<double>(m_missNanoseconds.load(std::memory_order_relaxed)) / 1e9;
+	return stats;
+}
+
+QueryCache::Shard& QueryCache::GetShard(const std::string& key)
+{
+	return m_shards[std::hash<std::string>{}(key) % ShardCount];
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Кэш результатов запросов с вытеснением давно не использованных записей (LRU).
+// Записи разложены по шардам с отдельными блокировками. Каждая запись помнит поколение индекса,
+// при котором посчитана: запись другого поколения считается устаревшей и удаляется при обращении
+class QueryCache
+{
+public:
+	using Results = std::vector<std::pair<std::uint64_t, double>>;
+	using Clock = std::chrono::steady_clock;
+
+	static constexpr std::size_t DefaultCapacity = 4096;
+	static constexpr std::size_t ShardCount = 16;
+
+	struct Stats
+	{
+		std::size_t entries = 0;
+		std::size_t capacity = 0;
+		std::size_t hits = 0;
+		std::size_t misses = 0;
+		// Промахи из-за записи прежнего поколения
+		std::size_t stale = 0;
+		// Суммарное время запросов, обслуженных из кэша и мимо него
+		double hitSeconds = 0.0;
+		double missSeconds = 0.0;
+	};
+
+	explicit QueryCache(std::size_t capacity = DefaultCapacity);
+
+	QueryCache(const QueryCache&) = delete;
+	QueryCache& operator=(const QueryCache&) = delete;
+
+	std::optional<Results> Find(const std::string& key, std::uint64_t generation);
+	void Insert(const std::string& key, std::uint64_t generation, Results results);
+	// Учитывает время запроса с момента start в статистике попаданий или промахов
+	void RecordLatency(bool hit, Clock::time_point start);
+	Stats GetStats() const;
+
+private:
+	struct Entry
+	{
+		std::string key;
+		std::uint64_t generation = 0;
+		Results results;
+	};
+
+	// Начало списка — последняя использованная запись
+	struct Shard
+	{
+		mutable std::mutex mutex;
+		std::list<Entry> entries;
+		std::unordered_map<std::string, std::list<Entry>::iterator> index;
+	};
+
+	Shard& GetShard(const std::string& key);
+
+	std::size_t m_shardCapacity;
+	std::unique_ptr<Shard[]> m_shards;
+
+	std::atomic<std::size_t> m_hits = 0;
+	std::atomic<std::size_t> m_misses = 0;
+	std::atomic<std::size_t> m_stale = 0;
+	std::atomic<std::int64_t> m_hitNanoseconds = 0;
+	std::atomic<std::int64_t> m_missNanoseconds = 0;
+};
\ No newline at end of file
@@ -1,28 +1,68 @@
 #include "SearchEngine.h"
+#include "SnippetExtractor.h"
 #include "Tokenizer.h"
 
+#include <algorithm>
+#include <charconv>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <future>
 #include <iomanip>
 #include <iostream>
-#include <optional>
 #include <sstream>
 #include <vector>
 
 namespace
 {
-std::optional<std::string> ReadFile(const std::filesystem::path& p)
+constexpr std::string_view NearOperator = "NEAR/";
+
+// Запрос целиком в кавычках — фраза, термы через NEAR/k — поиск по близости,
+// остальное — обычный запрос (nullopt)
+std::optional<PositionalQuery> ParsePositionalQuery(const std::string& query)
 {
-	std::ifstream file(p, std::ios::binary);
-	if (!file)
+	if (query.size() >= 2 && query.front() == '"' && query.back() == '"')
+	{
+		PositionalQuery phrase;
+		phrase.kind = PositionalQuery::Kind::Phrase;
+		phrase.terms = Tokenizer::ExtractWords(query.substr(1, query.size() - 2));
+		return phrase;
+	}
+
+	std::istringstream tokens(query);
+	std::optional<std::size_t> distance;
+	std::string text;
+	for (std::string token; tokens >> token;)
+	{
+		if (!token.starts_with(NearOperator))
+		{
+			text += token;
+			text += ' ';
+			continue;
+		}
+		std::size_t value = 0;
+		const char* begin = token.data() + NearOperator.size();
+		const char* end = token.data() + token.size();
+		if (const auto [ptr, ec] = std::from_chars(begin, end, value); ec != std::errc() || ptr != end || begin == end)
+		{
+			throw std::runtime_error("invalid NEAR distance: " + token);
+		}
+		if (distance && *distance != value)
+		{
+			throw std::runtime_error("mixed NEAR distances are not supported");
+		}
+		distance = value;
+	}
+	if (!distance)
 	{
 		return std::nullopt;
 	}
-	std::ostringstream ss;
-	ss << file.rdbuf();
-	return ss.str();
+
+	PositionalQuery near;
+	near.kind = PositionalQuery::Kind::Near;
+	near.terms = Tokenizer::ExtractWords(text);
+	near.distance = *distance;
+	return near;
 }
 } // namespace
 
@@ -30,18 +70,29 @@ SearchEngine::SearchEngine(std::istream& input, std::ostream& output, size_t thr
 	: m_input(input)
 	, m_output(output)
 	, m_threadPool(std::make_unique<ThreadPool>(threadCount ? threadCount : 16))
-	, m_index(3)
+	, m_mergePool(std::make_unique<ThreadPool>(1))
+	, m_index(3, InvertedIndex::DefaultShardCount, m_threadPool.get(), m_mergePool.get())
+	, m_ingestPipeline(*m_threadPool, m_fileLoader)
 {
 	m_actionMap.emplace("add_file", [this](std::istringstream& args) { AddFile(args); });
 	m_actionMap.emplace("add_dir", [this](std::istringstream& args) { AddDirectory(args, false); });
 	m_actionMap.emplace("add_dir_recursive", [this](std::istringstream& args) { AddDirectory(args, true); });
-	m_actionMap.emplace("find", [this](std::istringstream& args) { Find(args); });
+	m_actionMap.emplace("find", [this](std::istringstream& args) { Find(args, false); });
+	m_actionMap.emplace("find_snippets", [this](std::istringstream& args) { Find(args, true); });
 	m_actionMap.emplace("find_substring", [this](std::istringstream& args) { FindSubstring(args); });
 	m_actionMap.emplace("find_batch", [this](std::istringstream& args) { FindBatch(args); });
 	m_actionMap.emplace("remove_file", [this](std::istringstream& args) { RemoveFile(args); });
 	m_actionMap.emplace("remove_dir", [this](std::istringstream& args) { RemoveDirectory(args, false); });
 	m_actionMap.emplace("remove_dir_recursive", [this](std::istringstream& args) { RemoveDirectory(args, true); });
 	m_actionMap.emplace("print_indexed_documents", [this](std::istringstream& _) { PrintIndexedDocuments(); });
+	m_actionMap.emplace("set_ranking", [this](std::istringstream& args) { SetRanking(args); });
+	m_actionMap.emplace("set_proximity", [this](std::istringstream& args) { SetProximity(args); });
+	m_actionMap.emplace("save_index", [this](std::istringstream& args) { SaveIndex(args); });
+	m_actionMap.emplace("load_index", [this](std::istringstream& args) { LoadIndex(args); });
+	m_actionMap.emplace("ingest_stats", [this](std::istringstream&) { PrintIngestStats(); });
+	m_actionMap.emplace("cache_stats", [this](std::istringstream&) { PrintCacheStats(); });
+	m_actionMap.emplace("watch", [this](std::istringstream& args) { Watch(args); });
+	m_actionMap.emplace("unwatch", [this](std::istringstream&) { Unwatch(); });
 }
 
 void SearchEngine::Run()
@@ -78,6 +129,11 @@ void SearchEngine::HandleCommand(const std::string& line)
 		{
 			m_output << "error: unknown exception" << std::endl;
 		}
+		// Слияния идут в фоне, поэтому их ошибка сообщается после команды, во время которой замечена
+		if (const auto error = m_index.TakeMergeError())
+		{
+			m_output << "error: " << *error << std::endl;
+		}
 		return;
 	}
 	m_output << "error: unknown command" << std::endl;
@@ -98,15 +154,27 @@ void SearchEngine::AddFile(std::istringstream& args)
 		m_output << "error: path not found: " << path << std::endl;
 		return;
 	}
-	const auto content = ReadFile(p);
-	if (!content)
+	if (!IndexFile(p))
 	{
 		m_output << "error: cannot read file: " << path << std::endl;
-		return;
+	}
+}
+
+bool SearchEngine::IndexFile(const fs::path& path)
+{
+	const auto result = m_fileLoader.LoadIfChanged(path, m_index.GetDocumentVersion(path.string()));
+	if (result.unchanged)
+	{
+		return true;
+	}
+	if (!result.content)
+	{
+		return false;
 	}
 
 	const std::uint64_t id = m_nextDocId.fetch_add(1);
-	m_index.AddDocument(id, p.string(), *content);
+	m_index.AddDocument(id, path.string(), result.content->GetData(), result.content->GetVersion());
+	return true;
 }
 
 void SearchEngine::AddDirectory(std::istringstream& args, bool recursive)
@@ -127,34 +195,34 @@ void SearchEngine::AddDirectory(std::istringstream& args, bool recursive)
 	}
 
 	const auto start = std::chrono::high_resolution_clock::now();
-	std::vector<std::filesystem::path> files;
-	try
-	{
-		files = CollectFiles(dir, recursive);
-	}
-	catch (const std::exception& e)
-	{
-		m_output << "error: " << e.what() << std::endl;
-		return;
-	}
+	const auto getVersion = [this](const std::filesystem::path& file) {
+		return m_index.GetDocumentVersion(file.string());
+	};
+	m_ingestPipeline.Run(dir, recursive, getVersion, [this](const std::filesystem::path& file, std::span<char> content, const FileVersion& version) {
+		const std::uint64_t id = m_nextDocId.fetch_add(1);
+		m_index.AddDocument(id, file.string(), content, version);
+	});
 
-	if (files.empty())
+	const auto stats = m_ingestPipeline.GetStats();
+	if (stats.crawl.items == 0)
 	{
 		m_output << "No files to add." << std::endl;
 		return;
 	}
-
-	size_t addedCount = 0;
-	AddFiles(files, addedCount);
+	const size_t addedCount = stats.index.items;
 
 	const auto end = std::chrono::high_resolution_clock::now();
 	const double duration = std::chrono::duration<double>(end - start).count();
 
 	m_output << "Adding took " << std::fixed << std::setprecision(4) << duration << "s:" << std::endl;
 	m_output << "Added " << addedCount << " file(s) from directory: " << dir.string() << std::endl;
+	if (stats.unchanged != 0)
+	{
+		m_output << "Skipped " << stats.unchanged << " unchanged file(s)" << std::endl;
+	}
 }
 
-void SearchEngine::Find(std::istringstream& args) const
+void SearchEngine::Find(std::istringstream& args, bool withSnippets) const
 {
 	std::string query;
 	std::getline(args, query);
@@ -168,25 +236,49 @@ void SearchEngine::Find(std::istringstream& args) const
 		return;
 	}
 
-	const auto terms = Tokenizer::ExtractWords(query);
+	const auto positional = ParsePositionalQuery(query);
+	const auto terms = positional ? positional->terms : Tokenizer::ExtractWords(query);
 	if (terms.empty())
 	{
 		m_output << "error: empty query" << std::endl;
 		return;
 	}
 
+	std::string key;
+	if (!positional)
+	{
+		key = MakeQueryKey(m_index.IsProximityRanking() ? "find+proximity" : "find", terms, false);
+	}
+	else if (positional->kind == PositionalQuery::Kind::Phrase)
+	{
+		key = MakeQueryKey("phrase", terms, true);
+	}
+	else
+	{
+		key = MakeQueryKey("near/" + std::to_string(positional->distance), terms, false);
+	}
+
 	const auto start = std::chrono::high_resolution_clock::now();
-	auto results = m_index.Search(terms);
+	const auto results = SearchCached(key, [&] {
+		return positional ? m_index.SearchPositional(*positional) : m_index.Search(terms);
+	});
 	const auto end = std::chrono::high_resolution_clock::now();
 	const double duration = std::chrono::duration<double>(end - start).count();
 
+	const auto paths = m_index.GetPathTable();
 	m_output << "Search took " << std::fixed << std::setprecision(4) << duration << "s:" << std::endl;
 	for (size_t i = 0; i < results.size(); ++i)
 	{
 		const auto& [id, relevance] = results[i];
 		m_output << (i + 1) << ". id:" << id
 				 << ", relevance:" << std::fixed << std::setprecision(5) << relevance
-				 << ", path:" << m_index.GetPathById(id) << std::endl;
+				 << ", path:" << paths->GetPath(id) << std::endl;
+		if (withSnippets)
+		{
+			const auto doc = m_index.GetDocumentPositions(id, terms);
+			const auto snippet = doc ? SnippetExtractor::Extract(*doc) : std::nullopt;
+			m_output << "   " << (snippet ? *snippet : "(snippet unavailable)") << std::endl;
+		}
 	}
 	if (!results.empty())
 	{
@@ -208,18 +300,30 @@ void SearchEngine::FindSubstring(std::istringstream& args) const
 		return;
 	}
 
+	// Поиск подстроки не зависит от регистра и модели ранжирования
+	std::string key = "substring:" + substring;
+	std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+
 	const auto start = std::chrono::high_resolution_clock::now();
-	const auto docIds = m_index.SearchSubstring(substring);
+	const auto docs = SearchCached(key, [&] {
+		QueryCache::Results results;
+		for (const std::uint64_t id : m_index.SearchSubstring(substring))
+		{
+			results.emplace_back(id, 0.0);
+		}
+		return results;
+	});
 	const auto end = std::chrono::high_resolution_clock::now();
 	const double duration = std::chrono::duration<double>(end - start).count();
 
+	const auto paths = m_index.GetPathTable();
 	m_output << "Substring search took " << std::fixed << std::setprecision(4) << duration << "s:" << std::endl;
-	for (size_t i = 0; i < docIds.size(); ++i)
+	for (size_t i = 0; i < docs.size(); ++i)
 	{
-		m_output << (i + 1) << ". id:" << docIds[i]
-				 << ", path:" << m_index.GetPathById(docIds[i]) << std::endl;
+		m_output << (i + 1) << ". id:" << docs[i].first
+				 << ", path:" << paths->GetPath(docs[i].first) << std::endl;
 	}
-	if (!docIds.empty())
+	if (!docs.empty())
 	{
 		m_output << "---" << std::endl;
 	}
@@ -307,6 +411,57 @@ void SearchEngine::RemoveDirectory(std::istringstream& args, bool recursive)
 	m_index.RemoveDocumentsInDir(dir.string(), recursive);
 }
 
+void SearchEngine::Watch(std::istringstream& args)
+{
+	std::string path;
+	args >> path;
+	if (path.empty())
+	{
+		m_output << "error: empty path" << std::endl;
+		return;
+	}
+
+	const auto dir = std::filesystem::absolute(std::filesystem::path(path));
+	if (!std::filesystem::exists(dir) || !std::filesystem::is_directory(dir))
+	{
+		m_output << "error: path not found: " << path << std::endl;
+		return;
+	}
+
+	if (!m_watcher)
+	{
+		m_watcher = std::make_unique<DirectoryWatcher>(
+			[this](const std::filesystem::path& file) { IndexFile(file); },
+			[this](const std::filesystem::path& removed, bool isDirectory) { RemoveWatchedPath(removed, isDirectory); },
+			[this](const std::filesystem::path& root) { return m_index.GetPathTable()->GetPathsInDirectory(root.string(), true); });
+	}
+	m_watcher->Watch(dir);
+	m_output << "Watching directory: " << dir.string() << std::endl;
+}
+
+void SearchEngine::Unwatch()
+{
+	if (!m_watcher)
+	{
+		m_output << "error: no watched directories" << std::endl;
+		return;
+	}
+	const size_t count = m_watcher->GetRoots().size();
+	m_watcher.reset();
+	m_output << "Stopped watching " << count << " director(ies)" << std::endl;
+}
+
+void SearchEngine::RemoveWatchedPath(const std::filesystem::path& path, bool isDirectory)
+{
+	if (!isDirectory)
+	{
+		m_index.RemoveDocument(path.string());
+		return;
+	}
+
+	m_index.RemoveDocumentsInDir(path.string(), true);
+}
+
 void SearchEngine::PrintIndexedDocuments() const
 {
 	for (const auto docs = m_index.GetIndexedDocuments(); const auto& doc : docs)
@@ -315,95 +470,194 @@ void SearchEngine::PrintIndexedDocuments() const
 	}
 }
 
-std::vector<std::filesystem::path> SearchEngine::CollectFiles(const std::filesystem::path& dir, bool recursive)
+void SearchEngine::SetRanking(std::istringstream& args)
 {
-	std::vector<std::filesystem::path> files;
-	try
+	std::string model;
+	args >> model;
+	if (model == "tfidf")
 	{
-		if (recursive)
-		{
-			for (const auto& entry : std::filesystem::recursive_directory_iterator(dir))
-			{
-				if (entry.is_regular_file())
-				{
-					files.push_back(entry.path());
-				}
-			}
-		}
-		else
-		{
-			for (const auto& entry : std::filesystem::directory_iterator(dir))
-			{
-				if (entry.is_regular_file())
-				{
-					files.push_back(entry.path());
-				}
-			}
-		}
+		m_index.SetRankingModel(RankingModel::TfIdf);
 	}
-	catch (const std::filesystem::filesystem_error& e)
+	else if (model == "bm25")
 	{
-		throw std::runtime_error("path not found: " + dir.string() + " (" + e.what() + ")");
+		m_index.SetRankingModel(RankingModel::Bm25);
+	}
+	else
+	{
+		m_output << "error: unknown ranking model: " << model << std::endl;
 	}
-	return files;
 }
 
-void SearchEngine::AddFiles(const std::vector<std::filesystem::path>& files, size_t& outAddedCount)
+void SearchEngine::SetProximity(std::istringstream& args)
 {
-	std::atomic<size_t> added{ 0 };
+	std::string mode;
+	args >> mode;
+	if (mode == "on")
+	{
+		m_index.SetProximityRanking(true);
+	}
+	else if (mode == "off")
+	{
+		m_index.SetProximityRanking(false);
+	}
+	else
+	{
+		m_output << "error: unknown proximity mode: " << mode << std::endl;
+	}
+}
 
-	for (const auto& file : files)
+void SearchEngine::SaveIndex(std::istringstream& args)
+{
+	std::string path;
+	args >> path;
+	if (path.empty())
 	{
-		m_threadPool->Enqueue([this, file, &added]() {
-			const auto content = ReadFile(file);
-			if (!content)
-			{
-				return;
-			}
-			const std::uint64_t id = m_nextDocId.fetch_add(1);
-			m_index.AddDocument(id, file.string(), *content);
-			++added;
-		});
+		m_output << "error: empty path" << std::endl;
+		return;
 	}
 
-	m_threadPool->Wait();
-	outAddedCount = added.load();
+	const auto p = std::filesystem::absolute(std::filesystem::path(path));
+	const auto start = std::chrono::high_resolution_clock::now();
+	m_index.Save(p.string());
+	const auto end = std::chrono::high_resolution_clock::now();
+	const double duration = std::chrono::duration<double>(end - start).count();
+
+	m_output << "Saving took " << std::fixed << std::setprecision(4) << duration << "s:" << std::endl;
+	m_output << "Saved index to: " << p.string() << std::endl;
 }
 
-void SearchEngine::ProcessBatchQueries(const std::vector<std::string>& queries) const
+void SearchEngine::LoadIndex(std::istringstream& args)
+{
+	std::string path;
+	args >> path;
+	if (path.empty())
+	{
+		m_output << "error: empty path" << std::endl;
+		return;
+	}
+
+	const auto p = std::filesystem::absolute(std::filesystem::path(path));
+	if (!std::filesystem::exists(p) || !std::filesystem::is_regular_file(p))
+	{
+		m_output << "error: path not found: " << path << std::endl;
+		return;
+	}
+
+	const auto start = std::chrono::high_resolution_clock::now();
+	const std::uint64_t maxDocId = m_index.Load(p.string());
+	// Новые документы не должны получить идентификаторы документов сегмента
+	for (std::uint64_t next = m_nextDocId.load(); next <= maxDocId && !m_nextDocId.compare_exchange_weak(next, maxDocId + 1);)
+	{
+	}
+	const auto end = std::chrono::high_resolution_clock::now();
+	const double duration = std::chrono::duration<double>(end - start).count();
+
+	m_output << "Loading took " << std::fixed << std::setprecision(4) << duration << "s:" << std::endl;
+	m_output << "Loaded index from: " << p.string() << std::endl;
+}
+
+void SearchEngine::PrintIngestStats() const
+{
+	const auto stats = m_ingestPipeline.GetStats();
+	constexpr double MiB = 1024.0 * 1024.0;
+	const auto printStage = [this](const char* name, const IngestPipeline::StageStats& stage) {
+		m_output << name << ": " << stage.items << " file(s), " << std::fixed << std::setprecision(2)
+				 << static_cast<double>(stage.bytes) / MiB << " MiB, busy " << std::setprecision(4)
+				 << stage.busySeconds << "s" << std::endl;
+	};
+
+	m_output << "crawl: " << stats.directories << " dir(s), " << stats.crawl.items << " file(s), busy "
+			 << std::fixed << std::setprecision(4) << stats.crawl.busySeconds << "s" << std::endl;
+	printStage("read", stats.read);
+	printStage("index", stats.index);
+	const double elapsed = std::max(stats.elapsedSeconds, 1e-9);
+	m_output << "total: " << std::setprecision(4) << stats.elapsedSeconds << "s, " << std::setprecision(1)
+			 << static_cast<double>(stats.index.items) / elapsed << " file(s)/s, " << std::setprecision(2)
+			 << static_cast<double>(stats.index.bytes) / MiB / elapsed << " MiB/s, unchanged: " << stats.unchanged
+			 << ", errors: " << stats.errors
+			 << std::endl;
+}
+
+void SearchEngine::PrintCacheStats() const
+{
+	const auto stats = m_queryCache.GetStats();
+	const std::size_t lookups = stats.hits + stats.misses;
+	const auto average = [](double seconds, std::size_t count) {
+		return count == 0 ? 0.0 : seconds / static_cast<double>(count) * 1e3;
+	};
+
+	m_output << "query cache: " << stats.entries << "/" << stats.capacity << " entries, hits: " << stats.hits
+			 << ", misses: " << stats.misses << " (stale: " << stats.stale << "), hit ratio: " << std::fixed
+			 << std::setprecision(1) << (lookups == 0 ? 0.0 : 100.0 * static_cast<double>(stats.hits) / static_cast<double>(lookups))
+			 << "%" << std::endl;
+	m_output << "average latency: hit " << std::setprecision(4) << average(stats.hitSeconds, stats.hits)
+			 << "ms, miss " << average(stats.missSeconds, stats.misses) << "ms" << std::endl;
+}
+
+std::string SearchEngine::MakeQueryKey(const std::string& kind, std::vector<std::string> terms, bool isOrdered) const
+{
+	if (!isOrdered)
+	{
+		std::sort(terms.begin(), terms.end());
+	}
+	std::string key = kind;
+	key += m_index.GetRankingModel() == RankingModel::Bm25 ? ":bm25:" : ":tfidf:";
+	for (const auto& term : terms)
+	{
+		key += term;
+		key += ' ';
+	}
+	return key;
+}
+
+QueryCache::Results SearchEngine::SearchCached(const std::string& key, const std::function<QueryCache::Results()>& search) const
 {
-	for (size_t i = 0; i < queries.size(); ++i)
+	const auto start = QueryCache::Clock::now();
+	// Поколение читается до поиска: если индекс изменится во время поиска, запись сразу будет устаревшей
+	const std::uint64_t generation = m_index.GetGeneration();
+	if (auto results = m_queryCache.Find(key, generation))
 	{
+		m_queryCache.RecordLatency(true, start);
+		return std::move(*results);
+	}
+
+	auto results = search();
+	m_queryCache.Insert(key, generation, results);
+	m_queryCache.RecordLatency(false, start);
+	return results;
+}
+
+void SearchEngine::ProcessBatchQueries(const std::vector<std::string>& queries) const
+{
+	m_threadPool->ParallelFor(0, queries.size(), 1, [this, &queries](size_t i) {
 		const size_t idx = i + 1;
 		const std::string& q = queries[i];
-		m_threadPool->Enqueue([this, idx, q]() {
-			const auto terms = Tokenizer::ExtractWords(q);
-			if (terms.empty())
-			{
-				return;
-			}
-
-			const auto start = std::chrono::high_resolution_clock::now();
-			auto results = m_index.Search(terms);
-			const auto end = std::chrono::high_resolution_clock::now();
-			const double duration = std::chrono::duration<double>(end - start).count();
-
-			std::lock_guard lock(m_outputMutex);
-			m_output << idx << ". query: " << q << std::endl;
-			m_output << "  Search took " << std::fixed << std::setprecision(4) << duration << "s:" << std::endl;
-			for (size_t j = 0; j < results.size(); ++j)
-			{
-				const auto& [id, relevance] = results[j];
-				m_output << "  " << (j + 1) << ". id:" << id
-						 << ", relevance:" << std::fixed << std::setprecision(5) << relevance
-						 << ", path:" << m_index.GetPathById(id) << std::endl;
-			}
-			if (!results.empty())
-			{
-				m_output << "  ---" << std::endl;
-			}
-		});
-	}
-
-	m_threadPool->Wait();
+		const auto terms = Tokenizer::ExtractWords(q);
+		if (terms.empty())
+		{
+			return;
+		}
+
+		const auto key = MakeQueryKey(m_index.IsProximityRanking() ? "find+proximity" : "find", terms, false);
+		const auto start = std::chrono::high_resolution_clock::now();
+		const auto results = SearchCached(key, [this, &terms] { return m_index.Search(terms); });
+		const auto end = std::chrono::high_resolution_clock::now();
+		const double duration = std::chrono::duration<double>(end - start).count();
+
+		const auto paths = m_index.GetPathTable();
+		std::lock_guard lock(m_outputMutex);
+		m_output << idx << ". query: " << q << std::endl;
+		m_output << "  Search took " << std::fixed << std::setprecision(4) << duration << "s:" << std::endl;
+		for (size_t j = 0; j < results.size(); ++j)
+		{
+			const auto& [id, relevance] = results[j];
+			m_output << "  " << (j + 1) << ". id:" << id
+					 << ", relevance:" << std::fixed << std::setprecision(5) << relevance
+					 << ", path:" << paths->GetPath(id) << std::endl;
+		}
+		if (!results.empty())
+		{
+			m_output << "  ---" << std::endl;
+		}
+	});
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "DirectoryWatcher.h"
+#include "FileLoader.h"
+#include "IngestPipeline.h"
 #include "InvertedIndex.h"
+#include "QueryCache.h"
 #include "ThreadPool.h"
 
 #include <atomic>
@@ -25,24 +29,44 @@ private:
 	void HandleCommand(const std::string& line);
 	void AddFile(std::istringstream& args);
 	void AddDirectory(std::istringstream& args, bool recursive);
-	void Find(std::istringstream& args) const;
+	void Find(std::istringstream& args, bool withSnippets) const;
 	void FindSubstring(std::istringstream& args) const;
 	void FindBatch(std::istringstream& args) const;
 	void RemoveFile(std::istringstream& args);
 	void RemoveDirectory(std::istringstream& args, bool recursive);
 	void PrintIndexedDocuments() const;
+	void SetRanking(std::istringstream& args);
+	void SetProximity(std::istringstream& args);
+	void SaveIndex(std::istringstream& args);
+	void LoadIndex(std::istringstream& args);
+	void PrintIngestStats() const;
+	void PrintCacheStats() const;
+	void Watch(std::istringstream& args);
+	void Unwatch();
 
-	static std::vector<std::filesystem::path> CollectFiles(
-	const std::filesystem::path& dir, bool recursive);
+	// Индексирует новый или изменённый файл; false, если файл не удалось прочитать
+	bool IndexFile(const fs::path& path);
+	void RemoveWatchedPath(const fs::path& path, bool isDirectory);
 
-	void AddFiles(const std::vector<std::filesystem::path>& files, size_t& outAddedCount);
 	void ProcessBatchQueries(const std::vector<std::string>& queries) const;
 
+	// Ключ кэша: вид запроса, модель ранжирования и термы; порядок термов важен только для фраз
+	std::string MakeQueryKey(const std::string& kind, std::vector<std::string> terms, bool isOrdered) const;
+	// Результат из кэша, а если его там нет или он устарел — посчитанный search и сохранённый в кэш
+	QueryCache::Results SearchCached(const std::string& key, const std::function<QueryCache::Results()>& search) const;
+
 	std::istream& m_input;
 	std::ostream& m_output;
 	ActionMap m_actionMap;
 	std::unique_ptr<ThreadPool> m_threadPool;
+	// Слияния сегментов идут на своём потоке и не отнимают потоки у индексации
+	std::unique_ptr<ThreadPool> m_mergePool;
 	InvertedIndex m_index;
+	FileLoader m_fileLoader;
+	IngestPipeline m_ingestPipeline;
 	std::atomic<std::uint64_t> m_nextDocId{ 1 };
+	mutable QueryCache m_queryCache;
 	mutable std::mutex m_outputMutex;
+	// Объявлен последним: поток наблюдения останавливается раньше, чем разрушается индекс
+	std::unique_ptr<DirectoryWatcher> m_watcher;
 };
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "SnippetExtractor.h"
+#include "PositionMatch.h"
+#include "Tokenizer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <span>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace
+{
+constexpr std::size_t ReadChunkSize = 4096;
+constexpr std::size_t MaxSnippetLength = 300;
+
+bool IsSameVersion(const struct stat& info, const FileVersion& version)
+{
+	const auto modificationTime = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec;
+	return modificationTime == version.modificationTime && static_cast<std::uint64_t>(info.st_size) == version.size;
+}
+
+// Дочитывает файл с offset до заполнения text или до конца файла. false при ошибке чтения
+bool ReadAt(int fd, std::uint64_t offset, std::vector<char>& text, std::size_t from, bool& isEof)
+{
+	while (from < text.size())
+	{
+		const ssize_t result = pread(fd, text.data() + from, text.size() - from, static_cast<off_t>(offset + from));
+		if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (result < 0)
+		{
+			return false;
+		}
+		if (result == 0)
+		{
+			isEof = true;
+			text.resize(from);
+			break;
+		}
+		from += static_cast<std::size_t>(result);
+	}
+	return true;
+}
+
+// Байтовые границы слов first и last в text, если слова в нём считаются с номера index.
+// nullopt, если слово last ещё не прочитано целиком. text разбирается на месте
+std::optional<std::pair<std::size_t, std::size_t>> FindWordRange(std::span<char> text, std::size_t index,
+	std::size_t first, std::size_t last, bool isEof)
+{
+	std::size_t beginByte = 0;
+	std::optional<std::pair<std::size_t, std::size_t>> range;
+	Tokenizer::ForEachWord(text, [&](std::string_view word) {
+		const auto begin = static_cast<std::size_t>(word.data() - text.data());
+		const std::size_t end = begin + word.size();
+		// Слово, упирающееся в конец прочитанного, может продолжаться в файле
+		if (range || (end == text.size() && !isEof))
+		{
+			return;
+		}
+		if (index == first)
+		{
+			beginByte = begin;
+		}
+		if (index == last)
+		{
+			range.emplace(beginByte, end);
+		}
+		++index;
+	});
+	return range;
+}
+} // namespace
+
+std::optional<std::string> SnippetExtractor::Extract(const DocumentPositions& doc, std::size_t maxWords)
+{
+	if (doc.wordCount == 0 || maxWords == 0)
+	{
+		return std::nullopt;
+	}
+
+	// Без совпадений показывается начало документа. Окно дополняется контекстом поровну с обеих сторон
+	const std::vector<std::span<const std::uint32_t>> positions(doc.termPositions.begin(), doc.termPositions.end());
+	const auto matched = PositionMatch::FindDensestWindow(positions, maxWords);
+	std::size_t first = matched ? matched->first : 0;
+	const std::size_t matchedLength = matched ? matched->second - matched->first + 1 : 1;
+	first -= std::min(first, (maxWords - matchedLength) / 2);
+	const std::size_t last = std::min(doc.wordCount, first + maxWords) - 1;
+
+	const std::size_t checkpoint = first / Document::WordOffsetInterval;
+	if (checkpoint >= doc.wordOffsets.size())
+	{
+		return std::nullopt;
+	}
+	const std::uint64_t offset = doc.wordOffsets[checkpoint];
+
+	const int fd = ::open(doc.path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return std::nullopt;
+	}
+	struct stat info
+	{
+	};
+	if (fstat(fd, &info) != 0 || !IsSameVersion(info, doc.version))
+	{
+		close(fd);
+		return std::nullopt;
+	}
+
+	// Слова считаются от опорного тем же токенизатором, что при индексации. Прочитанное удваивается,
+	// пока не найдётся последнее слово окна, так что общий объём разбора линеен по длине фрагмента
+	std::vector<char> text;
+	std::vector<char> scratch;
+	std::optional<std::pair<std::size_t, std::size_t>> range;
+	bool isEof = false;
+	while (!range && !isEof)
+	{
+		const std::size_t readFrom = text.size();
+		text.resize(readFrom + std::max(ReadChunkSize, readFrom));
+		if (!ReadAt(fd, offset, text, readFrom, isEof))
+		{
+			close(fd);
+			return std::nullopt;
+		}
+
+		scratch = text;
+		range = FindWordRange(scratch, checkpoint * Document::WordOffsetInterval, first, last, isEof);
+	}
+	close(fd);
+	if (!range)
+	{
+		return std::nullopt;
+	}
+
+	std::string snippet(text.data() + range->first, text.data() + range->second);
+	std::replace_if(snippet.begin(), snippet.end(), [](char ch) { return ch == '\n' || ch == '\r' || ch == '\t'; }, ' ');
+	if (snippet.size() > MaxSnippetLength)
+	{
+		snippet.resize(MaxSnippetLength);
+		if (const auto lastSpace = snippet.find_last_of(' '); lastSpace != std::string::npos)
+		{
+			snippet.resize(lastSpace);
+		}
+		snippet += "...";
+	}
+	return snippet;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "Document.h"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+namespace SnippetExtractor
+{
+// Фрагмент текста не длиннее maxWords слов вокруг самого плотного скопления термов запроса.
+// Окно выбирается по позициям из индекса, а файл читается с ближайшего опорного слова,
+// так что документ не разбирается заново от начала. nullopt, если файл не удалось прочитать
+// или он изменился после индексации
+std::optional<std::string> Extract(const DocumentPositions& doc, std::size_t maxWords = 30);
+} // namespace SnippetExtractor
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "TermDictionary.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+
+std::optional<TermId> TermDictionary::Find(std::string_view term) const
+{
+	std::shared_lock lock(m_mutex);
+	if (m_slots.empty())
+	{
+		return std::nullopt;
+	}
+	const TermId id = m_slots[FindSlot(term, Hash(term))];
+	return id == EmptySlot ? std::nullopt : std::optional<TermId>(id);
+}
+
+TermId TermDictionary::Intern(std::string_view term)
+{
+	const std::uint32_t hash = Hash(term);
+	{
+		std::shared_lock lock(m_mutex);
+		if (!m_slots.empty())
+		{
+			if (const TermId id = m_slots[FindSlot(term, hash)]; id != EmptySlot)
+			{
+				return id;
+			}
+		}
+	}
+	std::unique_lock lock(m_mutex);
+	return InsertLocked(term, hash);
+}
+
+std::vector<TermId> TermDictionary::Intern(const std::vector<std::string_view>& terms)
+{
+	std::vector<TermId> ids(terms.size(), EmptySlot);
+	std::vector<std::uint32_t> hashes(terms.size());
+	bool hasMissing = false;
+	{
+		std::shared_lock lock(m_mutex);
+		for (std::size_t i = 0; i < terms.size(); ++i)
+		{
+			hashes[i] = Hash(terms[i]);
+			if (!m_slots.empty())
+			{
+				ids[i] = m_slots[FindSlot(terms[i], hashes[i])];
+			}
+			hasMissing = hasMissing || ids[i] == EmptySlot;
+		}
+	}
+	if (!hasMissing)
+	{
+		return ids;
+	}
+
+	std::unique_lock lock(m_mutex);
+	for (std::size_t i = 0; i < terms.size(); ++i)
+	{
+		if (ids[i] == EmptySlot)
+		{
+			ids[i] = InsertLocked(terms[i], hashes[i]);
+		}
+	}
+	return ids;
+}
+
+std::string_view TermDictionary::GetTerm(TermId id) const
+{
+	std::shared_lock lock(m_mutex);
+	const auto& entry = m_entries.at(id);
+	return { entry.data, entry.length };
+}
+
+std::size_t TermDictionary::GetSize() const
+{
+	std::shared_lock lock(m_mutex);
+	return m_entries.size();
+}
+
+std::size_t TermDictionary::GetMemoryUsage() const
+{
+	std::shared_lock lock(m_mutex);
+	return m_arenaBytes
+		+ m_chunks.capacity() * sizeof(m_chunks[0])
+		+ m_entries.capacity() * sizeof(Entry)
+		+ m_slots.capacity() * sizeof(TermId);
+}
+
+std::uint32_t TermDictionary::Hash(std::string_view term)
+{
+	const std::size_t hash = std::hash<std::string_view>{}(term);
+	return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
+
+std::size_t TermDictionary::FindSlot(std::string_view term, std::uint32_t hash) const
+{
+	// Размер таблицы — степень двойки, пробирование линейное
+	const std::size_t mask = m_slots.size() - 1;
+	for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask)
+	{
+		const TermId id = m_slots[slot];
+		if (id == EmptySlot)
+		{
+			return slot;
+		}
+		const auto& entry = m_entries[id];
+		if (entry.hash == hash && std::string_view(entry.data, entry.length) == term)
+		{
+			return slot;
+		}
+	}
+}
+
+TermId TermDictionary::InsertLocked(std::string_view term, std::uint32_t hash)
+{
+	// Между разделяемой и исключительной блокировками строку мог добавить другой поток
+	if (!m_slots.empty())
+	{
+		if (const TermId id = m_slots[FindSlot(term, hash)]; id != EmptySlot)
+		{
+			return id;
+		}
+	}
+	if (m_entries.size() >= EmptySlot - 1)
+	{
+		throw std::runtime_error("TermDictionary is full");
+	}
+
+	// Заполненность таблицы держится не выше 3/4
+	if ((m_entries.size() + 1) * 4 > m_slots.size() * 3)
+	{
+		Rehash(std::max<std::size_t>(m_slots.size() * 2, 1024));
+	}
+
+	const auto id = static_cast<TermId>(m_entries.size());
+	m_entries.push_back({ StoreBytes(term), static_cast<std::uint32_t>(term.size()), hash });
+	m_slots[FindSlot(term, hash)] = id;
+	return id;
+}
+
+const char* TermDictionary::StoreBytes(std::string_view term)
+{
+	char* data = nullptr;
+	if (term.size() > ChunkSize)
+	{
+		// Слишком длинная строка получает собственный блок, текущий продолжает заполняться
+		data = m_chunks.emplace_back(std::make_unique<char[]>(term.size())).get();
+		m_arenaBytes += term.size();
+	}
+	else
+	{
+		if (ChunkSize - m_chunkUsed < term.size())
+		{
+			m_currentChunk = m_chunks.emplace_back(std::make_unique<char[]>(ChunkSize)).get();
+			m_chunkUsed = 0;
+			m_arenaBytes += ChunkSize;
+		}
+		data = m_currentChunk + m_chunkUsed;
+		m_chunkUsed += term.size();
+	}
+	std::memcpy(data, term.data(), term.size());
+	return data;
+}
+
+void TermDictionary::Rehash(std::size_t slotCount)
+{
+	m_slots.assign(slotCount, EmptySlot);
+	const std::size_t mask = slotCount - 1;
+	for (TermId id = 0; id < m_entries.size(); ++id)
+	{
+		std::size_t slot = m_entries[id].hash & mask;
+		while (m_slots[slot] != EmptySlot)
+		{
+			slot = (slot + 1) & mask;
+		}
+		m_slots[slot] = id;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using TermId = std::uint32_t;
+
+// Словарь, выдающий строкам плотные 32-битные идентификаторы в порядке первого появления.
+// Байты строк лежат в арене из крупных блоков и не перемещаются, поэтому string_view,
+// полученный через GetTerm, остаётся действительным всё время жизни словаря.
+// Поиск — открытая адресация по таблице идентификаторов с сохранённым хешем строки.
+// Идентификаторы не освобождаются: терм, исчезнувший из всех документов, остаётся в словаре
+class TermDictionary
+{
+public:
+	std::optional<TermId> Find(std::string_view term) const;
+	TermId Intern(std::string_view term);
+	// Пакетный вариант: сначала все строки ищутся под разделяемой блокировкой,
+	// и только для новых берётся исключительная
+	std::vector<TermId> Intern(const std::vector<std::string_view>& terms);
+
+	std::string_view GetTerm(TermId id) const;
+	std::size_t GetSize() const;
+	std::size_t GetMemoryUsage() const;
+
+private:
+	struct Entry
+	{
+		const char* data;
+		std::uint32_t length;
+		std::uint32_t hash;
+	};
+
+	static constexpr std::size_t ChunkSize = 64 * 1024;
+	static constexpr TermId EmptySlot = ~TermId{ 0 };
+
+	static std::uint32_t Hash(std::string_view term);
+	std::size_t FindSlot(std::string_view term, std::uint32_t hash) const;
+	TermId InsertLocked(std::string_view term, std::uint32_t hash);
+	const char* StoreBytes(std::string_view term);
+	void Rehash(std::size_t slotCount);
+
+	mutable std::shared_mutex m_mutex;
+	std::vector<std::unique_ptr<char[]>> m_chunks;
+	char* m_currentChunk = nullptr;
+	std::size_t m_chunkUsed = ChunkSize;
+	std::size_t m_arenaBytes = 0;
+	std::vector<Entry> m_entries;
+	std::vector<TermId> m_slots;
+};
\ No newline at end of file
@@ -1,45 +1,84 @@
 #include "Tokenizer.h"
 
-std::vector<std::string> Tokenizer::ExtractWords(const std::string& text)
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+std::uint64_t Tokenizer::Detail::LowercaseLetters(char* data, std::size_t size)
 {
-	std::vector<std::string> words;
-	std::string current;
-	for (const char ch : text)
+#ifdef __SSE2__
+	// Буква — байт, который после установки бита 0x20 попадает в 'a'..'z'. Сравнение знаковое,
+	// поэтому байты не из ASCII буквами не считаются, как и у std::isalpha в локали "C".
+	// Неполный блок обрабатывается через копию, дополненную нулями
+	alignas(16) char block[64];
+	char* bytes = data;
+	if (size < 64)
+	{
+		std::memset(block, 0, sizeof(block));
+		std::memcpy(block, data, size);
+		bytes = block;
+	}
+
+	const __m128i caseBit = _mm_set1_epi8(0x20);
+	const __m128i beforeA = _mm_set1_epi8('a' - 1);
+	const __m128i afterZ = _mm_set1_epi8('z' + 1);
+	std::uint64_t letters = 0;
+	bool changed = false;
+	for (std::size_t i = 0; i < 64; i += 16)
 	{
-		if (std::isalpha(static_cast<unsigned char>(ch)))
+		auto* chunk = reinterpret_cast<__m128i*>(bytes + i);
+		const __m128i chars = _mm_loadu_si128(chunk);
+		const __m128i lower = _mm_or_si128(chars, caseBit);
+		const __m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, beforeA), _mm_cmplt_epi8(lower, afterZ));
+		const __m128i lowered = _mm_or_si128(chars, _mm_and_si128(isLetter, caseBit));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(lowered, chars)) != 0xFFFF)
 		{
-			current += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+			_mm_storeu_si128(chunk, lowered);
+			changed = true;
 		}
-		else
+		letters |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(isLetter))) << i;
+	}
+
+	if (bytes == block && changed)
+	{
+		std::memcpy(data, block, size);
+	}
+	return letters;
+#else
+	std::uint64_t letters = 0;
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		const char lower = static_cast<char>(data[i] | 0x20);
+		if (lower >= 'a' && lower <= 'z')
 		{
-			if (!current.empty())
+			if (data[i] != lower)
 			{
-				words.push_back(std::move(current));
-				current.clear();
+				data[i] = lower;
 			}
+			letters |= std::uint64_t{ 1 } << i;
 		}
 	}
-	if (!current.empty())
-	{
-		words.push_back(std::move(current));
-	}
+	return letters;
+#endif
+}
+
+std::vector<std::string> Tokenizer::ExtractWords(const std::string& text)
+{
+	std::vector<std::string> words;
+	std::string lowered = text;
+	ForEachWord(lowered, [&words](std::string_view word) {
+		words.emplace_back(word);
+	});
 	return words;
 }
 
 std::vector<std::string> Tokenizer::GenerateNGrams(const std::string& s, int n)
 {
 	std::vector<std::string> grams;
-	if (s.size() < static_cast<size_t>(n))
-	{
-		if (!s.empty())
-		{
-			grams.push_back(s);
-		}
-		return grams;
-	}
-	for (size_t i = 0; i <= s.size() - n; ++i)
-	{
-		grams.push_back(s.substr(i, n));
-	}
+	ForEachNGram(s, n, [&grams](std::string_view gram) {
+		grams.emplace_back(gram);
+	});
 	return grams;
 }
\ No newline at end of file
@@ -1,10 +1,76 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace Tokenizer
 {
+namespace Detail
+{
+// Переводит латинские буквы блока не длиннее 64 байт в нижний регистр на месте.
+// Возвращает маску букв: бит i установлен, если data[i] — буква. Байты, которые не меняются,
+// не перезаписываются, так что страницы, отображённые через MAP_PRIVATE, копируются лишь при необходимости
+std::uint64_t LowercaseLetters(char* data, std::size_t size);
+} // namespace Detail
+
+// Слово — максимальная последовательность латинских букв. Текст переводится в нижний регистр
+// на месте и классифицируется по 64 байта, onWord получает string_view, указывающий внутрь text,
+// так что на каждое слово не создаётся отдельная строка
+template <typename F>
+void ForEachWord(std::span<char> text, F&& onWord)
+{
+	char* data = text.data();
+	bool inWord = false;
+	std::size_t wordBegin = 0;
+	for (std::size_t block = 0; block < text.size(); block += 64)
+	{
+		const std::uint64_t letters = Detail::LowercaseLetters(data + block, std::min<std::size_t>(64, text.size() - block));
+		// Каждый установленный бит — граница слова: начало или конец по очереди
+		for (std::uint64_t boundaries = letters ^ (letters << 1 | (inWord ? 1 : 0)); boundaries != 0; boundaries &= boundaries - 1)
+		{
+			const std::size_t pos = block + static_cast<std::size_t>(std::countr_zero(boundaries));
+			if (inWord)
+			{
+				onWord(std::string_view(data + wordBegin, pos - wordBegin));
+			}
+			else
+			{
+				wordBegin = pos;
+			}
+			inWord = !inWord;
+		}
+	}
+	if (inWord)
+	{
+		onWord(std::string_view(data + wordBegin, text.size() - wordBegin));
+	}
+}
+
+// Строка короче n сама считается единственной n-граммой
+template <typename F>
+void ForEachNGram(std::string_view s, int n, F&& onGram)
+{
+	const auto size = static_cast<std::size_t>(n);
+	if (s.size() < size)
+	{
+		if (!s.empty())
+		{
+			onGram(s);
+		}
+		return;
+	}
+	for (std::size_t i = 0; i <= s.size() - size; ++i)
+	{
+		onGram(s.substr(i, size));
+	}
+}
+
 std::vector<std::string> ExtractWords(const std::string& text);
 std::vector<std::string> GenerateNGrams(const std::string& s, int n = 3);
-} // namespace Tokenizer
+} // namespace Tokenizer
\ No newline at end of file
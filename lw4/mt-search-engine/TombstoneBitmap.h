@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Удалённые документы неизменяемого сегмента: по биту на каждый docId из диапазона сегмента.
+// Битовая карта публикуется неизменяемой, удаление создаёт изменённую копию. Слова карты
+// лежат блоками, общими для копий: копия разделяет блоки оригинала, а Insert копирует
+// только тот блок, который меняет. Блок без удалённых документов не хранится
+class TombstoneBitmap
+{
+public:
+	TombstoneBitmap(std::uint64_t firstDocId, std::uint64_t lastDocId)
+		: m_firstDocId(firstDocId)
+		, m_blocks((lastDocId - firstDocId) / BlockBits + 1)
+		, m_isOwned(m_blocks.size(), false)
+	{
+	}
+
+	// Копия разделяет блоки с оригиналом до первого изменения
+	TombstoneBitmap(const TombstoneBitmap& other)
+		: m_firstDocId(other.m_firstDocId)
+		, m_blocks(other.m_blocks)
+		, m_isOwned(other.m_blocks.size(), false)
+		, m_count(other.m_count)
+	{
+	}
+
+	TombstoneBitmap& operator=(const TombstoneBitmap&) = delete;
+
+	bool Contains(std::uint64_t docId) const
+	{
+		const std::uint64_t bit = docId - m_firstDocId;
+		if (docId < m_firstDocId || bit / BlockBits >= m_blocks.size())
+		{
+			return false;
+		}
+		const Block* block = m_blocks[bit / BlockBits].get();
+		return block && ((*block)[bit % BlockBits / 64] >> (bit % 64) & 1);
+	}
+
+	// Возвращает false, если документ уже был отмечен
+	bool Insert(std::uint64_t docId)
+	{
+		const std::uint64_t bit = docId - m_firstDocId;
+		if (docId < m_firstDocId || bit / BlockBits >= m_blocks.size())
+		{
+			throw std::out_of_range("Document is out of the bitmap range");
+		}
+		const std::uint64_t mask = std::uint64_t{ 1 } << (bit % 64);
+		const std::size_t blockIndex = bit / BlockBits;
+		const auto& shared = m_blocks[blockIndex];
+		if (shared && ((*shared)[bit % BlockBits / 64] & mask))
+		{
+			return false;
+		}
+		if (!m_isOwned[blockIndex])
+		{
+			m_blocks[blockIndex] = shared ? std::make_shared<Block>(*shared) : std::make_shared<Block>();
+			m_isOwned[blockIndex] = true;
+		}
+		// Блок принадлежит только этой карте, и её ещё не опубликовали
+		(*std::const_pointer_cast<Block>(m_blocks[blockIndex]))[bit % BlockBits / 64] |= mask;
+		++m_count;
+		return true;
+	}
+
+	std::size_t GetCount() const
+	{
+		return m_count;
+	}
+
+	template <typename F>
+	void ForEach(F&& fn) const
+	{
+		for (std::size_t b = 0; b < m_blocks.size(); ++b)
+		{
+			if (!m_blocks[b])
+			{
+				continue;
+			}
+			for (std::size_t i = 0; i < BlockWords; ++i)
+			{
+				for (std::uint64_t word = (*m_blocks[b])[i]; word != 0; word &= word - 1)
+				{
+					fn(m_firstDocId + b * BlockBits + i * 64 + static_cast<std::uint64_t>(std::countr_zero(word)));
+				}
+			}
+		}
+	}
+
+private:
+	static constexpr std::size_t BlockWords = 32;
+	static constexpr std::uint64_t BlockBits = BlockWords * 64;
+	using Block = std::array<std::uint64_t, BlockWords>;
+
+	std::uint64_t m_firstDocId;
+	std::vector<std::shared_ptr<const Block>> m_blocks;
+	// Блоки, скопированные этой картой: их можно менять на месте
+	std::vector<bool> m_isOwned;
+	std::size_t m_count = 0;
+};
\ No newline at end of file
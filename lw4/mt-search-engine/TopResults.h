@@ -0,0 +1,57 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Лучшие k результатов: куча с худшим результатом на вершине, порог — его оценка, пока куча полна
+class TopResults
+{
+public:
+	explicit TopResults(std::size_t capacity)
+		: m_capacity(capacity)
+	{
+		m_heap.reserve(capacity);
+	}
+
+	double GetThreshold() const
+	{
+		return m_heap.size() < m_capacity ? 0.0 : m_heap.front().second;
+	}
+
+	bool Push(std::uint64_t docId, double score)
+	{
+		if (m_heap.size() < m_capacity)
+		{
+			m_heap.emplace_back(docId, score);
+			std::push_heap(m_heap.begin(), m_heap.end(), IsBetter);
+			return true;
+		}
+		if (!IsBetter({ docId, score }, m_heap.front()))
+		{
+			return false;
+		}
+		std::pop_heap(m_heap.begin(), m_heap.end(), IsBetter);
+		m_heap.back() = { docId, score };
+		std::push_heap(m_heap.begin(), m_heap.end(), IsBetter);
+		return true;
+	}
+
+	std::vector<std::pair<std::uint64_t, double>> TakeSorted()
+	{
+		std::sort_heap(m_heap.begin(), m_heap.end(), IsBetter);
+		return std::move(m_heap);
+	}
+
+private:
+	// При равной оценке выше стоит документ с меньшим id
+	static bool IsBetter(const std::pair<std::uint64_t, double>& a, const std::pair<std::uint64_t, double>& b)
+	{
+		return a.second > b.second || (a.second == b.second && a.first < b.first);
+	}
+
+	std::size_t m_capacity;
+	std::vector<std::pair<std::uint64_t, double>> m_heap;
+};
\ No newline at end of file
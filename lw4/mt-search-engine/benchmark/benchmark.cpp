@@ -0,0 +1,109 @@
+#include "Tokenizer.h"
+
+#include <benchmark/benchmark.h>
+#include <cctype>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+static constexpr size_t TextSize = 4 * 1024 * 1024;
+
+// Текст, похожий на исходники и документацию: слова разной длины и регистра,
+// разделённые пробелами, пунктуацией и переводами строк
+static const std::string& GetText()
+{
+	static const std::string text = [] {
+		static constexpr std::string_view Separators = " \n\t.,;:()[]{}=+-*/\"'0123456789_";
+		std::mt19937 random(42);
+		std::uniform_int_distribution<int> wordLength(1, 12);
+		std::uniform_int_distribution<int> letter(0, 25);
+		std::uniform_int_distribution<int> upper(0, 9);
+		std::uniform_int_distribution<size_t> separator(0, Separators.size() - 1);
+
+		std::string result;
+		result.reserve(TextSize + 16);
+		while (result.size() < TextSize)
+		{
+			for (int i = wordLength(random); i > 0; --i)
+			{
+				result += static_cast<char>((upper(random) == 0 ? 'A' : 'a') + letter(random));
+			}
+			result += Separators[separator(random)];
+		}
+		return result;
+	}();
+	return text;
+}
+
+// Прежний посимвольный токенизатор: isalpha/tolower и отдельная строка на каждое слово
+static std::vector<std::string> ExtractWordsScalar(const std::string& text)
+{
+	std::vector<std::string> words;
+	std::string current;
+	for (const char ch : text)
+	{
+		if (std::isalpha(static_cast<unsigned char>(ch)))
+		{
+			current += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+		}
+		else if (!current.empty())
+		{
+			words.push_back(std::move(current));
+			current.clear();
+		}
+	}
+	if (!current.empty())
+	{
+		words.push_back(std::move(current));
+	}
+	return words;
+}
+
+void BM_ScalarExtractWords(benchmark::State& state)
+{
+	const auto& text = GetText();
+	for (auto _ : state)
+	{
+		auto words = ExtractWordsScalar(text);
+		benchmark::DoNotOptimize(words.data());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+void BM_ExtractWords(benchmark::State& state)
+{
+	const auto& text = GetText();
+	for (auto _ : state)
+	{
+		auto words = Tokenizer::ExtractWords(text);
+		benchmark::DoNotOptimize(words.data());
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+// Копия текста не входит в замер: на индексации токенизатор получает уже прочитанный буфер
+void BM_ForEachWord(benchmark::State& state)
+{
+	const auto& text = GetText();
+	std::string buffer;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		buffer = text;
+		state.ResumeTiming();
+
+		size_t wordCount = 0;
+		Tokenizer::ForEachWord(buffer, [&wordCount](std::string_view word) {
+			wordCount += word.size() != 0;
+		});
+		benchmark::DoNotOptimize(wordCount);
+	}
+	state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+
+BENCHMARK(BM_ScalarExtractWords)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ExtractWords)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ForEachWord)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
\ No newline at end of file
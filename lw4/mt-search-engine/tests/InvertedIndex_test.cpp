@@ -0,0 +1,387 @@
+#include "InvertedIndex.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <iterator>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace
+{
+using Results = std::vector<std::pair<std::uint64_t, double>>;
+
+void AddText(InvertedIndex& index, std::uint64_t docId, const std::string& path, std::string text, FileVersion version = {})
+{
+	index.AddDocument(docId, path, std::span<char>(text), version);
+}
+
+std::vector<std::uint64_t> GetDocIds(const Results& results)
+{
+	std::vector<std::uint64_t> ids;
+	for (const auto& [docId, score] : results)
+	{
+		ids.push_back(docId);
+	}
+	return ids;
+}
+
+// N = 3, средняя длина документа 3
+void AddFruitDocuments(InvertedIndex& index)
+{
+	AddText(index, 1, "/docs/1.txt", "apple banana apple");
+	AddText(index, 2, "/docs/2.txt", "banana cherry");
+	AddText(index, 3, "/docs/3.txt", "cherry cherry cherry date");
+}
+
+std::string GetNumberedPath(std::size_t n)
+{
+	return "/docs/" + std::to_string(n) + ".txt";
+}
+
+// Слово из одних букв, встречающееся только в документе n: слова индекса не содержат цифр
+std::string GetUniqueTerm(std::size_t n)
+{
+	std::string term = "uniq";
+	for (; n != 0; n /= 26)
+	{
+		term += static_cast<char>('a' + n % 26);
+	}
+	return term;
+}
+
+void AddNumbered(InvertedIndex& index, std::uint64_t docId, std::size_t n, const std::string& extra = "")
+{
+	AddText(index, docId, GetNumberedPath(n), "common " + GetUniqueTerm(n) + " " + extra,
+		FileVersion{ static_cast<std::int64_t>(docId), n, 0 });
+}
+
+// Файл во временном каталоге, удаляемый вместе с объектом
+class TempFile
+{
+public:
+	explicit TempFile(const std::string& name)
+		: m_path(std::filesystem::temp_directory_path() / ("mt-search-engine-test-" + name))
+	{
+	}
+
+	~TempFile()
+	{
+		std::error_code error;
+		std::filesystem::remove(m_path, error);
+	}
+
+	std::string GetPath() const
+	{
+		return m_path.string();
+	}
+
+	std::vector<char> Read() const
+	{
+		std::ifstream in(m_path, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+
+	void Write(const std::vector<char>& bytes) const
+	{
+		std::ofstream out(m_path, std::ios::binary | std::ios::trunc);
+		out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+	}
+
+private:
+	std::filesystem::path m_path;
+};
+} // namespace
+
+TEST(InvertedIndexTest, Bm25MatchesHandComputedScores)
+{
+	InvertedIndex index;
+	index.SetRankingModel(RankingModel::Bm25);
+	AddFruitDocuments(index);
+
+	// k1 = 1.2, b = 0.75. apple: df = 1, idf = ln(1 + 2.5 / 1.5) = ln(8/3).
+	// Документ 1: tf = 2, длина 3 — 2 * 2.2 / (2 + 1.2) = 1.375
+	const auto apple = index.Search({ "apple" });
+	ASSERT_EQ(1u, apple.size());
+	EXPECT_EQ(1u, apple[0].first);
+	EXPECT_NEAR(1.375 * std::log(8.0 / 3.0), apple[0].second, 1e-9);
+
+	// banana и cherry: df = 2, idf = ln(1 + 1.5 / 2.5) = ln(1.6).
+	// Документ 2: по 2.2 / (1 + 1.2 * (0.25 + 0.75 * 2 / 3)) = 2.2 / 1.9 на каждый терм.
+	// Документ 3: cherry tf = 3, длина 4 — 6.6 / (3 + 1.2 * 1.25) = 6.6 / 4.5.
+	// Документ 1: banana tf = 1, длина 3 — 2.2 / 2.2 = 1
+	const double idf = std::log(1.6);
+	const auto results = index.Search({ "banana", "cherry" });
+	ASSERT_EQ(3u, results.size());
+	EXPECT_EQ((std::vector<std::uint64_t>{ 2, 3, 1 }), GetDocIds(results));
+	EXPECT_NEAR(2 * idf * 2.2 / 1.9, results[0].second, 1e-9);
+	EXPECT_NEAR(idf * 6.6 / 4.5, results[1].second, 1e-9);
+	EXPECT_NEAR(idf, results[2].second, 1e-9);
+}
+
+TEST(InvertedIndexTest, RepeatedQueryTermMultipliesWeight)
+{
+	InvertedIndex index;
+	index.SetRankingModel(RankingModel::Bm25);
+	AddFruitDocuments(index);
+
+	const auto once = index.Search({ "apple" });
+	const auto twice = index.Search({ "apple", "apple" });
+	ASSERT_EQ(1u, once.size());
+	ASSERT_EQ(1u, twice.size());
+	EXPECT_NEAR(2 * once[0].second, twice[0].second, 1e-9);
+}
+
+TEST(InvertedIndexTest, TfIdfMatchesHandComputedScores)
+{
+	InvertedIndex index;
+	index.SetRankingModel(RankingModel::TfIdf);
+	AddFruitDocuments(index);
+
+	// idf = ln(N / df), вклад — idf * tf / длина документа
+	const auto results = index.Search({ "cherry" });
+	ASSERT_EQ(2u, results.size());
+	EXPECT_EQ((std::vector<std::uint64_t>{ 3, 2 }), GetDocIds(results));
+	EXPECT_NEAR(std::log(1.5) * 3.0 / 4.0, results[0].second, 1e-9);
+	EXPECT_NEAR(std::log(1.5) * 1.0 / 2.0, results[1].second, 1e-9);
+}
+
+TEST(InvertedIndexTest, TermInEveryDocumentDoesNotScore)
+{
+	InvertedIndex index;
+	index.SetRankingModel(RankingModel::TfIdf);
+	AddText(index, 1, "/a.txt", "common rare");
+	AddText(index, 2, "/b.txt", "common");
+	EXPECT_EQ((std::vector<std::uint64_t>{ 1 }), GetDocIds(index.Search({ "common", "rare" })));
+	EXPECT_TRUE(index.Search({ "missing" }).empty());
+}
+
+TEST(InvertedIndexTest, SaveLoadRoundTrip)
+{
+	TempFile file("round-trip");
+	InvertedIndex saved;
+	saved.SetRankingModel(RankingModel::Bm25);
+	AddFruitDocuments(saved);
+	AddText(saved, 4, "/docs/sub/4.txt", "date elderberry", FileVersion{ 42, 15, 7 });
+	saved.RemoveDocument("/docs/1.txt");
+	saved.Save(file.GetPath());
+
+	InvertedIndex loaded;
+	loaded.SetRankingModel(RankingModel::Bm25);
+	AddText(loaded, 1, "/other.txt", "replaced by load");
+	EXPECT_EQ(4u, loaded.Load(file.GetPath()));
+
+	EXPECT_FALSE(loaded.HasDocument("/other.txt"));
+	EXPECT_FALSE(loaded.HasDocument("/docs/1.txt"));
+	EXPECT_TRUE(loaded.HasDocument("/docs/2.txt"));
+	EXPECT_EQ("/docs/sub/4.txt", loaded.GetPathById(4));
+	const auto version = loaded.GetDocumentVersion("/docs/sub/4.txt");
+	ASSERT_TRUE(version.has_value());
+	EXPECT_EQ(42, version->modificationTime);
+	EXPECT_EQ(15u, version->size);
+	EXPECT_EQ(7u, version->contentHash);
+
+	for (const auto& query : std::vector<std::vector<std::string>>{ { "cherry" }, { "date", "banana" }, { "elderberry" }, { "apple" } })
+	{
+		const auto expected = saved.Search(query);
+		const auto actual = loaded.Search(query);
+		ASSERT_EQ(GetDocIds(expected), GetDocIds(actual));
+		for (std::size_t i = 0; i < expected.size(); ++i)
+		{
+			EXPECT_NEAR(expected[i].second, actual[i].second, 1e-9);
+		}
+	}
+	EXPECT_EQ(saved.SearchSubstring("erry"), loaded.SearchSubstring("erry"));
+
+	// Документы, добавленные после загрузки, ищутся вместе с загруженными
+	AddText(loaded, 5, "/docs/5.txt", "cherry");
+	EXPECT_EQ(3u, loaded.Search({ "cherry" }).size());
+}
+
+TEST(InvertedIndexTest, LoadRejectsCorruptSegments)
+{
+	TempFile file("corrupt");
+	InvertedIndex saved;
+	AddFruitDocuments(saved);
+	saved.Save(file.GetPath());
+	const auto bytes = file.Read();
+	ASSERT_GT(bytes.size(), 64u);
+
+	InvertedIndex index;
+	AddText(index, 1, "/kept.txt", "kept");
+	const auto expectLoadFails = [&](const std::vector<char>& corrupted) {
+		file.Write(corrupted);
+		EXPECT_THROW(index.Load(file.GetPath()), std::runtime_error);
+		// Неудачная загрузка не трогает текущее содержимое индекса
+		EXPECT_TRUE(index.HasDocument("/kept.txt"));
+	};
+
+	auto badMagic = bytes;
+	badMagic[0] ^= 0x55;
+	expectLoadFails(badMagic);
+
+	auto badVersion = bytes;
+	badVersion[8] ^= 0x55;
+	expectLoadFails(badVersion);
+
+	expectLoadFails(std::vector<char>(bytes.begin(), bytes.begin() + 16));
+	expectLoadFails(std::vector<char>(bytes.begin(), bytes.begin() + static_cast<std::ptrdiff_t>(bytes.size() / 2)));
+
+	EXPECT_THROW(index.Load(file.GetPath() + ".missing"), std::runtime_error);
+}
+
+TEST(InvertedIndexTest, FlushedSegmentsKeepDeletesAndReplacements)
+{
+	constexpr std::size_t Count = 2 * InvertedIndex::MemorySegmentDocLimit + 500;
+	InvertedIndex index;
+	for (std::size_t n = 1; n <= Count; ++n)
+	{
+		AddNumbered(index, n, n);
+	}
+	// Удаляются и заменяются документы и неизменяемых сегментов, и изменяемого
+	std::size_t live = Count;
+	for (std::size_t n = 3; n <= Count; n += 3)
+	{
+		index.RemoveDocument(GetNumberedPath(n));
+		--live;
+	}
+	for (std::size_t n = 5; n <= Count; n += 5)
+	{
+		if (n % 3 != 0)
+		{
+			AddNumbered(index, Count + n, n, "replaced");
+		}
+	}
+
+	const auto check = [&](const InvertedIndex& target) {
+		EXPECT_EQ(live, target.GetIndexedDocuments().size());
+		for (std::size_t n = 1; n <= Count; ++n)
+		{
+			const auto version = target.GetDocumentVersion(GetNumberedPath(n));
+			const auto hits = target.Search({ GetUniqueTerm(n) });
+			if (n % 3 == 0)
+			{
+				EXPECT_FALSE(version.has_value()) << n;
+				EXPECT_TRUE(hits.empty()) << n;
+				continue;
+			}
+			const std::uint64_t docId = n % 5 == 0 ? Count + n : n;
+			ASSERT_TRUE(version.has_value()) << n;
+			EXPECT_EQ(static_cast<std::int64_t>(docId), version->modificationTime) << n;
+			EXPECT_EQ((std::vector<std::uint64_t>{ docId }), GetDocIds(hits)) << n;
+		}
+	};
+	check(index);
+
+	TempFile file("flushed");
+	index.Save(file.GetPath());
+	InvertedIndex loaded;
+	loaded.Load(file.GetPath());
+	check(loaded);
+}
+
+TEST(InvertedIndexTest, ConcurrentDeletesDuringFlushAndMerge)
+{
+	constexpr std::size_t Count = 6 * InvertedIndex::MemorySegmentDocLimit;
+	ThreadPool mergePool(1);
+	InvertedIndex index(3, InvertedIndex::DefaultShardCount, nullptr, &mergePool);
+	std::atomic<std::uint64_t> nextDocId{ 1 };
+	const auto waitAdded = [&index](std::size_t n) {
+		while (!index.HasDocument(GetNumberedPath(n)))
+		{
+			std::this_thread::yield();
+		}
+	};
+
+	// Удаления и замены идут вслед за добавлением, пока сегменты сбрасываются и сливаются в фоне
+	std::jthread writer([&] {
+		for (std::size_t n = 1; n <= Count; ++n)
+		{
+			AddNumbered(index, nextDocId.fetch_add(1), n);
+		}
+	});
+	std::jthread deleter([&] {
+		for (std::size_t n = 2; n <= Count; n += 2)
+		{
+			waitAdded(n);
+			index.RemoveDocument(GetNumberedPath(n));
+		}
+	});
+	std::vector<std::uint64_t> replacedIds(Count + 1);
+	std::jthread replacer([&] {
+		for (std::size_t n = 7; n <= Count; n += 14)
+		{
+			waitAdded(n);
+			replacedIds[n] = nextDocId.fetch_add(1);
+			AddNumbered(index, replacedIds[n], n, "replaced");
+		}
+	});
+	writer.join();
+	deleter.join();
+	replacer.join();
+
+	std::size_t live = 0;
+	for (std::size_t n = 1; n <= Count; ++n)
+	{
+		const auto hits = index.Search({ GetUniqueTerm(n) });
+		if (n % 2 == 0)
+		{
+			EXPECT_FALSE(index.HasDocument(GetNumberedPath(n))) << n;
+			EXPECT_TRUE(hits.empty()) << n;
+			continue;
+		}
+		++live;
+		ASSERT_EQ(1u, hits.size()) << n;
+		if (replacedIds[n] != 0)
+		{
+			EXPECT_EQ(replacedIds[n], hits[0].first) << n;
+		}
+	}
+	EXPECT_EQ(live, index.GetIndexedDocuments().size());
+	EXPECT_FALSE(index.TakeMergeError().has_value());
+}
+
+TEST(InvertedIndexTest, PhraseAndNearMatchWordPositions)
+{
+	InvertedIndex index;
+	AddText(index, 1, "/docs/1.txt", "The quick brown fox jumps");
+	AddText(index, 2, "/docs/2.txt", "brown, the quick fox");
+	AddText(index, 3, "/docs/3.txt", "lazy dog sleeps");
+
+	const auto search = [](const InvertedIndex& target, PositionalQuery::Kind kind, std::vector<std::string> terms,
+							std::size_t distance = 0) {
+		auto ids = GetDocIds(target.SearchPositional(PositionalQuery{ kind, std::move(terms), distance }));
+		std::ranges::sort(ids);
+		return ids;
+	};
+	const auto check = [&](const InvertedIndex& target) {
+		using Ids = std::vector<std::uint64_t>;
+		using enum PositionalQuery::Kind;
+		EXPECT_EQ((Ids{ 1 }), search(target, Phrase, { "quick", "brown" }));
+		EXPECT_EQ((Ids{ 2 }), search(target, Phrase, { "brown", "the", "quick" }));
+		EXPECT_EQ((Ids{ 1, 2 }), search(target, Phrase, { "the", "quick" }));
+		EXPECT_EQ(Ids{}, search(target, Phrase, { "fox", "quick" }));
+		EXPECT_EQ(Ids{}, search(target, Phrase, { "quick", "dog" }));
+
+		EXPECT_EQ((Ids{ 1, 2 }), search(target, Near, { "quick", "fox" }, 2));
+		EXPECT_EQ((Ids{ 2 }), search(target, Near, { "quick", "fox" }, 1));
+		// Порядок слов для NEAR не важен
+		EXPECT_EQ((Ids{ 2 }), search(target, Near, { "fox", "quick" }, 1));
+		EXPECT_EQ((Ids{ 1 }), search(target, Near, { "brown", "jumps" }, 2));
+		EXPECT_EQ(Ids{}, search(target, Near, { "brown", "jumps" }, 1));
+	};
+	check(index);
+
+	TempFile file("positional");
+	index.Save(file.GetPath());
+	InvertedIndex loaded;
+	loaded.Load(file.GetPath());
+	check(loaded);
+}
\ No newline at end of file
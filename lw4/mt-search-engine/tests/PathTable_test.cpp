@@ -0,0 +1,176 @@
+#include "PathTable.h"
+#include "EpochReclaimer.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Paths = std::vector<std::string>;
+
+// Путь читается под закреплением эпохи, как это делает индекс
+std::string GetPath(EpochReclaimer& reclaimer, const PathTable& table, std::uint64_t docId)
+{
+	const auto guard = reclaimer.Pin();
+	return table.GetPath(docId);
+}
+
+Paths GetSortedPaths(const PathTable& table, const std::string& dir, bool recursive)
+{
+	auto paths = table.GetPathsInDirectory(dir, recursive);
+	std::ranges::sort(paths);
+	return paths;
+}
+} // namespace
+
+TEST(PathTableTest, ResolvesPathsSharingPrefixes)
+{
+	EpochReclaimer reclaimer;
+	PathTable table(reclaimer);
+	table.Add(1, "/home/user/docs/a.txt");
+	table.Add(2, "/home/user/docs/b.txt");
+	table.Add(3, "/home/user/notes.md");
+	table.Add(4, "relative/c.txt");
+
+	EXPECT_EQ("/home/user/docs/a.txt", GetPath(reclaimer, table, 1));
+	EXPECT_EQ("/home/user/docs/b.txt", GetPath(reclaimer, table, 2));
+	EXPECT_EQ("/home/user/notes.md", GetPath(reclaimer, table, 3));
+	EXPECT_EQ("relative/c.txt", GetPath(reclaimer, table, 4));
+	EXPECT_EQ("", GetPath(reclaimer, table, 5));
+	EXPECT_EQ("", GetPath(reclaimer, table, 100'000));
+}
+
+TEST(PathTableTest, RemovedPathCanBeAddedUnderNewId)
+{
+	EpochReclaimer reclaimer;
+	PathTable table(reclaimer);
+	table.Add(1, "/docs/a.txt");
+	table.Add(2, "/docs/b.txt");
+	table.Remove(1);
+	EXPECT_EQ("", GetPath(reclaimer, table, 1));
+	EXPECT_EQ((Paths{ "/docs/b.txt" }), GetSortedPaths(table, "/docs", false));
+
+	table.Add(3, "/docs/a.txt");
+	EXPECT_EQ("", GetPath(reclaimer, table, 1));
+	EXPECT_EQ("/docs/a.txt", GetPath(reclaimer, table, 3));
+	EXPECT_EQ((Paths{ "/docs/a.txt", "/docs/b.txt" }), GetSortedPaths(table, "/docs", false));
+
+	// Повторное удаление ничего не меняет
+	table.Remove(1);
+	EXPECT_EQ((Paths{ "/docs/a.txt", "/docs/b.txt" }), GetSortedPaths(table, "/docs", false));
+}
+
+TEST(PathTableTest, RemovingOldIdKeepsPathTakenByNewId)
+{
+	EpochReclaimer reclaimer;
+	PathTable table(reclaimer);
+	table.Add(1, "/docs/a.txt");
+	// Новая версия файла получает путь раньше, чем снимается старая
+	table.Add(2, "/docs/a.txt");
+	table.Remove(1);
+	EXPECT_EQ("/docs/a.txt", GetPath(reclaimer, table, 2));
+	EXPECT_EQ((Paths{ "/docs/a.txt" }), GetSortedPaths(table, "/docs", false));
+}
+
+TEST(PathTableTest, AddingExistingIdMovesPath)
+{
+	EpochReclaimer reclaimer;
+	PathTable table(reclaimer);
+	table.Add(1, "/old/dir/a.txt");
+	table.Add(1, "/new/a.txt");
+	EXPECT_EQ("/new/a.txt", GetPath(reclaimer, table, 1));
+	EXPECT_TRUE(table.GetPathsInDirectory("/old", true).empty());
+	EXPECT_EQ((Paths{ "/new/a.txt" }), GetSortedPaths(table, "/", true));
+}
+
+TEST(PathTableTest, EmptiedDirectoryCanBeFilledAgain)
+{
+	EpochReclaimer reclaimer;
+	PathTable table(reclaimer);
+	table.Add(1, "/a/b/c.txt");
+	table.Add(2, "/a/keep.txt");
+	table.Remove(1);
+	EXPECT_TRUE(table.GetPathsInDirectory("/a/b", true).empty());
+	EXPECT_EQ((Paths{ "/a/keep.txt" }), GetSortedPaths(table, "/a", true));
+
+	table.Add(3, "/a/b/d.txt");
+	EXPECT_EQ("/a/b/d.txt", GetPath(reclaimer, table, 3));
+	EXPECT_EQ((Paths{ "/a/b/d.txt" }), GetSortedPaths(table, "/a/b", false));
+
+	// Снимается вся цепочка опустевших каталогов
+	table.Remove(2);
+	table.Remove(3);
+	EXPECT_TRUE(table.GetPathsInDirectory("/", true).empty());
+	table.Add(4, "/a/b/c.txt");
+	EXPECT_EQ("/a/b/c.txt", GetPath(reclaimer, table, 4));
+	EXPECT_EQ((Paths{ "/a/b/c.txt" }), GetSortedPaths(table, "/a", true));
+}
+
+TEST(PathTableTest, ListsDirectoryWithOrWithoutSubdirectories)
+{
+	EpochReclaimer reclaimer;
+	PathTable table(reclaimer);
+	table.Add(1, "/root/x.txt");
+	table.Add(2, "/root/sub/y.txt");
+	table.Add(3, "/root/sub/deep/z.txt");
+	table.Add(4, "/rootless/w.txt");
+
+	EXPECT_EQ((Paths{ "/root/x.txt" }), GetSortedPaths(table, "/root", false));
+	const Paths tree{ "/root/sub/deep/z.txt", "/root/sub/y.txt", "/root/x.txt" };
+	EXPECT_EQ(tree, GetSortedPaths(table, "/root", true));
+	EXPECT_EQ(tree, GetSortedPaths(table, "/root/", true));
+	EXPECT_EQ((Paths{ "/root/sub/deep/z.txt", "/root/sub/y.txt" }), GetSortedPaths(table, "/root/sub", true));
+	EXPECT_EQ(4u, table.GetPathsInDirectory("/", true).size());
+	EXPECT_TRUE(table.GetPathsInDirectory("/", false).empty());
+	EXPECT_TRUE(table.GetPathsInDirectory("/ro", true).empty());
+	EXPECT_TRUE(table.GetPathsInDirectory("/missing", true).empty());
+}
+
+TEST(PathTableTest, ReadersSeeWholePathsWhileEntriesAreReplaced)
+{
+	constexpr std::uint64_t DocCount = 64;
+	constexpr int Rounds = 200;
+	EpochReclaimer reclaimer;
+	PathTable table(reclaimer);
+	const auto expectedPath = [](std::uint64_t docId) {
+		return "/dir" + std::to_string(docId % 4) + "/sub/file" + std::to_string(docId);
+	};
+	for (std::uint64_t docId = 0; docId < DocCount; ++docId)
+	{
+		table.Add(docId, expectedPath(docId));
+	}
+
+	// Читатель может увидеть документ удалённым, но не чужой или недособранный путь
+	std::atomic<bool> done{ false };
+	std::atomic<std::size_t> mismatches{ 0 };
+	std::jthread reader([&] {
+		while (!done.load())
+		{
+			for (std::uint64_t docId = 0; docId < DocCount; ++docId)
+			{
+				const auto path = GetPath(reclaimer, table, docId);
+				if (!path.empty() && path != expectedPath(docId))
+				{
+					mismatches.fetch_add(1);
+				}
+			}
+		}
+	});
+	for (int round = 0; round < Rounds; ++round)
+	{
+		for (std::uint64_t docId = 0; docId < DocCount; ++docId)
+		{
+			table.Remove(docId);
+			table.Add(docId, expectedPath(docId));
+		}
+	}
+	done.store(true);
+	reader.join();
+
+	EXPECT_EQ(0u, mismatches.load());
+	EXPECT_EQ(DocCount, table.GetPathsInDirectory("/", true).size());
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "QueryCache.h"
+#include "InvertedIndex.h"
+#include <cstdint>
+#include <functional>
+#include <gtest/gtest.h>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace
+{
+const QueryCache::Results SomeResults{ { 1, 2.5 }, { 7, 0.5 } };
+
+// Ключи, попадающие в тот же шард, что и key: вытеснение идёт внутри шарда
+std::vector<std::string> GetKeysOfSameShard(const std::string& key, std::size_t count)
+{
+	const auto shard = std::hash<std::string>{}(key) % QueryCache::ShardCount;
+	std::vector<std::string> keys;
+	for (std::size_t i = 0; keys.size() < count; ++i)
+	{
+		auto candidate = key + std::to_string(i);
+		if (std::hash<std::string>{}(candidate) % QueryCache::ShardCount == shard)
+		{
+			keys.push_back(std::move(candidate));
+		}
+	}
+	return keys;
+}
+} // namespace
+
+TEST(QueryCacheTest, FindReturnsResultsOfSameGeneration)
+{
+	QueryCache cache;
+	EXPECT_FALSE(cache.Find("apple", 1).has_value());
+	cache.Insert("apple", 1, SomeResults);
+	const auto found = cache.Find("apple", 1);
+	ASSERT_TRUE(found.has_value());
+	EXPECT_EQ(SomeResults, *found);
+
+	const auto stats = cache.GetStats();
+	EXPECT_EQ(1u, stats.entries);
+	EXPECT_EQ(1u, stats.hits);
+	EXPECT_EQ(1u, stats.misses);
+	EXPECT_EQ(0u, stats.stale);
+}
+
+TEST(QueryCacheTest, EntryOfOtherGenerationIsStaleAndRemoved)
+{
+	QueryCache cache;
+	cache.Insert("apple", 1, SomeResults);
+	EXPECT_FALSE(cache.Find("apple", 2).has_value());
+
+	auto stats = cache.GetStats();
+	EXPECT_EQ(0u, stats.entries);
+	EXPECT_EQ(1u, stats.misses);
+	EXPECT_EQ(1u, stats.stale);
+
+	// Устаревшая запись удалена, а не оставлена для прежнего поколения
+	EXPECT_FALSE(cache.Find("apple", 1).has_value());
+	stats = cache.GetStats();
+	EXPECT_EQ(2u, stats.misses);
+	EXPECT_EQ(1u, stats.stale);
+	EXPECT_EQ(0u, stats.hits);
+}
+
+TEST(QueryCacheTest, InsertKeepsNewerGeneration)
+{
+	QueryCache cache;
+	cache.Insert("apple", 3, SomeResults);
+	cache.Insert("apple", 2, {});
+	EXPECT_EQ(SomeResults, cache.Find("apple", 3));
+
+	cache.Insert("apple", 4, {});
+	EXPECT_EQ(QueryCache::Results{}, cache.Find("apple", 4));
+	EXPECT_EQ(1u, cache.GetStats().entries);
+}
+
+TEST(QueryCacheTest, EvictsLeastRecentlyUsedEntry)
+{
+	QueryCache cache(2 * QueryCache::ShardCount);
+	EXPECT_EQ(2 * QueryCache::ShardCount, cache.GetStats().capacity);
+	const auto keys = GetKeysOfSameShard("query", 3);
+	cache.Insert(keys[0], 1, SomeResults);
+	cache.Insert(keys[1], 1, SomeResults);
+	ASSERT_TRUE(cache.Find(keys[0], 1).has_value());
+
+	cache.Insert(keys[2], 1, SomeResults);
+	EXPECT_TRUE(cache.Find(keys[0], 1).has_value());
+	EXPECT_FALSE(cache.Find(keys[1], 1).has_value());
+	EXPECT_TRUE(cache.Find(keys[2], 1).has_value());
+	EXPECT_EQ(2u, cache.GetStats().entries);
+}
+
+TEST(QueryCacheTest, IndexChangesInvalidateCachedResults)
+{
+	InvertedIndex index;
+	QueryCache cache;
+	std::string text = "apple banana";
+	index.AddDocument(1, "/docs/1.txt", std::span<char>(text), {});
+
+	const auto before = index.GetGeneration();
+	cache.Insert("apple", before, index.Search({ "apple" }));
+	EXPECT_TRUE(cache.Find("apple", index.GetGeneration()).has_value());
+
+	text = "apple cherry";
+	index.AddDocument(2, "/docs/2.txt", std::span<char>(text), {});
+	const auto afterAdd = index.GetGeneration();
+	EXPECT_NE(before, afterAdd);
+	EXPECT_FALSE(cache.Find("apple", afterAdd).has_value());
+
+	cache.Insert("apple", afterAdd, index.Search({ "apple" }));
+	index.RemoveDocument("/docs/1.txt");
+	EXPECT_NE(afterAdd, index.GetGeneration());
+	EXPECT_FALSE(cache.Find("apple", index.GetGeneration()).has_value());
+	EXPECT_EQ(2u, cache.GetStats().stale);
+}
\ No newline at end of file
@@ -1,12 +1,18 @@
+#include "MpmcRingQueue.h"
+#include "SpscQueue.h"
 #include "ThreadSafeQueue.h"
 
 #include <benchmark/benchmark.h>
+#include <algorithm>
 #include <boost/lockfree/queue.hpp>
+#include <chrono>
 #include <thread>
 #include <vector>
 
 static constexpr size_t ItemsPerThread = 100'000;
 static constexpr size_t BoundedCapacity = 1024;
+static constexpr size_t BatchProducers = 2;
+static constexpr size_t BatchConsumers = 2;
 
 void BM_UnboundedThreadSafeQueue(benchmark::State& state)
 {
@@ -100,6 +106,198 @@ void BM_BoundedThreadSafeQueue(benchmark::State& state)
 	}
 }
 
+// Потребители спят в WaitAndPop, а не крутятся на TryPop; по окончании записи очередь закрывается
+void BM_BlockingThreadSafeQueue(benchmark::State& state)
+{
+	const size_t numProducers = state.range(0);
+	const size_t numConsumers = state.range(1);
+
+	for (auto _ : state)
+	{
+		ThreadSafeQueue<int> q(BoundedCapacity);
+		std::atomic<size_t> consumed{ 0 };
+		std::vector<std::jthread> consumers;
+		consumers.reserve(numConsumers);
+
+		for (size_t i = 0; i < numConsumers; ++i)
+		{
+			consumers.emplace_back([&q, &consumed] {
+				for (int val; q.WaitAndPop(val);)
+				{
+					consumed.fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+		}
+
+		{
+			std::vector<std::jthread> producers;
+			producers.reserve(numProducers);
+			for (size_t i = 0; i < numProducers; ++i)
+			{
+				producers.emplace_back([&q] {
+					for (size_t j = 0; j < ItemsPerThread; ++j)
+					{
+						q.Push(static_cast<int>(j));
+					}
+				});
+			}
+		}
+		q.Close();
+
+		for (auto& t : consumers)
+		{
+			t.join();
+		}
+		benchmark::DoNotOptimize(consumed.load());
+	}
+}
+
+// Производители и потребители передают элементы пачками по state.range(0)
+void BM_BatchedThreadSafeQueue(benchmark::State& state)
+{
+	const size_t batchSize = state.range(0);
+	const size_t totalItems = BatchProducers * ItemsPerThread;
+
+	for (auto _ : state)
+	{
+		ThreadSafeQueue<int> q(BoundedCapacity);
+		std::atomic<size_t> consumed{ 0 };
+		std::vector<std::jthread> threads;
+		threads.reserve(BatchProducers + BatchConsumers);
+
+		for (size_t i = 0; i < BatchProducers; ++i)
+		{
+			threads.emplace_back([&q, batchSize] {
+				std::vector<int> batch;
+				batch.reserve(batchSize);
+				for (size_t j = 0; j < ItemsPerThread; j += batchSize)
+				{
+					batch.clear();
+					for (size_t k = j; k < std::min(j + batchSize, ItemsPerThread); ++k)
+					{
+						batch.push_back(static_cast<int>(k));
+					}
+					q.PushRange(batch.begin(), batch.end());
+				}
+			});
+		}
+
+		for (size_t i = 0; i < BatchConsumers; ++i)
+		{
+			threads.emplace_back([&q, &consumed, totalItems, batchSize] {
+				std::vector<int> batch(batchSize);
+				while (consumed.load(std::memory_order_relaxed) < totalItems)
+				{
+					if (const size_t n = q.PopUpTo(batch.begin(), batchSize, std::chrono::milliseconds(1)))
+					{
+						consumed.fetch_add(n, std::memory_order_relaxed);
+					}
+				}
+			});
+		}
+
+		for (auto& t : threads)
+		{
+			t.join();
+		}
+		benchmark::DoNotOptimize(consumed.load());
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * totalItems));
+}
+
+// Потребители спят в WaitAndPop, а не крутятся на TryPop. Закрытия у очереди нет,
+// поэтому по окончании записи каждый потребитель получает отрицательное значение
+void BM_MpmcRingQueue(benchmark::State& state)
+{
+	const size_t numProducers = state.range(0);
+	const size_t numConsumers = state.range(1);
+
+	for (auto _ : state)
+	{
+		MpmcRingQueue<int> q(BoundedCapacity);
+		std::atomic<size_t> consumed{ 0 };
+		std::vector<std::jthread> consumers;
+		consumers.reserve(numConsumers);
+
+		for (size_t i = 0; i < numConsumers; ++i)
+		{
+			consumers.emplace_back([&q, &consumed] {
+				while (true)
+				{
+					int val;
+					q.WaitAndPop(val);
+					if (val < 0)
+					{
+						break;
+					}
+					consumed.fetch_add(1, std::memory_order_relaxed);
+				}
+			});
+		}
+
+		{
+			std::vector<std::jthread> producers;
+			producers.reserve(numProducers);
+			for (size_t i = 0; i < numProducers; ++i)
+			{
+				producers.emplace_back([&q] {
+					for (size_t j = 0; j < ItemsPerThread; ++j)
+					{
+						q.Push(static_cast<int>(j));
+					}
+				});
+			}
+		}
+		for (size_t i = 0; i < numConsumers; ++i)
+		{
+			q.Push(-1);
+		}
+
+		for (auto& t : consumers)
+		{
+			t.join();
+		}
+		benchmark::DoNotOptimize(consumed.load());
+	}
+}
+
+// Один производитель и один потребитель, потребитель спит в WaitAndPop. Запускается
+// для ThreadSafeQueue и SpscQueue, чтобы сравнить их на одинаковой нагрузке
+template <typename Queue>
+void BM_SingleProducerSingleConsumer(benchmark::State& state)
+{
+	for (auto _ : state)
+	{
+		Queue q(BoundedCapacity);
+		size_t consumed = 0;
+
+		std::jthread consumer([&q, &consumed] {
+			while (true)
+			{
+				int val;
+				q.WaitAndPop(val);
+				if (val < 0)
+				{
+					break;
+				}
+				++consumed;
+			}
+		});
+		std::jthread producer([&q] {
+			for (size_t j = 0; j < ItemsPerThread; ++j)
+			{
+				q.Push(static_cast<int>(j));
+			}
+			q.Push(-1);
+		});
+
+		producer.join();
+		consumer.join();
+		benchmark::DoNotOptimize(consumed);
+	}
+	state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * ItemsPerThread));
+}
+
 void BM_BoostLockfreeQueue(benchmark::State& state)
 {
 	const size_t numProducers = state.range(0);
@@ -161,6 +359,36 @@ BENCHMARK(BM_BoundedThreadSafeQueue)
 	->Args({ 8, 8 })
 	->Threads(1);
 
+BENCHMARK(BM_BlockingThreadSafeQueue)
+	->Args({ 1, 1 })
+	->Args({ 2, 2 })
+	->Args({ 4, 4 })
+	->Args({ 8, 8 })
+	->Threads(1);
+
+BENCHMARK(BM_BatchedThreadSafeQueue)
+	->Arg(1)
+	->Arg(8)
+	->Arg(64)
+	->Arg(256)
+	->Threads(1)
+	->UseRealTime();
+
+BENCHMARK(BM_MpmcRingQueue)
+	->Args({ 1, 1 })
+	->Args({ 2, 2 })
+	->Args({ 4, 4 })
+	->Args({ 8, 8 })
+	->Threads(1);
+
+BENCHMARK_TEMPLATE(BM_SingleProducerSingleConsumer, ThreadSafeQueue<int>)
+	->Threads(1)
+	->UseRealTime();
+
+BENCHMARK_TEMPLATE(BM_SingleProducerSingleConsumer, SpscQueue<int>)
+	->Threads(1)
+	->UseRealTime();
+
 BENCHMARK(BM_BoostLockfreeQueue)
 	->Args({ 1, 1 })
 	->Args({ 2, 2 })
@@ -0,0 +1,34 @@
+#include "AsymmetricFence.h"
+
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace AsymmetricFence
+{
+bool RegisterHeavy() noexcept
+{
+#if defined(__linux__) && defined(SYS_membarrier)
+	const long commands = syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+	return commands >= 0 && (commands & MEMBARRIER_CMD_PRIVATE_EXPEDITED) != 0
+		&& syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+#else
+	return false;
+#endif
+}
+
+void Heavy() noexcept
+{
+#if defined(__linux__) && defined(SYS_membarrier)
+	if (IsHeavySupported())
+	{
+		// После успешной регистрации команда не отказывает
+		syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+		return;
+	}
+#endif
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+} // namespace AsymmetricFence
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <atomic>
+
+// Пара барьеров памяти, в которой вся стоимость перенесена на редкую сторону.
+// Light на частом пути — только барьер компилятора, Heavy через membarrier(2) заставляет
+// все потоки процесса выполнить полный барьер. Записи до Light и чтения после него
+// упорядочены относительно Heavy так же, как при seq_cst-барьерах с обеих сторон.
+// Если ядро не поддерживает membarrier, обе стороны — обычные seq_cst-барьеры
+namespace AsymmetricFence
+{
+bool RegisterHeavy() noexcept;
+
+inline bool IsHeavySupported() noexcept
+{
+	static const bool supported = RegisterHeavy();
+	return supported;
+}
+
+inline void Light() noexcept
+{
+	if (IsHeavySupported())
+	{
+		std::atomic_signal_fence(std::memory_order_seq_cst);
+	}
+	else
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+}
+
+void Heavy() noexcept;
+} // namespace AsymmetricFence
\ No newline at end of file
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+// Ограниченная lock-free MPMC очередь на кольцевом буфере (схема Вьюкова).
+// У каждой ячейки свой номер последовательности: производитель и потребитель
+// захватывают позицию одним CAS по своему индексу и больше не конкурируют.
+// Интерфейс повторяет ThreadSafeQueue, блокирующие операции сначала крутятся,
+// затем засыпают на std::atomic::wait (futex в Linux).
+template <typename T>
+class MpmcRingQueue
+{
+public:
+	explicit MpmcRingQueue(size_t capacity)
+		: m_capacity(RoundUpToPowerOfTwo(capacity))
+		, m_mask(m_capacity - 1)
+		, m_cells(std::make_unique<Cell[]>(m_capacity))
+	{
+		for (size_t i = 0; i < m_capacity; ++i)
+		{
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpmcRingQueue(const MpmcRingQueue&) = delete;
+	MpmcRingQueue& operator=(const MpmcRingQueue&) = delete;
+
+	~MpmcRingQueue()
+	{
+		const size_t head = m_head.value.load(std::memory_order_relaxed);
+		for (size_t pos = m_tail.value.load(std::memory_order_relaxed); pos != head; ++pos)
+		{
+			m_cells[pos & m_mask].Get()->~T();
+		}
+	}
+
+	void Push(const T& value)
+	{
+		PushImpl(value);
+	}
+	void Push(T&& value)
+	{
+		PushImpl(std::move(value));
+	}
+
+	[[nodiscard]] bool TryPush(const T& value)
+	{
+		return TryPushImpl(value);
+	}
+	[[nodiscard]] bool TryPush(T&& value)
+	{
+		return TryPushImpl(std::move(value));
+	}
+
+	bool TryPop(T& out)
+	{
+		return TryPopImpl([&](T& value) { out = std::move(value); });
+	}
+	std::unique_ptr<T> TryPop()
+	{
+		std::unique_ptr<T> out;
+		TryPopImpl([&](T& value) { out = std::make_unique<T>(std::move(value)); });
+		return out;
+	}
+
+	template <typename U = T>
+	std::enable_if_t<std::is_nothrow_move_constructible_v<U>, U>
+	WaitAndPop()
+	{
+		std::optional<T> out;
+		WaitFor(m_pushSignal, m_waitingConsumers, [&] {
+			return TryPopImpl([&](T& value) { out.emplace(std::move(value)); });
+		});
+		return std::move(*out);
+	}
+
+	void WaitAndPop(T& out)
+	{
+		WaitFor(m_pushSignal, m_waitingConsumers, [&] { return TryPop(out); });
+	}
+
+	// Размер приблизительный: индексы читаются без синхронизации между собой
+	size_t GetSize() const
+	{
+		const size_t head = m_head.value.load(std::memory_order_acquire);
+		const size_t tail = m_tail.value.load(std::memory_order_acquire);
+		return head > tail ? head - tail : 0;
+	}
+	size_t GetCapacity() const
+	{
+		return m_capacity;
+	}
+	bool IsEmpty() const
+	{
+		return GetSize() == 0;
+	}
+
+private:
+	static constexpr size_t CacheLineSize = 64;
+	static constexpr int SpinCount = 64;
+
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		alignas(T) std::byte storage[sizeof(T)];
+
+		T* Get()
+		{
+			return std::launder(reinterpret_cast<T*>(storage));
+		}
+	};
+
+	// Индексы головы и хвоста лежат в разных кэш-линиях, чтобы производители и потребители не делили линию
+	template <typename V>
+	struct alignas(CacheLineSize) Padded
+	{
+		std::atomic<V> value{ 0 };
+	};
+
+	static size_t RoundUpToPowerOfTwo(size_t capacity)
+	{
+		if (capacity == 0)
+		{
+			throw std::invalid_argument("MpmcRingQueue capacity must be positive");
+		}
+		// При одной ячейке номер «занята» совпадает с номером «свободна на следующем круге»
+		size_t result = 2;
+		while (result < capacity)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	static void CpuRelax()
+	{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+		_mm_pause();
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	template <typename U>
+	bool TryPushImpl(U&& value)
+	{
+		Cell* cell = nullptr;
+		size_t pos = m_head.value.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &m_cells[pos & m_mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (m_head.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_head.value.load(std::memory_order_relaxed);
+			}
+		}
+
+		::new (static_cast<void*>(cell->storage)) T(std::forward<U>(value));
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		NotifyOne(m_pushSignal, m_waitingConsumers);
+		return true;
+	}
+
+	template <typename Take>
+	bool TryPopImpl(Take&& take)
+	{
+		Cell* cell = nullptr;
+		size_t pos = m_tail.value.load(std::memory_order_relaxed);
+		while (true)
+		{
+			cell = &m_cells[pos & m_mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (m_tail.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_tail.value.load(std::memory_order_relaxed);
+			}
+		}
+
+		// Ячейка освобождается и при исключении из take: иначе на ней навсегда остановились бы
+		// все производители и потребители следующего круга. Значение в этом случае теряется
+		const CellRelease release{ *this, *cell, pos };
+		take(*cell->Get());
+		return true;
+	}
+
+	// Разрушает значение ячейки и отдаёт её производителю, который придёт на круг позже
+	struct CellRelease
+	{
+		MpmcRingQueue& queue;
+		Cell& cell;
+		size_t pos;
+
+		~CellRelease()
+		{
+			cell.Get()->~T();
+			cell.sequence.store(pos + queue.m_capacity, std::memory_order_release);
+			NotifyOne(queue.m_popSignal, queue.m_waitingProducers);
+		}
+	};
+
+	template <typename U>
+	void PushImpl(U&& value)
+	{
+		// TryPushImpl не трогает value при неудаче, поэтому повторная передача безопасна
+		WaitFor(m_popSignal, m_waitingProducers, [&] { return TryPushImpl(std::forward<U>(value)); });
+	}
+
+	template <typename TryFn>
+	static void WaitFor(Padded<std::uint32_t>& signal, Padded<size_t>& waiters, TryFn&& tryOnce)
+	{
+		while (true)
+		{
+			for (int i = 0; i < SpinCount; ++i)
+			{
+				if (tryOnce())
+				{
+					return;
+				}
+				CpuRelax();
+			}
+
+			const std::uint32_t observed = signal.value.load(std::memory_order_acquire);
+			waiters.value.fetch_add(1, std::memory_order_relaxed);
+			// Парный барьер в NotifyOne: либо мы увидим результат чужой операции,
+			// либо её автор увидит нас среди ждущих и разбудит
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (tryOnce())
+			{
+				waiters.value.fetch_sub(1, std::memory_order_relaxed);
+				return;
+			}
+			signal.value.wait(observed, std::memory_order_acquire);
+			waiters.value.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	static void NotifyOne(Padded<std::uint32_t>& signal, Padded<size_t>& waiters)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters.value.load(std::memory_order_relaxed) > 0)
+		{
+			signal.value.fetch_add(1, std::memory_order_release);
+			signal.value.notify_one();
+		}
+	}
+
+	const size_t m_capacity;
+	const size_t m_mask;
+	std::unique_ptr<Cell[]> m_cells;
+
+	Padded<size_t> m_head;
+	Padded<size_t> m_tail;
+	Padded<std::uint32_t> m_pushSignal;
+	Padded<std::uint32_t> m_popSignal;
+	Padded<size_t> m_waitingConsumers;
+	Padded<size_t> m_waitingProducers;
+};
\ No newline at end of file
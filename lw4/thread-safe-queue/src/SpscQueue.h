@@ -0,0 +1,263 @@
+#pragma once
+
+#include "AsymmetricFence.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+// Ограниченная очередь для ровно одного производителя и одного потребителя.
+// Каждый индекс пишет только одна сторона, а чужой индекс читается из локальной копии
+// и перечитывается, лишь когда по копии очередь выглядит полной или пустой.
+// На быстром пути нет ни блокировок, ни атомарных read-modify-write операций, ни барьеров
+// процессора: полный барьер для засыпания выполняет только засыпающая сторона.
+template <typename T>
+class SpscQueue
+{
+public:
+	static constexpr size_t DefaultCapacity = 1024;
+
+	explicit SpscQueue(size_t capacity = DefaultCapacity)
+		: m_capacity(RoundUpToPowerOfTwo(capacity))
+		, m_mask(m_capacity - 1)
+		, m_slots(std::make_unique<Slot[]>(m_capacity))
+	{
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	~SpscQueue()
+	{
+		const size_t head = m_producer.head.load(std::memory_order_relaxed);
+		for (size_t pos = m_consumer.tail.load(std::memory_order_relaxed); pos != head; ++pos)
+		{
+			m_slots[pos & m_mask].Get()->~T();
+		}
+	}
+
+	void Push(const T& value)
+	{
+		PushImpl(value);
+	}
+	void Push(T&& value)
+	{
+		PushImpl(std::move(value));
+	}
+
+	[[nodiscard]] bool TryPush(const T& value)
+	{
+		return TryPushImpl(value);
+	}
+	[[nodiscard]] bool TryPush(T&& value)
+	{
+		return TryPushImpl(std::move(value));
+	}
+
+	bool TryPop(T& out)
+	{
+		return TryPopImpl([&](T& value) { out = std::move(value); });
+	}
+	std::unique_ptr<T> TryPop()
+	{
+		std::unique_ptr<T> out;
+		TryPopImpl([&](T& value) { out = std::make_unique<T>(std::move(value)); });
+		return out;
+	}
+
+	template <typename U = T>
+	std::enable_if_t<std::is_nothrow_move_constructible_v<U>, U>
+	WaitAndPop()
+	{
+		std::optional<T> out;
+		WaitFor(m_pushSignal, [&] {
+			return TryPopImpl([&](T& value) { out.emplace(std::move(value)); });
+		});
+		return std::move(*out);
+	}
+
+	void WaitAndPop(T& out)
+	{
+		WaitFor(m_pushSignal, [&] { return TryPop(out); });
+	}
+
+	size_t GetSize() const
+	{
+		// Хвост читается первым: голова не может его обогнать в обратную сторону
+		const size_t tail = m_consumer.tail.load(std::memory_order_acquire);
+		const size_t head = m_producer.head.load(std::memory_order_acquire);
+		return head - tail;
+	}
+	size_t GetCapacity() const
+	{
+		return m_capacity;
+	}
+	bool IsEmpty() const
+	{
+		return GetSize() == 0;
+	}
+
+private:
+	static constexpr size_t CacheLineSize = 64;
+	static constexpr int SpinCount = 64;
+
+	struct Slot
+	{
+		alignas(T) std::byte storage[sizeof(T)];
+
+		T* Get()
+		{
+			return std::launder(reinterpret_cast<T*>(storage));
+		}
+	};
+
+	// Индекс стороны и её копия чужого индекса лежат в одной кэш-линии,
+	// которую другая сторона только читает
+	struct alignas(CacheLineSize) ProducerState
+	{
+		std::atomic<size_t> head{ 0 };
+		size_t cachedTail = 0;
+	};
+	struct alignas(CacheLineSize) ConsumerState
+	{
+		std::atomic<size_t> tail{ 0 };
+		size_t cachedHead = 0;
+	};
+
+	// Сторона, уснувшая в ожидании, выставляет waiting; другая будит её через signal
+	struct alignas(CacheLineSize) Signal
+	{
+		std::atomic<std::uint32_t> value{ 0 };
+		std::atomic<bool> waiting{ false };
+	};
+
+	static size_t RoundUpToPowerOfTwo(size_t capacity)
+	{
+		if (capacity == 0)
+		{
+			throw std::invalid_argument("SpscQueue capacity must be positive");
+		}
+		size_t result = 1;
+		while (result < capacity)
+		{
+			result <<= 1;
+		}
+		return result;
+	}
+
+	static void CpuRelax()
+	{
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+		_mm_pause();
+#else
+		std::this_thread::yield();
+#endif
+	}
+
+	template <typename U>
+	bool TryPushImpl(U&& value)
+	{
+		const size_t head = m_producer.head.load(std::memory_order_relaxed);
+		if (head - m_producer.cachedTail == m_capacity)
+		{
+			m_producer.cachedTail = m_consumer.tail.load(std::memory_order_acquire);
+			if (head - m_producer.cachedTail == m_capacity)
+			{
+				return false;
+			}
+		}
+
+		::new (static_cast<void*>(m_slots[head & m_mask].storage)) T(std::forward<U>(value));
+		m_producer.head.store(head + 1, std::memory_order_release);
+		NotifyIfWaiting(m_pushSignal);
+		return true;
+	}
+
+	template <typename Take>
+	bool TryPopImpl(Take&& take)
+	{
+		const size_t tail = m_consumer.tail.load(std::memory_order_relaxed);
+		if (tail == m_consumer.cachedHead)
+		{
+			m_consumer.cachedHead = m_producer.head.load(std::memory_order_acquire);
+			if (tail == m_consumer.cachedHead)
+			{
+				return false;
+			}
+		}
+
+		T* stored = m_slots[tail & m_mask].Get();
+		take(*stored);
+		stored->~T();
+		m_consumer.tail.store(tail + 1, std::memory_order_release);
+		NotifyIfWaiting(m_popSignal);
+		return true;
+	}
+
+	template <typename U>
+	void PushImpl(U&& value)
+	{
+		// TryPushImpl не трогает value при неудаче, поэтому повторная передача безопасна
+		WaitFor(m_popSignal, [&] { return TryPushImpl(std::forward<U>(value)); });
+	}
+
+	template <typename TryFn>
+	static void WaitFor(Signal& signal, TryFn&& tryOnce)
+	{
+		while (true)
+		{
+			for (int i = 0; i < SpinCount; ++i)
+			{
+				if (tryOnce())
+				{
+					return;
+				}
+				CpuRelax();
+			}
+
+			const std::uint32_t observed = signal.value.load(std::memory_order_acquire);
+			signal.waiting.store(true, std::memory_order_relaxed);
+			// Парный лёгкий барьер в NotifyIfWaiting: либо мы увидим новый индекс, либо нас разбудят
+			AsymmetricFence::Heavy();
+			if (tryOnce())
+			{
+				signal.waiting.store(false, std::memory_order_relaxed);
+				return;
+			}
+			signal.value.wait(observed, std::memory_order_acquire);
+			signal.waiting.store(false, std::memory_order_relaxed);
+		}
+	}
+
+	static void NotifyIfWaiting(Signal& signal)
+	{
+		AsymmetricFence::Light();
+		// Флаг снимает будящая сторона: пока уснувший поток не проснулся, следующие операции
+		// не делают лишних системных вызовов
+		if (signal.waiting.load(std::memory_order_relaxed) && signal.waiting.exchange(false, std::memory_order_relaxed))
+		{
+			signal.value.fetch_add(1, std::memory_order_release);
+			signal.value.notify_one();
+		}
+	}
+
+	const size_t m_capacity;
+	const size_t m_mask;
+	std::unique_ptr<Slot[]> m_slots;
+
+	ProducerState m_producer;
+	ConsumerState m_consumer;
+	Signal m_pushSignal;
+	Signal m_popSignal;
+};
\ No newline at end of file
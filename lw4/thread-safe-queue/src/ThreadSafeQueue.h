@@ -1,9 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
 #include <shared_mutex>
+#include <stdexcept>
+#include <stop_token>
 
 template <typename T>
 class ThreadSafeQueue
@@ -17,20 +21,14 @@ public:
 	void Push(const T& value)
 	{
 		std::unique_lock lock(m_queueMutex);
-		if (m_capacity > 0)
-		{
-			m_notFull.wait(lock, [&] { return m_queue.size() < m_capacity; });
-		}
+		WaitForSpace(lock);
 		m_queue.emplace_back(value);
 		m_notEmpty.notify_one();
 	}
 	void Push(T&& value)
 	{
 		std::unique_lock lock(m_queueMutex);
-		if (m_capacity > 0)
-		{
-			m_notFull.wait(lock, [&] { return m_queue.size() < m_capacity; });
-		}
+		WaitForSpace(lock);
 		m_queue.emplace_back(std::move(value));
 		m_notEmpty.notify_one();
 	}
@@ -38,7 +36,7 @@ public:
 	[[nodiscard]] bool TryPush(const T& value)
 	{
 		std::unique_lock lock(m_queueMutex);
-		if (m_capacity > 0 && m_queue.size() >= m_capacity)
+		if (m_closed || (m_capacity > 0 && m_queue.size() >= m_capacity))
 		{
 			return false;
 		}
@@ -49,7 +47,7 @@ public:
 	[[nodiscard]] bool TryPush(T&& value)
 	{
 		std::unique_lock lock(m_queueMutex);
-		if (m_capacity > 0 && m_queue.size() >= m_capacity)
+		if (m_closed || (m_capacity > 0 && m_queue.size() >= m_capacity))
 		{
 			return false;
 		}
@@ -58,6 +56,47 @@ public:
 		return true;
 	}
 
+	// Элементы переносятся под одной блокировкой; в ограниченной очереди
+	// диапазон, не поместившийся целиком, докладывается по мере освобождения места
+	template <typename InputIt>
+	void PushRange(InputIt first, InputIt last)
+	{
+		std::unique_lock lock(m_queueMutex);
+		while (first != last)
+		{
+			WaitForSpace(lock);
+			size_t pushed = 0;
+			for (; first != last && (m_capacity == 0 || m_queue.size() < m_capacity); ++first, ++pushed)
+			{
+				m_queue.emplace_back(*first);
+			}
+			NotifyAfterTransfer(m_notEmpty, pushed);
+		}
+	}
+
+	// Ждёт не дольше timeout появления хотя бы одного элемента и забирает до maxCount элементов.
+	// Закрытая очередь отдаёт остаток без ожидания
+	template <typename OutputIt, typename Rep, typename Period>
+	size_t PopUpTo(OutputIt out, size_t maxCount, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		std::unique_lock lock(m_queueMutex);
+		if (maxCount == 0 || !m_notEmpty.wait_for(lock, timeout, [&] { return !m_queue.empty() || m_closed; })
+			|| m_queue.empty())
+		{
+			return 0;
+		}
+
+		const size_t count = std::min(maxCount, m_queue.size());
+		const auto end = m_queue.begin() + static_cast<std::ptrdiff_t>(count);
+		std::move(m_queue.begin(), end, out);
+		m_queue.erase(m_queue.begin(), end);
+		if (m_capacity > 0)
+		{
+			NotifyAfterTransfer(m_notFull, count);
+		}
+		return count;
+	}
+
 	bool TryPop(T& out)
 	{
 		std::unique_lock lock(m_queueMutex);
@@ -94,7 +133,11 @@ public:
 	WaitAndPop()
 	{
 		std::unique_lock lock(m_queueMutex);
-		m_notEmpty.wait(lock, [&] { return !m_queue.empty(); });
+		m_notEmpty.wait(lock, [&] { return !m_queue.empty() || m_closed; });
+		if (m_queue.empty())
+		{
+			throw std::runtime_error("WaitAndPop on closed and empty ThreadSafeQueue");
+		}
 		auto value = std::move(m_queue.front());
 		m_queue.pop_front();
 		if (m_capacity > 0)
@@ -104,16 +147,56 @@ public:
 		return value;
 	}
 
-	void WaitAndPop(T& out)
+	// Возвращает false, только если очередь закрыта и опустела
+	bool WaitAndPop(T& out)
 	{
 		std::unique_lock lock(m_queueMutex);
-		m_notEmpty.wait(lock, [&] { return !m_queue.empty(); });
-		out = std::move(m_queue.front());
-		m_queue.pop_front();
-		if (m_capacity > 0)
+		m_notEmpty.wait(lock, [&] { return !m_queue.empty() || m_closed; });
+		return PopFrontLocked(out);
+	}
+
+	// Возвращает false при запросе остановки или если закрытая очередь опустела
+	bool WaitAndPop(T& out, std::stop_token stopToken)
+	{
+		std::unique_lock lock(m_queueMutex);
+		if (!m_notEmpty.wait(lock, stopToken, [&] { return !m_queue.empty() || m_closed; }))
 		{
-			m_notFull.notify_one();
+			return false;
+		}
+		return PopFrontLocked(out);
+	}
+
+	template <typename Rep, typename Period>
+	bool WaitAndPopFor(T& out, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		std::unique_lock lock(m_queueMutex);
+		m_notEmpty.wait_for(lock, timeout, [&] { return !m_queue.empty() || m_closed; });
+		return PopFrontLocked(out);
+	}
+
+	template <typename Clock, typename Duration>
+	bool WaitAndPopUntil(T& out, const std::chrono::time_point<Clock, Duration>& deadline)
+	{
+		std::unique_lock lock(m_queueMutex);
+		m_notEmpty.wait_until(lock, deadline, [&] { return !m_queue.empty() || m_closed; });
+		return PopFrontLocked(out);
+	}
+
+	// После закрытия добавление запрещено, а извлечение отдаёт оставшиеся элементы
+	// и затем сразу завершается неудачей. Все ожидающие потоки просыпаются
+	void Close()
+	{
+		{
+			std::unique_lock lock(m_queueMutex);
+			m_closed = true;
 		}
+		m_notEmpty.notify_all();
+		m_notFull.notify_all();
+	}
+	bool IsClosed() const
+	{
+		std::shared_lock lock(m_queueMutex);
+		return m_closed;
 	}
 
 	size_t GetSize() const
@@ -149,6 +232,8 @@ public:
 		std::scoped_lock lock(first->m_queueMutex, second->m_queueMutex);
 		std::swap(first->m_queue, second->m_queue);
 		std::swap(first->m_capacity, second->m_capacity);
+		// Закрытость — свойство содержимого: закрытая очередь после обмена остаётся закрытой
+		std::swap(first->m_closed, second->m_closed);
 
 		first->m_notEmpty.notify_all();
 		second->m_notEmpty.notify_all();
@@ -167,9 +252,49 @@ public:
 	}
 
 private:
+	void WaitForSpace(std::unique_lock<std::shared_mutex>& lock)
+	{
+		if (m_capacity > 0)
+		{
+			m_notFull.wait(lock, [&] { return m_queue.size() < m_capacity || m_closed; });
+		}
+		if (m_closed)
+		{
+			throw std::runtime_error("Push to closed ThreadSafeQueue");
+		}
+	}
+
+	bool PopFrontLocked(T& out)
+	{
+		if (m_queue.empty())
+		{
+			return false;
+		}
+		out = std::move(m_queue.front());
+		m_queue.pop_front();
+		if (m_capacity > 0)
+		{
+			m_notFull.notify_one();
+		}
+		return true;
+	}
+
+	static void NotifyAfterTransfer(std::condition_variable_any& cv, size_t count)
+	{
+		if (count > 1)
+		{
+			cv.notify_all();
+		}
+		else if (count == 1)
+		{
+			cv.notify_one();
+		}
+	}
+
 	mutable std::shared_mutex m_queueMutex;
 	std::deque<T> m_queue;
 	size_t m_capacity;
+	bool m_closed = false;
 	std::condition_variable_any m_notEmpty;
 	std::condition_variable_any m_notFull;
 };
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "MpmcRingQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <gtest/gtest.h>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(MpmcRingQueueTest, ZeroCapacityThrows)
+{
+	EXPECT_THROW(MpmcRingQueue<int>(0), std::invalid_argument);
+}
+
+TEST(MpmcRingQueueTest, CapacityIsRoundedUpToPowerOfTwo)
+{
+	EXPECT_EQ(8, MpmcRingQueue<int>(5).GetCapacity());
+	EXPECT_EQ(2, MpmcRingQueue<int>(1).GetCapacity());
+}
+
+TEST(MpmcRingQueueTest, TryPopOnEmptyReturnsFalse)
+{
+	MpmcRingQueue<int> queue(4);
+	int out;
+	EXPECT_FALSE(queue.TryPop(out));
+	EXPECT_EQ(nullptr, queue.TryPop());
+	EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(MpmcRingQueueTest, TryPushFailsWhenFull)
+{
+	MpmcRingQueue<int> queue(2);
+	EXPECT_TRUE(queue.TryPush(1));
+	EXPECT_TRUE(queue.TryPush(2));
+	EXPECT_FALSE(queue.TryPush(3));
+	EXPECT_EQ(2, queue.GetSize());
+}
+
+TEST(MpmcRingQueueTest, PreservesFIFOAcrossWrapAround)
+{
+	MpmcRingQueue<int> queue(4);
+	int next = 0;
+	for (int round = 0; round < 10; ++round)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			queue.Push(round * 3 + i);
+		}
+		for (int i = 0; i < 3; ++i)
+		{
+			int val;
+			ASSERT_TRUE(queue.TryPop(val));
+			EXPECT_EQ(next++, val);
+		}
+	}
+	EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(MpmcRingQueueTest, MoveOnlyAndNonTrivialTypes)
+{
+	MpmcRingQueue<std::unique_ptr<std::string>> queue(4);
+	queue.Push(std::make_unique<std::string>("first"));
+	queue.Push(std::make_unique<std::string>("second"));
+
+	auto val = queue.WaitAndPop();
+	ASSERT_NE(nullptr, val);
+	EXPECT_EQ("first", *val);
+	// Оставшийся элемент освобождается деструктором очереди
+}
+
+TEST(MpmcRingQueueTest, ThrowingMoveAssignmentReleasesCell)
+{
+	struct ThrowingAssign
+	{
+		int value = 0;
+
+		ThrowingAssign() = default;
+		ThrowingAssign(int value)
+			: value(value)
+		{
+		}
+		ThrowingAssign(ThrowingAssign&&) = default;
+		ThrowingAssign& operator=(ThrowingAssign&& other)
+		{
+			if (other.value < 0)
+			{
+				throw std::runtime_error("move assignment failed");
+			}
+			value = other.value;
+			return *this;
+		}
+	};
+
+	MpmcRingQueue<ThrowingAssign> queue(2);
+	queue.Push(ThrowingAssign(-1));
+	ThrowingAssign out;
+	EXPECT_THROW(queue.TryPop(out), std::runtime_error);
+
+	// Ячейка с выброшенным значением снова доступна на следующих кругах
+	for (int i = 0; i < 8; ++i)
+	{
+		ASSERT_TRUE(queue.TryPush(ThrowingAssign(i)));
+		ASSERT_TRUE(queue.TryPop(out));
+		EXPECT_EQ(i, out.value);
+	}
+	EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(MpmcRingQueueTest, PushBlocksUntilPop)
+{
+	MpmcRingQueue<int> queue(2);
+	queue.Push(100);
+	queue.Push(150);
+
+	std::atomic producerDone{ false };
+	std::jthread producer([&] {
+		queue.Push(200);
+		producerDone = true;
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	EXPECT_FALSE(producerDone.load());
+
+	EXPECT_EQ(100, queue.WaitAndPop());
+	producer.join();
+	EXPECT_TRUE(producerDone.load());
+	EXPECT_EQ(150, queue.WaitAndPop());
+	EXPECT_EQ(200, queue.WaitAndPop());
+}
+
+TEST(MpmcRingQueueTest, WaitAndPopBlocksUntilPush)
+{
+	MpmcRingQueue<int> queue(8);
+	std::jthread producer([&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		queue.Push(123);
+	});
+
+	int val = 0;
+	queue.WaitAndPop(val);
+	EXPECT_EQ(123, val);
+}
+
+TEST(MpmcRingQueueTest, MPMC_NoLossNoDuplication)
+{
+	constexpr size_t numProducers = 4;
+	constexpr size_t numConsumers = 4;
+	constexpr size_t itemsPerProducer = 10'000;
+	constexpr size_t totalItems = numProducers * itemsPerProducer;
+
+	MpmcRingQueue<int> queue(64);
+	std::vector<int> results;
+	std::mutex resultsMutex;
+
+	{
+		std::vector<std::jthread> threads;
+		for (size_t i = 0; i < numProducers; ++i)
+		{
+			threads.emplace_back([&, id = i] {
+				for (size_t j = 0; j < itemsPerProducer; ++j)
+				{
+					queue.Push(static_cast<int>(id * itemsPerProducer + j));
+				}
+			});
+		}
+		for (size_t i = 0; i < numConsumers; ++i)
+		{
+			threads.emplace_back([&] {
+				std::vector<int> local;
+				for (size_t j = 0; j < totalItems / numConsumers; ++j)
+				{
+					local.push_back(queue.WaitAndPop());
+				}
+				std::lock_guard lock(resultsMutex);
+				results.insert(results.end(), local.begin(), local.end());
+			});
+		}
+	}
+
+	ASSERT_EQ(totalItems, results.size());
+	std::sort(results.begin(), results.end());
+	for (size_t i = 0; i < totalItems; ++i)
+	{
+		EXPECT_EQ(static_cast<int>(i), results[i]);
+	}
+	EXPECT_TRUE(queue.IsEmpty());
+}
\ No newline at end of file
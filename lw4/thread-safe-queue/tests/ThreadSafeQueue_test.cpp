@@ -1,6 +1,9 @@
+#include "SpscQueue.h"
 #include "ThreadSafeQueue.h"
+#include <atomic>
 #include <chrono>
 #include <gtest/gtest.h>
+#include <iterator>
 #include <stdexcept>
 #include <thread>
 #include <vector>
@@ -20,17 +23,26 @@ bool WaitWithTimeout(Predicate&& p, std::chrono::milliseconds timeout = std::chr
 	return true;
 }
 
-TEST(ThreadSafeQueueTest, TryPopOnEmptyReturnsFalse)
+// Общий контракт очередей: всё, что не требует нескольких производителей или потребителей
+template <typename Queue>
+class QueueTest : public ::testing::Test
 {
-	ThreadSafeQueue<int> queue;
+};
+
+using QueueTypes = ::testing::Types<ThreadSafeQueue<int>, SpscQueue<int>>;
+TYPED_TEST_SUITE(QueueTest, QueueTypes);
+
+TYPED_TEST(QueueTest, TryPopOnEmptyReturnsFalse)
+{
+	TypeParam queue;
 	int out;
 	EXPECT_FALSE(queue.TryPop(out));
 	EXPECT_EQ(nullptr, queue.TryPop());
 }
 
-TEST(ThreadSafeQueueTest, PushThenTryPopReturnsSameValue)
+TYPED_TEST(QueueTest, PushThenTryPopReturnsSameValue)
 {
-	ThreadSafeQueue<int> queue;
+	TypeParam queue;
 	queue.Push(42);
 	int out;
 	EXPECT_TRUE(queue.TryPop(out));
@@ -42,9 +54,9 @@ TEST(ThreadSafeQueueTest, PushThenTryPopReturnsSameValue)
 	EXPECT_EQ(100, *ptr);
 }
 
-TEST(ThreadSafeQueueTest, GetSizeAndIsEmptyAreCorrect)
+TYPED_TEST(QueueTest, GetSizeAndIsEmptyAreCorrect)
 {
-	ThreadSafeQueue<int> queue;
+	TypeParam queue;
 	EXPECT_TRUE(queue.IsEmpty());
 	EXPECT_EQ(0, queue.GetSize());
 
@@ -57,17 +69,17 @@ TEST(ThreadSafeQueueTest, GetSizeAndIsEmptyAreCorrect)
 	EXPECT_EQ(0, queue.GetSize());
 }
 
-TEST(ThreadSafeQueueTest, BoundedCapacityOneSecondTryPushFails)
+TYPED_TEST(QueueTest, BoundedCapacityOneSecondTryPushFails)
 {
-	ThreadSafeQueue<int> queue(1);
+	TypeParam queue(1);
 	EXPECT_TRUE(queue.TryPush(10));
 	EXPECT_FALSE(queue.TryPush(20));
 	EXPECT_EQ(1, queue.GetSize());
 }
 
-TEST(ThreadSafeQueueTest, BoundedPushBlocksUntilPop)
+TYPED_TEST(QueueTest, BoundedPushBlocksUntilPop)
 {
-	ThreadSafeQueue<int> queue(1);
+	TypeParam queue(1);
 	queue.Push(100);
 
 	std::atomic producerDone{ false };
@@ -184,6 +196,26 @@ TEST(ThreadSafeQueueTest, SwapExchangesContentAndCapacity)
 	EXPECT_TRUE(queue2.IsEmpty());
 }
 
+TEST(ThreadSafeQueueTest, SwapExchangesClosedState)
+{
+	ThreadSafeQueue<int> open;
+	ThreadSafeQueue<int> closed;
+	closed.Push(1);
+	closed.Close();
+
+	open.Swap(closed);
+
+	EXPECT_TRUE(open.IsClosed());
+	EXPECT_FALSE(closed.IsClosed());
+	EXPECT_FALSE(open.TryPush(2));
+	EXPECT_TRUE(closed.TryPush(2));
+
+	int val = 0;
+	EXPECT_TRUE(open.WaitAndPop(val));
+	EXPECT_EQ(1, val);
+	EXPECT_FALSE(open.WaitAndPop(val));
+}
+
 TEST(ThreadSafeQueueTest, SwapNoDeadlockWithConcurrentAccess)
 {
 	ThreadSafeQueue<int> queue1(100);
@@ -248,9 +280,9 @@ TEST(ThreadSafeQueueTest, SwapWithDequeAllowsSubsequentOperations)
 	EXPECT_EQ(4, val);
 }
 
-TEST(ThreadSafeQueueTest, WaitAndPopReturnsByValueForNothrowType)
+TYPED_TEST(QueueTest, WaitAndPopReturnsByValueForNothrowType)
 {
-	ThreadSafeQueue<int> queue;
+	TypeParam queue;
 	std::jthread producer([&] {
 		std::this_thread::sleep_for(std::chrono::milliseconds(10));
 		queue.Push(123);
@@ -261,6 +293,189 @@ TEST(ThreadSafeQueueTest, WaitAndPopReturnsByValueForNothrowType)
 	producer.join();
 }
 
+TEST(ThreadSafeQueueTest, PushRangeThenPopUpToPreservesFIFO)
+{
+	ThreadSafeQueue<int> queue;
+	const std::vector input{ 1, 2, 3, 4, 5 };
+	queue.PushRange(input.begin(), input.end());
+	EXPECT_EQ(5, queue.GetSize());
+
+	std::vector<int> out;
+	EXPECT_EQ(3, queue.PopUpTo(std::back_inserter(out), 3, std::chrono::milliseconds(0)));
+	EXPECT_EQ(2, queue.PopUpTo(std::back_inserter(out), 10, std::chrono::milliseconds(0)));
+	EXPECT_EQ(input, out);
+	EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(ThreadSafeQueueTest, PopUpToOnEmptyTimesOut)
+{
+	ThreadSafeQueue<int> queue;
+	std::vector<int> out;
+	const auto start = std::chrono::steady_clock::now();
+	EXPECT_EQ(0, queue.PopUpTo(std::back_inserter(out), 4, std::chrono::milliseconds(20)));
+	EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(20));
+	EXPECT_TRUE(out.empty());
+}
+
+TEST(ThreadSafeQueueTest, PopUpToWakesOnPushRange)
+{
+	ThreadSafeQueue<int> queue;
+	std::jthread producer([&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		const std::vector input{ 7, 8 };
+		queue.PushRange(input.begin(), input.end());
+	});
+
+	std::vector<int> out;
+	while (out.size() < 2)
+	{
+		queue.PopUpTo(std::back_inserter(out), 2, std::chrono::seconds(5));
+	}
+	EXPECT_EQ((std::vector{ 7, 8 }), out);
+}
+
+TEST(ThreadSafeQueueTest, BoundedPushRangeWaitsForSpace)
+{
+	ThreadSafeQueue<int> queue(2);
+	std::vector<int> input(10);
+	for (int i = 0; i < 10; ++i)
+	{
+		input[i] = i;
+	}
+
+	std::atomic producerDone{ false };
+	std::jthread producer([&] {
+		queue.PushRange(input.begin(), input.end());
+		producerDone = true;
+	});
+
+	ASSERT_TRUE(WaitWithTimeout([&] { return queue.GetSize() == 2; }));
+	EXPECT_FALSE(producerDone.load());
+
+	std::vector<int> out;
+	while (out.size() < input.size())
+	{
+		EXPECT_LE(queue.PopUpTo(std::back_inserter(out), 4, std::chrono::seconds(5)), 2);
+	}
+	producer.join();
+	EXPECT_TRUE(producerDone.load());
+	EXPECT_EQ(input, out);
+}
+
+TEST(ThreadSafeQueueTest, WaitAndPopForTimesOutOnEmpty)
+{
+	ThreadSafeQueue<int> queue;
+	int val = 0;
+	EXPECT_FALSE(queue.WaitAndPopFor(val, std::chrono::milliseconds(20)));
+
+	queue.Push(5);
+	EXPECT_TRUE(queue.WaitAndPopFor(val, std::chrono::milliseconds(20)));
+	EXPECT_EQ(5, val);
+}
+
+TEST(ThreadSafeQueueTest, WaitAndPopUntilWakesOnPush)
+{
+	ThreadSafeQueue<int> queue;
+	std::jthread producer([&] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		queue.Push(11);
+	});
+
+	int val = 0;
+	EXPECT_TRUE(queue.WaitAndPopUntil(val, std::chrono::steady_clock::now() + std::chrono::seconds(5)));
+	EXPECT_EQ(11, val);
+}
+
+TEST(ThreadSafeQueueTest, CloseDrainsThenFails)
+{
+	ThreadSafeQueue<int> queue(4);
+	queue.Push(1);
+	queue.Push(2);
+	queue.Close();
+
+	EXPECT_TRUE(queue.IsClosed());
+	EXPECT_FALSE(queue.TryPush(3));
+	EXPECT_THROW(queue.Push(3), std::runtime_error);
+
+	int val = 0;
+	EXPECT_TRUE(queue.WaitAndPop(val));
+	EXPECT_EQ(1, val);
+	EXPECT_TRUE(queue.WaitAndPopFor(val, std::chrono::seconds(5)));
+	EXPECT_EQ(2, val);
+	EXPECT_FALSE(queue.WaitAndPop(val));
+	EXPECT_FALSE(queue.WaitAndPopFor(val, std::chrono::seconds(5)));
+	EXPECT_THROW(queue.WaitAndPop(), std::runtime_error);
+}
+
+TEST(ThreadSafeQueueTest, CloseWakesBlockedConsumersAndProducers)
+{
+	ThreadSafeQueue<int> empty;
+	ThreadSafeQueue<int> full(1);
+	full.Push(0);
+
+	std::atomic consumerFailed{ false };
+	std::atomic producerThrew{ false };
+	std::jthread consumer([&] {
+		int val;
+		consumerFailed = !empty.WaitAndPop(val);
+	});
+	std::jthread producer([&] {
+		try
+		{
+			full.Push(1);
+		}
+		catch (const std::runtime_error&)
+		{
+			producerThrew = true;
+		}
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	empty.Close();
+	full.Close();
+	consumer.join();
+	producer.join();
+
+	EXPECT_TRUE(consumerFailed.load());
+	EXPECT_TRUE(producerThrew.load());
+}
+
+TEST(ThreadSafeQueueTest, WaitAndPopReturnsFalseOnStopRequest)
+{
+	ThreadSafeQueue<int> queue;
+	std::atomic popped{ true };
+	std::jthread consumer([&](std::stop_token stopToken) {
+		int val;
+		popped = queue.WaitAndPop(val, stopToken);
+	});
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	consumer.request_stop();
+	consumer.join();
+	EXPECT_FALSE(popped.load());
+}
+
+TYPED_TEST(QueueTest, SingleProducerSingleConsumerPreservesOrder)
+{
+	constexpr int n = 100'000;
+	TypeParam queue(64);
+
+	std::jthread producer([&] {
+		for (int i = 0; i < n; ++i)
+		{
+			queue.Push(i);
+		}
+	});
+
+	for (int i = 0; i < n; ++i)
+	{
+		int val;
+		queue.WaitAndPop(val);
+		ASSERT_EQ(i, val);
+	}
+	EXPECT_TRUE(queue.IsEmpty());
+}
+
 int main(int argc, char** argv)
 {
 	::testing::InitGoogleTest(&argc, argv);